@@ -8,20 +8,51 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/culling.h>
+#include <learnopengl/indirect.h>
+#include <learnopengl/clustered_lights.h>
+#include <learnopengl/emissive_lights.h>
+#include <learnopengl/shadow_map.h>
+#include <learnopengl/planar_reflections.h>
+#include <learnopengl/reflection_probes.h>
+#include <learnopengl/hdr.h>
+#include <learnopengl/dynamic_resolution.h>
+#include <learnopengl/frame_pacing.h>
+#include <learnopengl/gpu_profiler.h>
+#include <learnopengl/cpu_profiler.h>
+#include <learnopengl/frame_stats.h>
+#include <learnopengl/png_writer.h>
+#include <learnopengl/input_recorder.h>
+#include <learnopengl/camera_path.h>
+#include <learnopengl/draw_stats.h>
+#include <learnopengl/microbench.h>
+#include <learnopengl/frame_arena.h>
 
 #include <iostream>
 #include <cmath>
 #include <cstdlib>
+#include <cstdio>
 
 #define STB_IMAGE_IMPLEMENTATION 
 #include <learnopengl/stb_image.h>
+#define ALLOCATION_COUNTER_IMPLEMENTATION
+#include <learnopengl/allocation_counter.h>
 #include <vector>
+#include <array>
 
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+void mouseButton(int button, int action);
+void applyReplayedInput(GLFWwindow* window);
+void setupBenchmark(const std::vector<glm::vec3>& mirrorPositions);
+void updateBenchmark();
+void recordBenchmarkFrame(GLFWwindow* window);
+bool writeBenchmarkJson();
+void runMicroBenchmarks(const MicroBenchmark::Settings& settings, const std::string& csvPath);
 void processInput(GLFWwindow* window);
 bool isPlayerInAllowedZone(glm::vec3 position, const std::vector<glm::vec4>& zones);
 bool isPlayerNearSkull(glm::vec3 playerPos, glm::vec3 skullPos, float radius = 2.0f);
@@ -34,6 +65,19 @@ void renderGameOverText(Shader& shader, glm::mat4 projection, glm::mat4 view);
 void renderGameOverOverlay(Shader& shader, unsigned int gameOverTexture);
 unsigned int loadTexture(char const * path);
 void setupGameOverQuad();
+void setSceneUniforms(Shader& shader, const glm::mat4& projection, const glm::mat4& view, const glm::vec3& eye, float currentFrame);
+void renderMirrorReflection(const PlanarReflections::View& reflected, const glm::mat4& projection, Shader& ourShader, Shader& levelShader,
+                            Shader& slendermanShader, Model& ourModel, Model& slendermanModel, Model& skullModel,
+                            std::vector<unsigned char>& partyroomVisible, float currentFrame);
+void bakeReflectionProbes(Shader& ourShader, Shader& levelShader, Model& ourModel, std::vector<unsigned char>& partyroomVisible);
+glm::vec3 nearestWalkableZoneCenter(glm::vec3 position);
+void addSceneLights(float currentFrame, const glm::vec3& eye);
+void presentFrame(GLFWwindow* window);
+void recordHeadlessFrame(GLFWwindow* window);
+glm::mat4 getSkullModelMatrix(int index);
+glm::mat4 getSlendermanModelMatrix();
+bool isInFlashlightCone(const glm::vec3& eye, const glm::vec3& front, const glm::vec3& target);
+void steerSlenderman(glm::vec3& position, float& direction, float& movementTimer, const glm::vec3& player, float deltaTime, float currentFrame);
 
 // settings
 const unsigned int SCR_WIDTH = 1280;
@@ -65,9 +109,19 @@ std::vector<glm::vec4> walkableZones = {
     
 };
 
-// timing
+// timing: deltaTime es el tiempo de frame suavizado y acotado que da el frame pacer (vsync y límite de FPS)
 float deltaTime = 0.0f;
-float lastFrame = 0.0f;
+FramePacer framePacer;
+// tiempo de la simulación (Slenderman, daño, animaciones); con paso fijo avanza fixedStep por frame sin importar cuánto
+// tardó el frame, así una repetición es idéntica en cualquier máquina
+double simulationTime = 0.0;
+double simulationStart = 0.0;
+unsigned int simulationFrame = 0;
+float fixedStep = 0.0f; // 0 = tiempo de frame del frame pacer
+
+// grabación de la entrada (--record) y repetición (--replay) para mediciones repetibles
+InputRecorder inputRecorder;
+std::string recordPath, replayPath;
 
 // flashlight
 bool flashlightOn = false;
@@ -75,9 +129,118 @@ float flashlightBattery = 5.0f; // Duración de la linterna en segundos
 const float maxBattery = 5.0f;
 const float batteryRecharge = 5.0f; // Segundos que se añaden al pisar calavera
 bool flashlightBatteryEmpty = false;
+const float flashlightCutOff = 8.0f;       // Ángulos del cono de la linterna (grados)
+const float flashlightOuterCutOff = 12.0f;
+
+// sombras de la linterna: la profundidad del partyroom y los espejos se cachea, Slenderman y las calaveras se agregan cada frame
+SpotShadowMap flashlightShadow;
+
+// reflejos planos de los espejos: cada frame se vuelven a renderizar solo los más importantes (tecla E para desactivarlos)
+PlanarReflections mirrorReflections;
+CullContext reflectionCull; // frustum de la cámara reflejada, sin celdas ni Hi-Z (son de la cámara del jugador)
+bool mirrorReflectionsEnabled = true;
+
+// sondas de reflejo horneadas al cargar, una por zona caminable: piso mojado y espejos sin reflejo plano (tecla G)
+ReflectionProbes reflectionProbes;
+bool reflectionProbesEnabled = true;
+
+// escena en un target HDR (RGBA16F) con bloom y tone mapping al final del frame (tecla T cambia el tone mapper)
+HdrRenderer hdrRenderer;
+
+// resolución dinámica: la escena se renderiza entre 50% y 100% del tamaño de la ventana según el tiempo de GPU (tecla V)
+DynamicResolution dynamicResolution;
+
+// tiempo de GPU de cada pase (partyroom, Slenderman, calaveras, sangre, espejos, post, overlay); tecla H muestra el HUD
+GpuProfiler gpuProfiler;
+bool gpuProfilerHud = false;
+
+// zonas de CPU (lógica, render loop, hilos del PVS); tecla K empieza y termina una captura que se guarda en cpuTracePath
+std::string cpuTracePath = "cpu_trace.json";
+
+// memoria: reservas del heap del hilo principal por frame (--alloc-assert detiene el programa si un frame reserva
+// después del arranque) y la arena de frame para los datos que viven un solo frame (se vacía en presentFrame)
+FrameAllocationTracker frameAllocations;
+FrameArena frameArena;
+
+// modo sin pantalla (--headless): contexto offscreen y la imagen final en un FBO del tamaño pedido, para medir o
+// capturar frames en máquinas sin monitor (Mesa llvmpipe en un servidor o en CI)
+struct HeadlessRun {
+    bool enabled = false;
+    int width = 1280, height = 720;
+    unsigned int frames = 0;   // frames a renderizar, 0 = sin límite
+    float seconds = 0.0f;      // duración, 0 = sin límite (si ambos son 0 se renderizan 600 frames)
+    std::string dumpDirectory; // carpeta (que ya exista) donde se guardan los frames en PNG, vacía = no se guardan
+    unsigned int dumpEvery = 1;
+    unsigned int framebuffer = 0, colorBuffer = 0, depthBuffer = 0;
+    unsigned int frame = 0;
+    double startTime = 0.0, lastFrameEnd = 0.0;
+    FrameStats frameTimes;
+    std::vector<unsigned char> pixels; // lectura del frame para el PNG
+};
+HeadlessRun headlessRun;
+
+// benchmark (--benchmark): la cámara recorre un camino fijo por la discoteca, los pasillos y los grupos de espejos y
+// después pasan el game over y la victoria; cada tramo mide sus frames y al final se escribe un JSON para comparar builds
+struct BenchmarkSegment {
+    std::string name;
+    CameraPath path;
+    unsigned int frames = 0;
+    int ending = 0;                   // 0 = recorrido de cámara, 1 = game over, 2 = victoria
+    FrameStats frameTimes;
+    unsigned long long drawCalls = 0; // sumados sobre los frames del tramo
+    unsigned long long triangles = 0;
+    unsigned long long allocations = 0; // reservas del heap del hilo principal, también sumadas
+    double gpuMs = 0.0;               // sumado sobre los frames de GPU leídos durante el tramo
+    unsigned int gpuFrames = 0;
+    std::vector<std::pair<std::string, double>> gpuPasses; // ms sumados por pase de primer nivel
+};
+struct BenchmarkRun {
+    bool enabled = false;
+    std::string outputPath = "benchmark.json";
+    unsigned int warmupFrames = 60; // en la primera pose, sin medir (compilación de shaders, cachés frías)
+    std::vector<BenchmarkSegment> segments;
+    unsigned int segment = 0, frame = 0;
+    unsigned int warmup = 0;
+    double lastFrameEnd = 0.0;
+    unsigned int gpuFramesRead = 0;
+    FrameStats total;
+};
+BenchmarkRun benchmarkRun;
 
 // skull collision detection
 std::vector<bool> skullCollected(7, false); // Para rastrear qué calaveras ya fueron pisadas
+// Posición y rotación (grados) de cada calavera, usadas por el render, las colisiones y las sombras
+std::vector<glm::vec3> skullPositions = {
+    glm::vec3(-4.0f, -9.3f, -39.0f),  // Skull 1 - centro de la habitación
+    glm::vec3(-10.0f, -9.3f, -45.0f), // Skull 2 - esquina izquierda
+    glm::vec3(2.0f, -9.3f, -50.0f),   // Skull 3 - esquina derecha
+    glm::vec3(-6.0f, -9.3f, -25.0f),  // Skull 4 - zona frontal
+    glm::vec3(1.0f, -9.3f, -55.0f),   // Skull 5 - zona posterior
+    glm::vec3(-8.0f, -9.3f, -33.0f),  // Skull 6 - lateral izquierda
+    glm::vec3(0.0f, -9.3f, -30.0f)    // Skull 7 - lateral derecha
+};
+std::vector<float> skullRotations = { 45.0f, 120.0f, -60.0f, 180.0f, 90.0f, 270.0f, 15.0f };
+
+// pantalla de game over: letras de "GAME" y "OVER" (calaveras) y texto de instrucciones (charcos de sangre)
+const std::array<glm::vec3, 4> gamePositions = {
+    glm::vec3(-15.0f, -3.0f, -25.0f), // G
+    glm::vec3(-11.0f, -3.0f, -25.0f), // A
+    glm::vec3(-7.0f, -3.0f, -25.0f),  // M
+    glm::vec3(-3.0f, -3.0f, -25.0f)   // E
+};
+const std::array<glm::vec3, 4> overPositions = {
+    glm::vec3(3.0f, -3.0f, -25.0f),   // O
+    glm::vec3(7.0f, -3.0f, -25.0f),   // V
+    glm::vec3(11.0f, -3.0f, -25.0f),  // E
+    glm::vec3(15.0f, -3.0f, -25.0f)   // R
+};
+const std::array<glm::vec3, 5> instructionPositions = {
+    glm::vec3(-8.0f, -6.0f, -25.0f),   // "Press"
+    glm::vec3(-4.0f, -6.0f, -25.0f),   // "R"
+    glm::vec3(0.0f, -6.0f, -25.0f),    // "to"
+    glm::vec3(4.0f, -6.0f, -25.0f),    // "Restart"
+    glm::vec3(8.0f, -6.0f, -25.0f)     // "..."
+};
 
 // player life system
 int playerLives = 3; // Vidas del jugador
@@ -105,11 +268,241 @@ unsigned int gameOverVAO, gameOverVBO;
 unsigned int gameOverTexture;
 unsigned int victoryTexture;
 
-int main()
+// culling: frustum, celdas/portales y occlusion (Hi-Z)
+CullContext cullContext;      // frustum y contadores del frame actual
+CullStats lastFrameCullStats; // contadores del último frame completo (para reportar)
+
+// occlusion culling (Hi-Z) con las paredes del partyroom como oclusores
+HiZCuller occlusionCuller;
+
+// celdas de visibilidad construidas a partir de walkableZones (los bordes compartidos son los portales)
+CellGraph cellGraph;
+bool portalCullingEnabled = true;
+unsigned int samplesPassedQueries[2];   // GL_SAMPLES_PASSED alternando entre frames para no bloquear
+unsigned int samplesPassedQueryFrame = 0;
+GLuint64 lastSamplesPassed = 0;         // fragmentos que pasaron el depth test en el último frame medido
+
+// conjunto potencialmente visible (PVS) horneado para la geometría estática (partyroom y espejos)
+PotentiallyVisibleSet staticVisibility;
+const char* pvsPath = "model/partyroom/partyroom.pvs";
+
+// lote multi-draw indirect del partyroom (OpenGL 4.3, si no hay se dibuja malla por malla), con la tecla M se vuelve a
+// dibujar malla por malla
+MultiDrawBatch levelBatch;
+bool multiDrawEnabled = true;
+
+// prepaso de profundidad del partyroom (tecla Z): solo posiciones, luego el pase de color con GL_EQUAL sombrea un fragmento por píxel
+bool depthPrepassEnabled = true;
+unsigned int partyroomTimerQueries[2];              // GL_TIME_ELAPSED del partyroom (prepaso + color), alternando igual que samplesPassedQueries
+bool partyroomQueryPrepass[2] = { false, false };   // modo con el que se midió cada consulta
+struct PartyroomTiming {
+    float gpuMs = 0.0f;   // prepaso + pase de color del partyroom
+    float overdraw = 0.0f; // fragmentos sombreados del frame por píxel
+};
+PartyroomTiming partyroomTiming[2];                 // último valor medido sin [0] y con [1] prepaso, para compararlos
+
+// luces dinámicas con clustered forward shading (luces de la discoteca, charcos de sangre, luz extra del game over)
+ClusteredLights sceneLights;
+
+// luces generadas a partir de las superficies emisivas del partyroom, como máximo emissiveLightBudget por frame
+EmissiveProxyLights emissiveLights;
+const unsigned int emissiveLightBudget = 32;
+
+// Posiciones de los charcos de sangre (cada uno tiene su luz rojiza)
+std::vector<glm::vec3> bloodPuddlePositions = {
+    glm::vec3(-2.0f, -9.2f, -40.0f),  // Cerca del skull central
+    glm::vec3(-8.0f, -9.2f, -47.0f),  // Esquina izquierda
+    glm::vec3(0.0f, -9.2f, -52.0f),   // Área derecha
+    glm::vec3(-4.0f, -9.2f, -35.0f),  // Zona central
+    glm::vec3(-1.0f, -9.2f, -57.0f),  // Zona posterior
+    glm::vec3(-9.0f, -9.2f, -30.0f),  // Zona frontal izquierda
+    glm::vec3(2.0f, -9.2f, -28.0f),   // Zona frontal derecha
+    glm::vec3(8.0f, -9.2f, -49.0f)    // Zona del pasillo
+};
+
+int main(int argc, char** argv)
 {
+    CpuProfiler::SetThreadName("Principal");
+
+    // --bake-pvs: vuelve a hornear el PVS aunque el archivo esté al día y sale sin abrir el juego
+    // --shadow-size N y --shadow-pcf N: resolución del mapa de sombras de la linterna y radio del kernel PCF
+    // --tonemap clamp|reinhard|aces y --exposure X: tone mapper y exposición de la imagen HDR
+    // --drs-target MS: tiempo de GPU por frame que mantiene la resolución dinámica (0 la desactiva)
+    // --upscaler bilinear|edge y --sharpness X: cómo se escala la escena a la ventana y cuánto se enfoca
+    // --quality-mode: resolución dinámica entre 67% y 77% con el escalado adaptativo a los bordes
+    // --vsync vsync|adaptive|off y --fps-cap N: intervalo de swap y límite de frames por segundo (0 = sin límite)
+    // --gpu-csv ARCHIVO y --gpu-trace ARCHIVO: tiempos de GPU por pase en CSV (una fila por pase y frame) y en formato
+    // Chrome trace (chrome://tracing o ui.perfetto.dev)
+    // --cpu-trace ARCHIVO: captura las zonas de CPU desde el arranque y las guarda al salir (formato Chrome trace / Perfetto)
+    // --bench-profiler: mide el costo de una zona de CPU con la captura apagada y encendida, y sale
+    // --bench [FILTRO]: microbenchmarks de CPU de la lógica del juego (zonas caminables, calaveras, cono de la linterna,
+    // persecución de Slenderman, matrices de modelo) con 1 a 100k elementos sintéticos; imprime ns y reservas de memoria
+    // por operación, solo los que contienen FILTRO en el nombre, y sale sin abrir ventana; --bench-csv ARCHIVO: también en CSV
+    // --record ARCHIVO: graba teclas, movimiento del mouse, scroll y botones; --replay ARCHIVO: los repite en lugar de la
+    // entrada real (ESC sigue saliendo) a paso fijo, el de la grabación o 1/60 s; --fixed-step S: paso fijo de la
+    // simulación también al jugar y grabar (una grabación a paso fijo se repite frame por frame igual)
+    // --benchmark [ARCHIVO]: recorrido de cámara fijo a paso fijo, sin vsync, con tiempos de frame (media, p50, p95, p99,
+    // máximo), draw calls, triángulos y tiempo de GPU por tramo; el resultado va a ARCHIVO (benchmark.json) y sale
+    // --headless: sin ventana (contexto EGL u OSMesa de la plataforma nula de GLFW, sirve con Mesa llvmpipe), sin vsync
+    // ni límite de FPS; --size ANCHOxALTO: resolución del FBO de salida; --frames N o --duration S: cuánto dura (600
+    // frames si no se da ninguno); --dump-frames CARPETA y --dump-every N: guarda uno de cada N frames en PNG.
+    // Al terminar imprime los tiempos de frame (media, percentiles) y de GPU por pase
+    // --alloc-assert [N]: después de N frames de arranque (120) un frame que reserva memoria del heap en el hilo principal
+    // detiene el programa con la cantidad de reservas; pensado para --benchmark, --replay o --headless
+    bool bakePvsOnly = false;
+    SpotShadowMap::Settings shadowSettings;
+    HdrRenderer::Settings hdrSettings;
+    DynamicResolution::Settings resolutionSettings;
+    FramePacer::Settings pacingSettings;
+    std::string gpuCsvPath, gpuTracePath;
+    bool microBenchmarks = false;
+    MicroBenchmark::Settings microBenchmarkSettings;
+    std::string microBenchmarkCsvPath;
+    FrameAllocationTracker::Settings allocationSettings;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--bake-pvs")
+            bakePvsOnly = true;
+        else if (std::string(argv[i]) == "--shadow-size" && i + 1 < argc)
+            shadowSettings.resolution = glm::clamp(std::atoi(argv[++i]), 128, 8192);
+        else if (std::string(argv[i]) == "--shadow-pcf" && i + 1 < argc)
+            shadowSettings.pcfRadius = glm::clamp(std::atoi(argv[++i]), 0, 4);
+        else if (std::string(argv[i]) == "--tonemap" && i + 1 < argc) {
+            HdrRenderer::ToneMapper toneMapper = HdrRenderer::ToneMapperFromName(argv[++i]);
+            if (toneMapper != HdrRenderer::ToneMapper::Count)
+                hdrSettings.toneMapper = toneMapper;
+            else
+                std::cout << "ERROR::ARGS:: tone mapper desconocido " << argv[i] << " (clamp, reinhard o aces)" << std::endl;
+        }
+        else if (std::string(argv[i]) == "--exposure" && i + 1 < argc)
+            hdrSettings.exposure = glm::clamp(static_cast<float>(std::atof(argv[++i])), 0.05f, 16.0f);
+        else if (std::string(argv[i]) == "--drs-target" && i + 1 < argc) {
+            resolutionSettings.targetMs = static_cast<float>(std::atof(argv[++i]));
+            resolutionSettings.enabled = resolutionSettings.targetMs > 0.0f;
+        }
+        else if (std::string(argv[i]) == "--upscaler" && i + 1 < argc) {
+            HdrRenderer::Upscaler upscaler = HdrRenderer::UpscalerFromName(argv[++i]);
+            if (upscaler != HdrRenderer::Upscaler::Count)
+                hdrSettings.upscaler = upscaler;
+            else
+                std::cout << "ERROR::ARGS:: escalado desconocido " << argv[i] << " (bilinear o edge)" << std::endl;
+        }
+        else if (std::string(argv[i]) == "--sharpness" && i + 1 < argc)
+            hdrSettings.sharpness = glm::clamp(static_cast<float>(std::atof(argv[++i])), 0.0f, 1.0f);
+        else if (std::string(argv[i]) == "--quality-mode") {
+            resolutionSettings.enabled = true;
+            resolutionSettings.minScale = 0.67f;
+            resolutionSettings.maxScale = 0.77f;
+            hdrSettings.upscaler = HdrRenderer::Upscaler::EdgeAdaptive;
+        }
+        else if (std::string(argv[i]) == "--vsync" && i + 1 < argc) {
+            FramePacer::SwapMode swapMode = FramePacer::SwapModeFromName(argv[++i]);
+            if (swapMode != FramePacer::SwapMode::Count)
+                pacingSettings.swapMode = swapMode;
+            else
+                std::cout << "ERROR::ARGS:: modo de vsync desconocido " << argv[i] << " (vsync, adaptive u off)" << std::endl;
+        }
+        else if (std::string(argv[i]) == "--fps-cap" && i + 1 < argc)
+            pacingSettings.maxFps = glm::clamp(static_cast<float>(std::atof(argv[++i])), 0.0f, 1000.0f);
+        else if (std::string(argv[i]) == "--gpu-csv" && i + 1 < argc)
+            gpuCsvPath = argv[++i];
+        else if (std::string(argv[i]) == "--gpu-trace" && i + 1 < argc)
+            gpuTracePath = argv[++i];
+        else if (std::string(argv[i]) == "--cpu-trace" && i + 1 < argc) {
+            cpuTracePath = argv[++i];
+            CpuProfiler::SetRecording(true);
+        }
+        else if (std::string(argv[i]) == "--bench-profiler") {
+            CpuProfiler::Overhead overhead = CpuProfiler::MeasureOverhead();
+            std::cout << "Zona de CPU: " << overhead.disabledNs << " ns con la captura apagada, " << overhead.enabledNs
+                      << " ns con la captura encendida (bucle vacío: " << overhead.baselineNs << " ns por vuelta)" << std::endl;
+            return 0;
+        }
+        else if (std::string(argv[i]) == "--bench") {
+            microBenchmarks = true;
+            if (i + 1 < argc && std::string(argv[i + 1]).compare(0, 2, "--") != 0)
+                microBenchmarkSettings.filter = argv[++i];
+        }
+        else if (std::string(argv[i]) == "--bench-csv" && i + 1 < argc)
+            microBenchmarkCsvPath = argv[++i];
+        else if (std::string(argv[i]) == "--alloc-assert") {
+            allocationSettings.assertZero = true;
+            if (i + 1 < argc && std::string(argv[i + 1]).compare(0, 2, "--") != 0)
+                allocationSettings.warmupFrames = static_cast<unsigned int>(glm::max(std::atoi(argv[++i]), 0));
+        }
+        else if (std::string(argv[i]) == "--headless")
+            headlessRun.enabled = true;
+        else if (std::string(argv[i]) == "--size" && i + 1 < argc) {
+            int width = 0, height = 0;
+            if (std::sscanf(argv[++i], "%dx%d", &width, &height) == 2 && width > 0 && height > 0) {
+                headlessRun.width = glm::min(width, 16384);
+                headlessRun.height = glm::min(height, 16384);
+            }
+            else
+                std::cout << "ERROR::ARGS:: tamaño inválido " << argv[i] << " (ANCHOxALTO, por ejemplo 1920x1080)" << std::endl;
+        }
+        else if (std::string(argv[i]) == "--frames" && i + 1 < argc)
+            headlessRun.frames = static_cast<unsigned int>(glm::max(std::atoi(argv[++i]), 0));
+        else if (std::string(argv[i]) == "--duration" && i + 1 < argc)
+            headlessRun.seconds = glm::max(static_cast<float>(std::atof(argv[++i])), 0.0f);
+        else if (std::string(argv[i]) == "--dump-frames" && i + 1 < argc)
+            headlessRun.dumpDirectory = argv[++i];
+        else if (std::string(argv[i]) == "--dump-every" && i + 1 < argc)
+            headlessRun.dumpEvery = static_cast<unsigned int>(glm::max(std::atoi(argv[++i]), 1));
+        else if (std::string(argv[i]) == "--record" && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (std::string(argv[i]) == "--replay" && i + 1 < argc)
+            replayPath = argv[++i];
+        else if (std::string(argv[i]) == "--fixed-step" && i + 1 < argc)
+            fixedStep = glm::clamp(static_cast<float>(std::atof(argv[++i])), 0.0f, 0.1f);
+        else if (std::string(argv[i]) == "--benchmark") {
+            benchmarkRun.enabled = true;
+            if (i + 1 < argc && std::string(argv[i + 1]).compare(0, 2, "--") != 0)
+                benchmarkRun.outputPath = argv[++i];
+        }
+    }
+    if (microBenchmarks) {
+        runMicroBenchmarks(microBenchmarkSettings, microBenchmarkCsvPath);
+        return 0;
+    }
+    if (benchmarkRun.enabled) {
+        // la cámara la lleva el benchmark: sin grabar ni repetir entrada, a paso fijo y tan rápido como se pueda
+        recordPath.clear();
+        replayPath.clear();
+        if (fixedStep == 0.0f)
+            fixedStep = 1.0f / 60.0f;
+        pacingSettings.swapMode = FramePacer::SwapMode::Off;
+        pacingSettings.maxFps = 0.0f;
+    }
+    if (!replayPath.empty()) {
+        if (!inputRecorder.StartReplay(replayPath))
+            return -1;
+        if (inputRecorder.FixedStep() > 0.0f)
+            fixedStep = inputRecorder.FixedStep();
+        else if (fixedStep == 0.0f)
+            fixedStep = 1.0f / 60.0f;
+        recordPath.clear();
+        std::cout << "Repitiendo " << replayPath << ": " << inputRecorder.stats.events << " eventos a paso fijo de "
+                  << fixedStep * 1000.0f << " ms" << std::endl;
+    }
+    if (headlessRun.enabled) {
+        // una repetición termina con la grabación y el benchmark con su último tramo
+        if (headlessRun.frames == 0 && headlessRun.seconds == 0.0f && !inputRecorder.Replaying() && !benchmarkRun.enabled)
+            headlessRun.frames = 600;
+        // se mide lo rápido que sale cada frame, no se espera a nada
+        pacingSettings.swapMode = FramePacer::SwapMode::Off;
+        pacingSettings.maxFps = 0.0f;
+    }
+
     // glfw: initialize and configure
     // ------------------------------
-    glfwInit();
+    // sin pantalla se usa la plataforma nula de GLFW (no abre ninguna conexión con X11, Wayland ni Win32)
+    if (headlessRun.enabled)
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    if (!glfwInit())
+    {
+        std::cout << "Failed to initialize GLFW" << std::endl;
+        return -1;
+    }
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -120,7 +513,19 @@ int main()
 
     // glfw window creation
     // --------------------
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Exercise 16 Task 3", NULL, NULL);
+    GLFWwindow* window = NULL;
+    if (headlessRun.enabled) {
+        // contexto EGL (surfaceless o pbuffer según el driver); si no hay EGL, OSMesa
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+        window = glfwCreateWindow(headlessRun.width, headlessRun.height, "Exercise 16 Task 3", NULL, NULL);
+        if (window == NULL) {
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+            window = glfwCreateWindow(headlessRun.width, headlessRun.height, "Exercise 16 Task 3", NULL, NULL);
+        }
+    }
+    else
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Exercise 16 Task 3", NULL, NULL);
     if (window == NULL)
     {
         std::cout << "Failed to create GLFW window" << std::endl;
@@ -128,10 +533,12 @@ int main()
         return -1;
     }
     glfwMakeContextCurrent(window);
+    framePacer.Init(pacingSettings);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetKeyCallback(window, key_callback);
 
     // tell GLFW to capture our mouse
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -153,15 +560,24 @@ int main()
 
     // build and compile shaders
     // -------------------------
-    Shader ourShader("shaders/shader.vs", "shaders/shader.fs");
-    Shader slendermanShader("shaders/slenderman.vs", "shaders/slenderman.fs");
+    // Los programas enlazados se guardan en shaders/cache: los siguientes arranques los cargan con glProgramBinary
+    Shader::CacheDirectory() = "shaders/cache/";
+    // Los shaders con permutaciones compilan una variante por combinación de defines (la primera vez que se usa) en lugar de
+    // ramificar por fragmento: la linterna, el mapa emisivo del material (lo elige Mesh::Draw) y Slenderman iluminado
+    Shader ourShader("shaders/shader.vs", "shaders/shader.fs", { "HAS_EMISSIVE_MAP" }, { "FLASHLIGHT_ON" });
+    Shader slendermanShader("shaders/slenderman.vs", "shaders/slenderman.fs", {}, { "ILLUMINATED" });
     Shader overlayShader("shaders/overlay.vs", "shaders/overlay.fs");
     // Cargar shaders para los espejos
-    Shader mirrorShader("shaders/mirror.vs", "shaders/mirror.fs");
+    Shader mirrorShader("shaders/mirror.vs", "shaders/mirror.fs", {}, { "FLASHLIGHT_ON" });
     //Shader emissiveShader("shaders/luzemissive.vs", "shaders/luzemissive.fs");
     // load models
     // -----------
     Model ourModel("model/partyroom/partyroom.obj");
+    // El piso mojado refleja la sonda de la zona (reflectividad, rugosidad)
+    for (auto& mesh : ourModel.meshes) {
+        if (mesh.material.name == "MAT_Ubot_Wetfloor")
+            mesh.material.SetReflection(0.8f, 0.15f);
+    }
     Model slendermanModel("model/slenderman/slenderman.obj");
     Model skullModel("model/skull/skull.obj");
     Model bloodModel("model/blood/blood.obj");
@@ -211,6 +627,183 @@ int main()
         {glm::vec3(5.13132f, -7.80f, -41.491f), 360.0f, 0}     // Espejo 19 - pared izquierda, mira hacia la derecha
     };
 
+    if (benchmarkRun.enabled) {
+        std::vector<glm::vec3> mirrorPositions;
+        for (const auto& mirror : mirrors)
+            mirrorPositions.push_back(mirror.position);
+        setupBenchmark(mirrorPositions);
+    }
+
+    // Esferas envolventes de los espejos en espacio mundial (son estáticos, se calculan una sola vez)
+    // Se guardan como arreglos separados x/y/z/radio para el test SIMD por lotes contra el frustum
+    Model* mirrorModels[] = { &mirrorModel, &mirrorModel1, &mirrorModel2 };
+    std::vector<float> mirrorSphereX, mirrorSphereY, mirrorSphereZ, mirrorSphereRadius;
+    std::vector<unsigned char> mirrorVisible(mirrors.size(), 1);
+    mirrorReflections.Init(SCR_WIDTH, SCR_HEIGHT, PlanarReflections::Settings());
+    for (const auto& mirror : mirrors) {
+        glm::mat4 mirrorModelMatrix = glm::mat4(1.0f);
+        mirrorModelMatrix = glm::translate(mirrorModelMatrix, mirror.position);
+        mirrorModelMatrix = glm::rotate(mirrorModelMatrix, glm::radians(mirror.rotation), glm::vec3(0.0f, 1.0f, 0.0f));
+        mirrorModelMatrix = glm::scale(mirrorModelMatrix, glm::vec3(1.2f, 1.2f, 1.2f));
+        BoundingSphere worldSphere = mirrorModels[mirror.modelType]->sphere.Transformed(mirrorModelMatrix);
+        mirrorSphereX.push_back(worldSphere.center.x);
+        mirrorSphereY.push_back(worldSphere.center.y);
+        mirrorSphereZ.push_back(worldSphere.center.z);
+        mirrorSphereRadius.push_back(worldSphere.radius);
+
+        // Plano del espejo: el eje más delgado del modelo, del lado que mira hacia la zona caminable más cercana
+        const BoundingBox& localBounds = mirrorModels[mirror.modelType]->bounds;
+        glm::vec3 size = localBounds.max - localBounds.min;
+        int axis = (size.x <= size.y && size.x <= size.z) ? 0 : (size.y <= size.z ? 1 : 2);
+        glm::vec3 localNormal = glm::vec3(0.0f);
+        localNormal[axis] = 1.0f;
+        glm::vec3 worldNormal = glm::normalize(glm::vec3(mirrorModelMatrix * glm::vec4(localNormal, 0.0f)));
+        if (glm::dot(worldNormal, nearestWalkableZoneCenter(mirror.position) - mirror.position) < 0.0f) {
+            localNormal = -localNormal;
+            worldNormal = -worldNormal;
+        }
+        glm::vec3 localPoint = localBounds.Center();
+        localPoint[axis] = localNormal[axis] > 0.0f ? localBounds.max[axis] : localBounds.min[axis];
+        mirrorReflections.AddMirror(glm::vec3(mirrorModelMatrix * glm::vec4(localPoint, 1.0f)), worldNormal,
+                                    localBounds.Transformed(mirrorModelMatrix));
+    }
+
+    // El partyroom es estático, su matriz de modelo no cambia
+    glm::mat4 partyroomModelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -10.0f, -30.0f));
+
+    // Luces a partir de los mapas emisivos del partyroom (letreros, lámparas, salida...)
+    emissiveLights.Extract(ourModel.meshes, partyroomModelMatrix, EmissiveProxyLights::Settings());
+    std::cout << "Luces emisivas extraídas: " << emissiveLights.proxies.size() << std::endl;
+
+    // Celdas y portales a partir de las zonas caminables
+    cellGraph.Build(walkableZones, 0.05f, 0.25f);
+    std::cout << "Celdas de visibilidad: " << cellGraph.cells.size() << ", portales: " << cellGraph.portals.size() << std::endl;
+
+    // Asignar a cada malla estática y a cada espejo las celdas que toca (se calcula una sola vez)
+    std::vector<CellMask> partyroomMeshCells;
+    for (const auto& mesh : ourModel.meshes)
+        partyroomMeshCells.push_back(cellGraph.CellsOverlapping(mesh.bounds.Transformed(partyroomModelMatrix), cullContext.cellMargin));
+    std::vector<CellMask> mirrorCells;
+    for (size_t i = 0; i < mirrors.size(); i++)
+        mirrorCells.push_back(cellGraph.CellsContaining(glm::vec3(mirrorSphereX[i], mirrorSphereY[i], mirrorSphereZ[i]), cullContext.cellMargin));
+
+    // PVS: objetos 0..N-1 son las mallas del partyroom (también bloquean los rayos), después un objeto por espejo
+    staticVisibility.AddMeshes(ourModel.meshes, partyroomModelMatrix, true);
+    unsigned int firstMirrorObject = staticVisibility.ObjectCount();
+    for (const auto& mirror : mirrors) {
+        glm::mat4 mirrorModelMatrix = glm::mat4(1.0f);
+        mirrorModelMatrix = glm::translate(mirrorModelMatrix, mirror.position);
+        mirrorModelMatrix = glm::rotate(mirrorModelMatrix, glm::radians(mirror.rotation), glm::vec3(0.0f, 1.0f, 0.0f));
+        mirrorModelMatrix = glm::scale(mirrorModelMatrix, glm::vec3(1.2f, 1.2f, 1.2f));
+        staticVisibility.AddMeshGroup(mirrorModels[mirror.modelType]->meshes, mirrorModelMatrix, false);
+        flashlightShadow.AddStaticCasters(mirrorModels[mirror.modelType]->meshes, mirrorModelMatrix);
+    }
+    flashlightShadow.AddStaticCasters(ourModel.meshes, partyroomModelMatrix);
+    PotentiallyVisibleSet::BakeSettings pvsSettings;
+    pvsSettings.eyeHeight = camera.Position.y;
+    if (bakePvsOnly || !staticVisibility.Load(pvsPath, cellGraph, pvsSettings)) {
+        std::cout << "Horneando PVS (" << cellGraph.cells.size() << " celdas x " << staticVisibility.ObjectCount() << " objetos)..." << std::endl;
+        staticVisibility.Bake(cellGraph, pvsSettings);
+        std::cout << "PVS horneado en " << staticVisibility.stats.bakeMs << " ms, " << staticVisibility.stats.rays << " rayos, "
+                  << staticVisibility.stats.visiblePairs << " pares celda-objeto visibles" << std::endl;
+        if (!staticVisibility.Save(pvsPath))
+            std::cout << "ERROR::PVS:: no se pudo guardar " << pvsPath << std::endl;
+    }
+    else {
+        std::cout << "PVS cargado de " << pvsPath << std::endl;
+    }
+    if (bakePvsOnly) {
+        glfwTerminate();
+        return 0;
+    }
+
+    // Oclusores para el Hi-Z: las mallas grandes del partyroom (paredes, piso, techo)
+    occlusionCuller.Init(true);
+    occlusionCuller.AddOccluders(ourModel.meshes, partyroomModelMatrix, 60000, 4.0f);
+    cullContext.occlusion = &occlusionCuller;
+    std::cout << "Occlusion culling: " << (occlusionCuller.UsesGpu() ? "GPU (compute)" : "CPU (rasterizador por software)")
+              << ", " << occlusionCuller.stats.occluderTriangles << " triangulos oclusores" << std::endl;
+    glGenQueries(2, samplesPassedQueries);
+    glGenQueries(2, partyroomTimerQueries);
+
+    // Buffers de luces del clustered shading; se enlazan una vez para fijar las unidades de los samplers
+    sceneLights.Init();
+    flashlightShadow.Init(shadowSettings);
+    ourShader.use();
+    sceneLights.Bind(ourShader);
+    flashlightShadow.Bind(ourShader, false);
+
+    // Lote multi-draw indirect para el partyroom; sin OpenGL 4.3 se sigue con el dibujo malla por malla
+    Shader* levelShaderPtr = nullptr;
+    if (levelBatch.Init(ourModel.meshes))
+        levelShaderPtr = new Shader("shaders/shader_mdi.vs", "shaders/shader_mdi.fs", {}, { "FLASHLIGHT_ON" });
+    else
+        std::cout << "Multi-draw indirect no disponible (requiere OpenGL 4.3), se dibuja malla por malla" << std::endl;
+    Shader& levelShader = levelShaderPtr ? *levelShaderPtr : ourShader;
+    if (levelShaderPtr) {
+        levelShader.use();
+        sceneLights.Bind(levelShader);
+        flashlightShadow.Bind(levelShader, false);
+    }
+    std::vector<unsigned char> partyroomVisible;
+
+    // Prepaso de profundidad: mismo gl_Position que shader.vs / shader_mdi.vs (invariant) y un fragment shader vacío
+    Shader depthPrepassShader("shaders/depth_prepass.vs", "shaders/depth.fs");
+    Shader* depthPrepassMdiShaderPtr = nullptr;
+    if (levelBatch.IsSupported())
+        depthPrepassMdiShaderPtr = new Shader("shaders/depth_prepass_mdi.vs", "shaders/depth.fs");
+    std::cout << "Shaders: " << Shader::CacheStats().compiled << " compilados en " << Shader::CacheStats().compileMs << " ms, "
+              << Shader::CacheStats().loaded << " cargados del caché en " << Shader::CacheStats().loadMs << " ms ("
+              << Shader::CacheStats().rejected << " rechazados por el driver)" << std::endl;
+
+    // Sondas de reflejo: una por zona caminable a la altura de los ojos, su caja es la zona con el alto del partyroom
+    reflectionProbes.Init(ReflectionProbes::Settings());
+    BoundingBox levelBounds = ourModel.bounds.Transformed(partyroomModelMatrix);
+    for (const auto& zone : walkableZones) {
+        reflectionProbes.AddProbe(glm::vec3((zone.x + zone.y) * 0.5f, camera.Position.y, (zone.z + zone.w) * 0.5f),
+                                  glm::vec3(zone.x, levelBounds.min.y, zone.z), glm::vec3(zone.y, levelBounds.max.y, zone.w));
+    }
+    bakeReflectionProbes(ourShader, levelShader, ourModel, partyroomVisible);
+    std::cout << "Sondas de reflejo: " << reflectionProbes.stats.probes << " horneadas en " << reflectionProbes.stats.bakeMs << " ms ("
+              << reflectionProbes.GetSettings().resolution << "px, " << reflectionProbes.GetSettings().mipLevels << " mips)" << std::endl;
+    std::vector<unsigned int> mirrorProbes;
+    for (size_t i = 0; i < mirrors.size(); i++)
+        mirrorProbes.push_back(reflectionProbes.ProbeAt(glm::vec3(mirrorSphereX[i], mirrorSphereY[i], mirrorSphereZ[i])));
+
+    // Target HDR del tamaño real del framebuffer (puede ser mayor que la ventana en pantallas retina)
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    if (headlessRun.enabled) {
+        // sin pantalla el framebuffer por defecto puede no existir (contexto surfaceless): la imagen final va a un FBO
+        framebufferWidth = headlessRun.width;
+        framebufferHeight = headlessRun.height;
+        glGenRenderbuffers(1, &headlessRun.colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, headlessRun.colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, framebufferWidth, framebufferHeight);
+        glGenRenderbuffers(1, &headlessRun.depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, headlessRun.depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, framebufferWidth, framebufferHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glGenFramebuffers(1, &headlessRun.framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, headlessRun.framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headlessRun.colorBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, headlessRun.depthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::HEADLESS:: output framebuffer is not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, framebufferWidth, framebufferHeight);
+        headlessRun.frameTimes.Reserve(headlessRun.frames > 0 ? headlessRun.frames : 4096);
+        std::cout << "Sin pantalla: " << framebufferWidth << "x" << framebufferHeight << ", " << glGetString(GL_RENDERER) << std::endl;
+    }
+    hdrRenderer.Init(framebufferWidth, framebufferHeight, hdrSettings);
+    hdrRenderer.SetOutputFramebuffer(headlessRun.framebuffer);
+    dynamicResolution.Init(resolutionSettings);
+    gpuProfiler.Init(GpuProfiler::Settings());
+    if (!gpuCsvPath.empty())
+        gpuProfiler.OpenCsv(gpuCsvPath);
+    if (!gpuTracePath.empty())
+        gpuProfiler.OpenTrace(gpuTracePath);
+
     // Configurar quad para Game Over overlay
     setupGameOverQuad();
     
@@ -226,15 +819,40 @@ int main()
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
     camera.MovementSpeed = 10; //Optional. Modify the speed of the camera
+    headlessRun.startTime = headlessRun.lastFrameEnd = glfwGetTime();
+    benchmarkRun.lastFrameEnd = headlessRun.startTime;
+    // la repetición arranca en el mismo tiempo de simulación que la grabación (el daño de Slenderman lo compara)
+    simulationStart = inputRecorder.Replaying() ? inputRecorder.StartTime() : glfwGetTime();
+    if (!recordPath.empty() && inputRecorder.StartRecording(recordPath, fixedStep, simulationStart))
+        std::cout << "Grabando la entrada en " << recordPath << (fixedStep > 0.0f ? " a paso fijo" : "") << std::endl;
+    // desde acá se cuentan las reservas de cada frame; la carga no entra
+    frameArena.Init(64 * 1024);
+    frameAllocations.Init(allocationSettings);
 
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window))
     {
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        // espera al límite de FPS; el movimiento usa el tiempo suavizado para que el jitter no se note
+        deltaTime = framePacer.Frame();
+        // la resolución dinámica mide desde acá el tiempo de CPU del frame (sin la espera del límite ni el swap)
+        dynamicResolution.BeginFrame();
+        if (fixedStep > 0.0f) {
+            deltaTime = fixedStep;
+            simulationTime = simulationStart + simulationFrame * static_cast<double>(fixedStep);
+        }
+        else
+            simulationTime = glfwGetTime();
+        simulationFrame++;
+        inputRecorder.BeginFrame(static_cast<float>(simulationTime - simulationStart));
+        float currentFrame = simulationTime;
+        CPU_ZONE("Frame");
+        DrawStats::Reset();
+        if (inputRecorder.Replaying())
+            applyReplayedInput(window);
         processInput(window);
+        if (benchmarkRun.enabled)
+            updateBenchmark();
 
         // Actualizar batería de la linterna
         if (flashlightOn && flashlightBattery > 0.0f) {
@@ -246,13 +864,13 @@ int main()
             }
         }
 
-        // Verificar colisiones con calaveras para recargar batería
-        if (!gameOver && !playerWins) {
+        // Verificar colisiones con calaveras para recargar batería (el benchmark pasa el game over y la victoria él mismo)
+        if (!gameOver && !playerWins && !benchmarkRun.enabled) {
             checkSkullCollisions(camera.Position);
         }
 
         // Verificar si Slenderman causa daño al jugador
-        if (!gameOver && !playerWins) {
+        if (!gameOver && !playerWins && !benchmarkRun.enabled) {
             checkSlendermanDamage(camera.Position, slendermanPosition, currentFrame);
         }
 
@@ -263,87 +881,94 @@ int main()
             displayGameOver();
         }
 
+        // Con el HUD del profiler, los tiempos de GPU por pase van en el título de la ventana (el HUD solo dibuja barras)
+        static float lastProfilerTitle = 0.0f;
+        if (gpuProfilerHud && currentFrame - lastProfilerTitle > 0.5f) {
+            FrameString title("GPU ms: ", FrameAllocator<char>(frameArena));
+            gpuProfiler.AppendSummary(title);
+            glfwSetWindowTitle(window, title.c_str());
+            lastProfilerTitle = currentFrame;
+        }
+
         // Mostrar vidas en consola cada 10 segundos (opcional para debug)
         static float lastLifeDisplay = 0.0f;
         if (currentFrame - lastLifeDisplay > 10.0f) {
+            frameAllocations.AllowThisFrame();
             std::cout << "Vidas actuales: " << playerLives << " | Batería: " << flashlightBattery << "s" << std::endl;
+            std::cout << "Memoria: " << frameAllocations.stats.allocations << " reservas en el último frame ("
+                      << frameAllocations.stats.bytes << " bytes), " << frameAllocations.stats.framesWithAllocations << "/"
+                      << frameAllocations.stats.frames << " frames con reservas después del arranque (peor: "
+                      << frameAllocations.stats.peakAllocations << "); arena de frame " << frameArena.stats.peak << " de "
+                      << frameArena.stats.capacity << " bytes" << std::endl;
+            std::cout << "GPU por pase (ms, tecla H): " << gpuProfiler.Summary() << "; frame " << gpuProfiler.stats.frameGpuMs
+                      << " ms, " << gpuProfiler.stats.framesDropped << " frames sin resultado a tiempo" << std::endl;
+            std::cout << "Frame pacing: " << FramePacer::SwapModeName(framePacer.GetSettings().swapMode) << " (tecla Y), límite "
+                      << framePacer.GetSettings().maxFps << " FPS; frame " << framePacer.stats.meanMs << " ms de media, desviación "
+                      << framePacer.stats.stdDevMs << " ms (" << framePacer.stats.minMs << " a " << framePacer.stats.maxMs << " ms), "
+                      << framePacer.stats.hitches << " tirones en los últimos " << framePacer.GetSettings().historySize << " frames, espera "
+                      << framePacer.stats.waitMs << " ms (sobresueño " << framePacer.stats.sleepOvershootMs << " ms)" << std::endl;
+            std::cout << "Culling (último frame): " << lastFrameCullStats.culled << "/" << lastFrameCullStats.tested
+                      << " mallas fuera del frustum, " << lastFrameCullStats.portalCulled << " en celdas no visibles ("
+                      << cellGraph.VisibleCount() << "/" << cellGraph.cells.size() << " celdas visibles), "
+                      << lastFrameCullStats.pvsCulled << " fuera del PVS (" << staticVisibility.VisibleCount() << "/"
+                      << staticVisibility.ObjectCount() << " objetos estáticos), "
+                      << lastFrameCullStats.occluded << " ocluidas, "
+                      << lastFrameCullStats.Drawn() << " dibujadas" << std::endl;
+            std::cout << "Hi-Z " << (occlusionCuller.enabled ? "activado" : "desactivado") << " (tecla O): "
+                      << occlusionCuller.stats.buildMs << " ms de construcción, pirámide de hace "
+                      << occlusionCuller.stats.pyramidAge << " frames" << (occlusionCuller.stats.pyramidUsable ? "" : " (sin usar)")
+                      << ", " << lastSamplesPassed << " fragmentos sombreados" << std::endl;
+            std::cout << "Variantes de shader compiladas: escenario " << ourShader.CompiledVariants() << ", partyroom "
+                      << levelShader.CompiledVariants() << ", Slenderman " << slendermanShader.CompiledVariants() << ", espejos "
+                      << mirrorShader.CompiledVariants() << "; " << Shader::CacheStats().compiled << " programas compilados ("
+                      << Shader::CacheStats().compileMs << " ms) y " << Shader::CacheStats().loaded << " cargados del caché ("
+                      << Shader::CacheStats().loadMs << " ms)" << std::endl;
+            std::cout << "Prepaso de profundidad " << (depthPrepassEnabled ? "activado" : "desactivado") << " (tecla Z): partyroom "
+                      << partyroomTiming[1].gpuMs << " ms de GPU y overdraw " << partyroomTiming[1].overdraw << "x con prepaso, "
+                      << partyroomTiming[0].gpuMs << " ms y " << partyroomTiming[0].overdraw << "x sin prepaso" << std::endl;
+            std::cout << "Luces (clustered): " << sceneLights.stats.lights << " luces, " << sceneLights.stats.indices
+                      << " referencias en " << ClusteredLights::CLUSTER_COUNT << " clusters, máximo " << sceneLights.stats.maxPerCluster
+                      << " por cluster, " << sceneLights.stats.buildMs << " ms" << std::endl;
+            std::cout << "Sombra de la linterna (" << flashlightShadow.GetSettings().resolution << "px, PCF "
+                      << flashlightShadow.GetSettings().pcfRadius << "): " << flashlightShadow.stats.updates << " actualizaciones, "
+                      << flashlightShadow.stats.staticUpdates << " rehaciendo la parte estática; GPU "
+                      << flashlightShadow.stats.cachedGpuMs << " ms con caché, " << flashlightShadow.stats.staticGpuMs << " ms al rehacerla" << std::endl;
+            std::cout << "Reflejos " << (mirrorReflectionsEnabled ? "activados" : "desactivados") << " (tecla E): "
+                      << mirrorReflections.stats.candidates << " espejos visibles, " << mirrorReflections.stats.updated << " renderizados (máximo "
+                      << mirrorReflections.GetSettings().budget << " por frame), " << mirrorReflections.stats.stale << " con su imagen anterior, "
+                      << reflectionCull.stats.Drawn() << "/" << reflectionCull.stats.tested << " mallas dibujadas en los reflejos" << std::endl;
+            std::cout << "HDR: tone mapper " << HdrRenderer::ToneMapperName(hdrRenderer.GetSettings().toneMapper) << " (tecla T), exposición "
+                      << hdrRenderer.GetSettings().exposure << ", bloom " << hdrRenderer.stats.bloomGpuMs << " ms de GPU (presupuesto "
+                      << hdrRenderer.stats.budgetMs << " ms, " << (hdrRenderer.stats.firstLevel == 0 ? "media" : "un cuarto de")
+                      << " resolución)" << std::endl;
+            std::cout << "Resolución dinámica " << (dynamicResolution.IsEnabled() ? "activada" : "desactivada") << " (tecla V): escala "
+                      << dynamicResolution.Scale() << " (" << hdrRenderer.RenderWidth() << "x" << hdrRenderer.RenderHeight() << "), GPU en pases "
+                      << dynamicResolution.stats.gpuMs << " ms, CPU " << dynamicResolution.stats.cpuMs << " ms (objetivo "
+                      << dynamicResolution.GetSettings().targetMs << " ms" << (dynamicResolution.stats.cpuBound ? ", limitado por CPU: escala fija" : "") << "), "
+                      << dynamicResolution.stats.changes << " cambios, escalado " << HdrRenderer::UpscalerName(hdrRenderer.GetSettings().upscaler)
+                      << " (tecla U, enfoque " << hdrRenderer.GetSettings().sharpness << "); tiempo por escala:";
+            for (unsigned int level = 0; level < dynamicResolution.LevelCount(); level++)
+                if (dynamicResolution.stats.secondsAtLevel[level] > 0.0f)
+                    std::cout << " " << dynamicResolution.LevelScale(level) << "=" << dynamicResolution.stats.secondsAtLevel[level] << "s";
+            std::cout << std::endl;
+            if (multiDrawEnabled && levelBatch.IsSupported())
+                std::cout << "Partyroom: " << levelBatch.callCount << " glMultiDrawElementsIndirect (una por grupo de tamaños de textura) con "
+                          << levelBatch.drawCount << " comandos (tecla M)" << std::endl;
+            else
+                std::cout << "Partyroom: dibujo malla por malla (tecla M)" << std::endl;
             lastLifeDisplay = currentFrame;
         }
 
         // Actualizar movimiento de Slenderman solo si el juego sigue activo
         if (!gameOver && !playerWins) {
+            CPU_ZONE("Persecución Slenderman");
             slendermanMovementTimer += deltaTime;
 
-            // Calcular si Slenderman está siendo iluminado por la linternas
-            slendermanIsIlluminated = false;
-            if (flashlightOn && flashlightBattery > 0.0f) {
-                // Calcular vector de la cámara hacia Slenderman
-                glm::vec3 directionToSlenderman = glm::normalize(slendermanPosition - camera.Position);
-
-                // Calcular el ángulo entre la dirección de la cámara y la dirección hacia Slenderman
-                float dotProduct = glm::dot(camera.Front, directionToSlenderman);
-                float angleCos = dotProduct;
-
-                // Verificar si Slenderman está dentro del cono de la linterna
-                float flashlightAngle = glm::cos(glm::radians(25.0f)); // Ángulo exterior de la linterna
-                float distanceToSlenderman = glm::length(slendermanPosition - camera.Position);
-
-                // Slenderman está iluminado si está dentro del cono y a una distancia razonable
-                if (angleCos > flashlightAngle && distanceToSlenderman < 50.0f) {
-                    slendermanIsIlluminated = true;
-                }
-            }
-
-            // Solo perseguir si NO está siendo iluminado
-            if (!slendermanIsIlluminated) {
-                // Calcular la dirección hacia la cámara (jugador)
-                glm::vec3 directionToPlayer = camera.Position - slendermanPosition;
-                directionToPlayer.y = 0.0f; // Solo movimiento horizontal
-
-                // Calcular la distancia al jugador
-                float distanceToPlayer = glm::length(directionToPlayer);
-
-                // Si está muy cerca, moverse más lento para crear tensión
-                float currentSpeed = slendermanSpeed;
-                if (distanceToPlayer < 5.0f) {
-                    currentSpeed = slendermanSpeed * 0.3f; // Más lento cuando está cerca
-                }
-                else if (distanceToPlayer > 20.0f) {
-                    currentSpeed = slendermanSpeed * 1.5f; // Más rápido cuando está lejos
-                }
-
-                // Normalizar la dirección y calcular el ángulo
-                if (distanceToPlayer > 0.1f) { // Evitar división por cero
-                    directionToPlayer = glm::normalize(directionToPlayer);
-                    slendermanDirection = atan2(directionToPlayer.x, directionToPlayer.z);
-
-                    // Agregar un poco de movimiento errático ocasionalmente
-                    if (slendermanMovementTimer > 2.0f + (sin(currentFrame * 0.5f) * 1.0f)) {
-                        slendermanDirection += glm::radians((sin(currentFrame * 1.2f) * 30.0f)); // Movimiento errático sutil
-                        slendermanMovementTimer = 0.0f;
-                    }
-                }
-
-                // Calcular nueva posición de Slenderman
-                float moveX = sin(slendermanDirection) * currentSpeed * deltaTime;
-                float moveZ = cos(slendermanDirection) * currentSpeed * deltaTime;
-                glm::vec3 newPosition = slendermanPosition;
-                newPosition.x += moveX;
-                newPosition.z += moveZ;
-
-                // Mantener Slenderman dentro de los límites de la habitación
-                float roomMinX = -15.0f;
-                float roomMaxX = 15.0f;
-                float roomMinZ = -45.0f;
-                float roomMaxZ = -15.0f;
-
-                if (newPosition.x >= roomMinX && newPosition.x <= roomMaxX &&
-                    newPosition.z >= roomMinZ && newPosition.z <= roomMaxZ) {
-                    slendermanPosition.x = newPosition.x;
-                    slendermanPosition.z = newPosition.z;
-                }
-            }
-            // Si está iluminado, Slenderman se queda inmóvil (no actualizar posición)
+            // Slenderman se queda inmóvil mientras lo ilumina la linterna
+            slendermanIsIlluminated = flashlightOn && flashlightBattery > 0.0f &&
+                                      isInFlashlightCone(camera.Position, camera.Front, slendermanPosition);
+            if (!slendermanIsIlluminated)
+                steerSlenderman(slendermanPosition, slendermanDirection, slendermanMovementTimer, camera.Position, deltaTime, currentFrame);
         }
 
         // Mantener Slenderman siempre a la altura correcta (completamente visible sobre el piso)
@@ -351,6 +976,12 @@ int main()
 
         camera.Position.y = -7.5f; // Mantener la cámara a una altura fija
         
+        // Todo el frame se dibuja en el target HDR, a la escala que eligió la resolución dinámica con los frames anteriores;
+        // los overlays van después del tone mapping
+        gpuProfiler.BeginFrame();
+        hdrRenderer.SetRenderScale(dynamicResolution.Scale());
+        hdrRenderer.Begin();
+
         // Si estamos en game over o victoria, usar fondos específicos
         if (showGameOverScreen) {
             glClearColor(0.1f, 0.0f, 0.0f, 1.0f); // Fondo rojo muy oscuro para game over
@@ -364,14 +995,15 @@ int main()
         // Si estamos en game over, mostrar pantalla especial con modelos 3D
         if (showGameOverScreen) {
             ourShader.use();
-            glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 200.0f);
+            glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)hdrRenderer.Width() / (float)hdrRenderer.Height(), 0.1f, 200.0f);
             glm::mat4 view = camera.GetViewMatrix();
             
             // Renderizar la escena de Game Over con efectos especiales
+            gpuProfiler.Begin("Escena game over");
             renderGameOverScreen(ourShader, projection, view);
             
             // Configurar iluminación adicional para mejor visibilidad de los modelos
-            float gameOverTime = glfwGetTime();
+            float gameOverTime = simulationTime;
             float brightPulse = 0.8f + 0.4f * sin(gameOverTime * 2.5f);
             
             // Luz principal más brillante para Game Over
@@ -384,7 +1016,7 @@ int main()
             glm::mat4 centralSlenderman = glm::mat4(1.0f);
             centralSlenderman = glm::translate(centralSlenderman, glm::vec3(0.0f, -6.0f, -28.0f));
             centralSlenderman = glm::rotate(centralSlenderman, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-            float breathEffect = 1.0f + 0.1f * sin(glfwGetTime() * 3.0f);
+            float breathEffect = 1.0f + 0.1f * sin(simulationTime * 3.0f);
             centralSlenderman = glm::scale(centralSlenderman, glm::vec3(0.008f * breathEffect, 0.008f * breathEffect, 0.008f * breathEffect));
             ourShader.setMat4("model", centralSlenderman);
             slendermanModel.Draw(ourShader);
@@ -392,19 +1024,19 @@ int main()
             // Renderizar círculo de calaveras flotantes
             for (int i = 0; i < 8; i++) {
                 float angle = (i / 8.0f) * 2.0f * 3.14159265f;
-                float radius = 12.0f + 2.0f * sin(glfwGetTime() + i);
+                float radius = 12.0f + 2.0f * sin(simulationTime + i);
                 float x = cos(angle) * radius;
                 float z = sin(angle) * radius;
                 
                 glm::mat4 skullMatrix = glm::mat4(1.0f);
                 skullMatrix = glm::translate(skullMatrix, glm::vec3(x, -8.5f, -35.0f + z));
-                float rotationAngle = glm::degrees(angle) + glfwGetTime() * 30.0f;
+                float rotationAngle = glm::degrees(angle) + simulationTime * 30.0f;
                 skullMatrix = glm::rotate(skullMatrix, glm::radians(rotationAngle), glm::vec3(0.0f, 1.0f, 0.0f));
                 
-                float floatHeight = 1.0f * sin(glfwGetTime() * 2.0f + i);
+                float floatHeight = 1.0f * sin(simulationTime * 2.0f + i);
                 skullMatrix = glm::translate(skullMatrix, glm::vec3(0.0f, floatHeight, 0.0f));
                 
-                float scaleEffect = 2.0f + 0.5f * sin(glfwGetTime() * 3.0f + i);
+                float scaleEffect = 2.0f + 0.5f * sin(simulationTime * 3.0f + i);
                 skullMatrix = glm::scale(skullMatrix, glm::vec3(scaleEffect, scaleEffect, scaleEffect));
                 
                 ourShader.setMat4("model", skullMatrix);
@@ -422,7 +1054,7 @@ int main()
                 float bloodRotation = glm::degrees(angle);
                 bloodMatrix = glm::rotate(bloodMatrix, glm::radians(bloodRotation), glm::vec3(0.0f, 1.0f, 0.0f));
                 
-                float pulseEffect = 0.5f + 0.5f * sin(glfwGetTime() * 2.0f);
+                float pulseEffect = 0.5f + 0.5f * sin(simulationTime * 2.0f);
                 float expandEffect = 0.5f + 0.3f * pulseEffect;
                 bloodMatrix = glm::scale(bloodMatrix, glm::vec3(expandEffect, 0.1f, expandEffect));
                 
@@ -446,7 +1078,7 @@ int main()
                 float lookAngle = atan2(lookDirection.x, lookDirection.z);
                 cornerSlenderman = glm::rotate(cornerSlenderman, lookAngle, glm::vec3(0.0f, 1.0f, 0.0f));
                 
-                float swayEffect = 0.1f * sin(glfwGetTime() * 1.5f + i);
+                float swayEffect = 0.1f * sin(simulationTime * 1.5f + i);
                 float swayDegrees = swayEffect * 10.0f;
                 cornerSlenderman = glm::rotate(cornerSlenderman, glm::radians(swayDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
                 
@@ -458,22 +1090,8 @@ int main()
             // Renderizar texto "GAME OVER" usando calaveras como letras
             renderGameOverText(ourShader, projection, view);
             
-            // Renderizar las letras "GAME" usando calaveras
-            std::vector<glm::vec3> gamePositions = {
-                glm::vec3(-15.0f, -3.0f, -25.0f), // G
-                glm::vec3(-11.0f, -3.0f, -25.0f), // A
-                glm::vec3(-7.0f, -3.0f, -25.0f),  // M
-                glm::vec3(-3.0f, -3.0f, -25.0f)   // E
-            };
-            
-            std::vector<glm::vec3> overPositions = {
-                glm::vec3(3.0f, -3.0f, -25.0f),   // O
-                glm::vec3(7.0f, -3.0f, -25.0f),   // V
-                glm::vec3(11.0f, -3.0f, -25.0f),  // E
-                glm::vec3(15.0f, -3.0f, -25.0f)   // R
-            };
-            
-            float textTime = glfwGetTime();
+            // Renderizar las letras "GAME" y "OVER" usando calaveras (posiciones en gamePositions y overPositions)
+            float textTime = simulationTime;
             float letterFloat = 0.5f * sin(textTime * 1.5f);
             
             // Renderizar "GAME" 
@@ -509,14 +1127,6 @@ int main()
             }
             
             // Renderizar texto de instrucciones usando charcos de sangre más pequeños
-            std::vector<glm::vec3> instructionPositions = {
-                glm::vec3(-8.0f, -6.0f, -25.0f),   // "Press"
-                glm::vec3(-4.0f, -6.0f, -25.0f),   // "R"
-                glm::vec3(0.0f, -6.0f, -25.0f),    // "to"
-                glm::vec3(4.0f, -6.0f, -25.0f),    // "Restart"
-                glm::vec3(8.0f, -6.0f, -25.0f)     // "..."
-            };
-            
             for (int i = 0; i < instructionPositions.size(); i++) {
                 glm::mat4 instructionMatrix = glm::mat4(1.0f);
                 float instructionFloat = 0.2f * sin(textTime * 2.5f + i * 0.3f);
@@ -529,22 +1139,37 @@ int main()
                 bloodModel.Draw(ourShader);
             }
             
-            // Renderizar overlay PNG de Game Over encima de todo
+            gpuProfiler.End();
+
+            // Bloom y tone mapping, después el overlay PNG de Game Over encima de todo
+            gpuProfiler.Begin("Post HDR");
+            hdrRenderer.End();
+            gpuProfiler.End();
+            gpuProfiler.Begin("Overlay");
             renderGameOverOverlay(overlayShader, gameOverTexture);
+            gpuProfiler.End();
+            if (gpuProfilerHud)
+                gpuProfiler.DrawHud(hdrRenderer.Width(), hdrRenderer.Height());
+            gpuProfiler.EndFrame();
+            dynamicResolution.EndFrame(deltaTime, gpuProfiler.stats.passGpuMs, gpuProfiler.stats.framesRead);
             
-            glfwSwapBuffers(window);
+            {
+                CPU_ZONE("SwapBuffers");
+                presentFrame(window);
+            }
             glfwPollEvents();
             continue;
         }
 
         // Si estamos en pantalla de victoria, mostrar escena de celebración
         if (showVictoryScreen) {
+            gpuProfiler.Begin("Escena victoria");
             ourShader.use();
-            glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 200.0f);
+            glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)hdrRenderer.Width() / (float)hdrRenderer.Height(), 0.1f, 200.0f);
             glm::mat4 view = camera.GetViewMatrix();
             
             // Configurar iluminación dorada para victoria
-            float victoryTime = glfwGetTime();
+            float victoryTime = simulationTime;
             float goldenPulse = 0.9f + 0.3f * sin(victoryTime * 1.5f);
             
             ourShader.setMat4("projection", projection);
@@ -562,7 +1187,7 @@ int main()
             ourShader.setFloat("light.quadratic", 0.0019f);
             
             // Configurar linterna para efectos adicionales
-            ourShader.setBool("flashlightOn", true);
+            ourShader.SetFeature("FLASHLIGHT_ON", true);
             ourShader.setVec3("flashlight.position", camera.Position);
             ourShader.setVec3("flashlight.direction", camera.Front);
             ourShader.setFloat("flashlight.cutOff", glm::cos(glm::radians(25.0f)));
@@ -575,12 +1200,17 @@ int main()
             ourShader.setFloat("flashlight.quadratic", 0.0019f);
             
             ourShader.setFloat("time", victoryTime);
+
+            // Sin luces del cluster en la celebración
+            sceneLights.Clear();
+            sceneLights.Build(view, projection, 0.1f, 200.0f);
+            sceneLights.Bind(ourShader);
+            flashlightShadow.Bind(ourShader, false); // el cono dorado es más ancho que el del mapa de sombras
             
             // Renderizar el escenario principal con iluminación dorada
             glm::mat4 model = glm::mat4(1.0f);
             model = glm::translate(model, glm::vec3(0.0f, -10.0f, -30.0f));
             ourShader.setMat4("model", model);
-            ourShader.setBool("hasEmissiveMap", false);
             ourModel.Draw(ourShader);
             
             // Renderizar espejos flotantes celebrando
@@ -590,9 +1220,11 @@ int main()
                 mirrorShader.setMat4("projection", projection);
                 mirrorShader.setMat4("view", view);
                 mirrorShader.setVec3("viewPos", camera.Position);
+                mirrorShader.setBool("hasReflection", false); // los espejos se mueven, su imagen ya no corresponde
+                mirrorShader.setBool("hasProbe", false);
                 
                 // Configurar iluminación dorada para espejos
-                mirrorShader.setBool("flashlightOn", true);
+                mirrorShader.SetFeature("FLASHLIGHT_ON", true);
                 mirrorShader.setVec3("flashlight.position", camera.Position);
                 mirrorShader.setVec3("flashlight.direction", camera.Front);
                 mirrorShader.setFloat("flashlight.cutOff", glm::cos(glm::radians(25.0f)));
@@ -634,10 +1266,24 @@ int main()
                 }
             }
             
-            // Renderizar overlay PNG de Victoria encima de todo
+            gpuProfiler.End();
+
+            // Bloom y tone mapping, después el overlay PNG de Victoria encima de todo
+            gpuProfiler.Begin("Post HDR");
+            hdrRenderer.End();
+            gpuProfiler.End();
+            gpuProfiler.Begin("Overlay");
             renderGameOverOverlay(overlayShader, victoryTexture);
+            gpuProfiler.End();
+            if (gpuProfilerHud)
+                gpuProfiler.DrawHud(hdrRenderer.Width(), hdrRenderer.Height());
+            gpuProfiler.EndFrame();
+            dynamicResolution.EndFrame(deltaTime, gpuProfiler.stats.passGpuMs, gpuProfiler.stats.framesRead);
             
-            glfwSwapBuffers(window);
+            {
+                CPU_ZONE("SwapBuffers");
+                presentFrame(window);
+            }
             glfwPollEvents();
             continue;
         }
@@ -645,46 +1291,152 @@ int main()
         ourShader.use();
 
         // Configura todos los uniforms
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 200.0f);
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)hdrRenderer.Width() / (float)hdrRenderer.Height(), 0.1f, 200.0f);
         glm::mat4 view = camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-        ourShader.setVec3("viewPos", camera.Position);
-        ourShader.setFloat("material.shininess", 16.0f);
-
-        // Luz principal tenue para ambiente de discoteca
-        ourShader.setVec3("light.position", 0.0f, 5.0f, -15.0f);
-        ourShader.setVec3("light.ambient", 0.05f, 0.05f, 0.1f);  // Muy tenue y azulado
-        ourShader.setVec3("light.diffuse", 0.4f, 0.2f, 0.6f);    // Púrpura para ambiente disco
-        ourShader.setVec3("light.specular", 0.6f, 0.4f, 0.8f);
-        ourShader.setFloat("light.constant", 1.0f);
-        ourShader.setFloat("light.linear", 0.045f);
-        ourShader.setFloat("light.quadratic", 0.0075f);
-
-        // Configuración de la linterna (más brillante para contraste)
-        ourShader.setBool("flashlightOn", flashlightOn && flashlightBattery > 0.0f);
+        // Luces dinámicas del frame (se reparten en los clusters de cada cámara que las usa: reflejos y jugador)
+        sceneLights.Clear();
+        addSceneLights(currentFrame, camera.Position);
+
+        // Mapa de sombras de la linterna: paredes desde la caché, Slenderman y las calaveras encima
         if (flashlightOn && flashlightBattery > 0.0f) {
-            ourShader.setVec3("flashlight.position", camera.Position);
-            ourShader.setVec3("flashlight.direction", camera.Front);
-            ourShader.setFloat("flashlight.cutOff", glm::cos(glm::radians(8.0f)));
-            ourShader.setFloat("flashlight.outerCutOff", glm::cos(glm::radians(12.0f)));
-            ourShader.setVec3("flashlight.ambient", 0.0f, 0.0f, 0.0f);
-            ourShader.setVec3("flashlight.diffuse", 1.0f, 1.0f, 0.9f);  // Luz cálida
-            ourShader.setVec3("flashlight.specular", 1.0f, 1.0f, 1.0f);
-            ourShader.setFloat("flashlight.constant", 1.0f);
-            ourShader.setFloat("flashlight.linear", 0.022f);
-            ourShader.setFloat("flashlight.quadratic", 0.0019f);
+            gpuProfiler.Begin("Sombra linterna");
+            flashlightShadow.ClearDynamicCasters();
+            flashlightShadow.AddDynamicCaster(slendermanModel, getSlendermanModelMatrix());
+            for (int i = 0; i < static_cast<int>(skullPositions.size()); i++) {
+                if (!skullCollected[i])
+                    flashlightShadow.AddDynamicCaster(skullModel, getSkullModelMatrix(i));
+            }
+            flashlightShadow.Update(camera.Position, camera.Front, flashlightOuterCutOff);
+            gpuProfiler.End();
+        }
+
+        // Frustum de la cámara para descartar mallas fuera de la vista
+        cullContext.frustum.Update(projection * view);
+        cullContext.stats.Reset();
+
+        // Celdas visibles desde la celda de la cámara a través de los portales
+        cullContext.cells = portalCullingEnabled ? &cellGraph : nullptr;
+        if (portalCullingEnabled)
+            cellGraph.ComputeVisibleCells(camera.Position, projection * view);
+
+        // Geometría estática: conjunto horneado de la celda de la cámara (la parte dinámica usa portales y Hi-Z)
+        staticVisibility.UpdateCamera(camera.Position);
+
+        // Espejos visibles: primero se descartan por lotes (4 esferas por instrucción SIMD) los que están fuera del frustum,
+        // después los que no están en el PVS (o en una celda visible)
+        cullContext.frustum.CullSpheres(mirrorSphereX.data(), mirrorSphereY.data(), mirrorSphereZ.data(), mirrorSphereRadius.data(),
+                                        static_cast<unsigned int>(mirrors.size()), mirrorVisible.data());
+        for (int i = 0; i < static_cast<int>(mirrors.size()); ++i) {
+            unsigned int meshCount = static_cast<unsigned int>(mirrorModels[mirrors[i].modelType]->meshes.size());
+            cullContext.stats.tested += meshCount;
+            if (staticVisibility.IsReady() && !staticVisibility.IsVisible(firstMirrorObject + i)) {
+                cullContext.stats.pvsCulled += meshCount;
+                mirrorVisible[i] = 0;
+            }
+            else if (!staticVisibility.IsReady() && portalCullingEnabled && !cellGraph.IsVisible(mirrorCells[i])) {
+                cullContext.stats.portalCulled += meshCount;
+                mirrorVisible[i] = 0;
+            }
+            else if (!mirrorVisible[i]) {
+                cullContext.stats.culled += meshCount;
+            }
+        }
+
+        // Reflejos: solo se vuelven a renderizar los espejos más importantes, el resto reutiliza su última imagen
+        reflectionCull.stats.Reset();
+        if (mirrorReflectionsEnabled) {
+            gpuProfiler.Begin("Reflejos");
+            const std::vector<unsigned int>& scheduledMirrors = mirrorReflections.Schedule(camera.Position, projection * view, mirrorVisible.data());
+            for (unsigned int i = 0; i < scheduledMirrors.size(); i++) {
+                PlanarReflections::View reflected = mirrorReflections.Begin(scheduledMirrors[i], view, projection, camera.Position);
+                renderMirrorReflection(reflected, projection, ourShader, levelShader, slendermanShader, ourModel, slendermanModel,
+                                       skullModel, partyroomVisible, currentFrame);
+                mirrorReflections.End();
+            }
+            gpuProfiler.End();
         }
 
-        ourShader.setFloat("time", currentFrame);
+        // Pirámide Hi-Z de los oclusores para descartar mallas ocultas detrás de las paredes
+        gpuProfiler.Begin("Hi-Z");
+        occlusionCuller.Build(projection * view);
+        gpuProfiler.End();
+
+        // Luces en los clusters de la cámara del jugador (después del Hi-Z, que deja activo su propio shader)
+        sceneLights.Build(view, projection, 0.1f, 200.0f);
+        setSceneUniforms(ourShader, projection, view, camera.Position, currentFrame);
+
+        // Medir la carga de fragmentos del frame y el tiempo del partyroom (se leen los resultados del frame anterior para no bloquear)
+        unsigned int queryIndex = samplesPassedQueryFrame % 2;
+        unsigned int previousIndex = (samplesPassedQueryFrame + 1) % 2;
+        if (samplesPassedQueryFrame > 0) {
+            GLint available = 0;
+            glGetQueryObjectiv(samplesPassedQueries[previousIndex], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                glGetQueryObjectui64v(samplesPassedQueries[previousIndex], GL_QUERY_RESULT, &lastSamplesPassed);
+                partyroomTiming[partyroomQueryPrepass[previousIndex]].overdraw =
+                    (float)lastSamplesPassed / (float)(hdrRenderer.RenderWidth() * hdrRenderer.RenderHeight());
+            }
+            glGetQueryObjectiv(partyroomTimerQueries[previousIndex], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(partyroomTimerQueries[previousIndex], GL_QUERY_RESULT, &elapsed);
+                partyroomTiming[partyroomQueryPrepass[previousIndex]].gpuMs = elapsed / 1000000.0f;
+            }
+        }
+        partyroomQueryPrepass[queryIndex] = depthPrepassEnabled;
+        glBeginQuery(GL_TIME_ELAPSED, partyroomTimerQueries[queryIndex]);
+        gpuProfiler.Begin("Partyroom");
 
         // Renderizar el escenario principal
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, glm::vec3(0.0f, -10.0f, -30.0f));
-        ourShader.setMat4("model", model);
-        ourModel.Draw(ourShader);
+        bool partyroomMultiDraw = multiDrawEnabled && levelBatch.IsSupported();
+        ourModel.Cull(model, cullContext, partyroomVisible, partyroomMeshCells.data(), &staticVisibility, 0);
+
+        // Prepaso: solo profundidad de las mallas visibles, sin escribir color
+        if (depthPrepassEnabled) {
+            gpuProfiler.Begin("Prepaso");
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            Shader& prepassShader = partyroomMultiDraw ? *depthPrepassMdiShaderPtr : depthPrepassShader;
+            prepassShader.use();
+            prepassShader.setMat4("projection", projection);
+            prepassShader.setMat4("view", view);
+            if (partyroomMultiDraw) {
+                levelBatch.DrawDepth(model, partyroomVisible.data());
+            }
+            else {
+                prepassShader.setMat4("model", model);
+                ourModel.DrawDepth(partyroomVisible);
+            }
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            // El pase de color solo sombrea el fragmento que quedó en el depth buffer
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+            gpuProfiler.End();
+        }
+
+        // Los fragmentos sombreados se cuentan desde aquí: con el prepaso activo el partyroom aporta uno por píxel
+        glBeginQuery(GL_SAMPLES_PASSED, samplesPassedQueries[queryIndex]);
+        if (partyroomMultiDraw) {
+            // Una llamada por grupo de tamaños de textura, no por malla: la lista de comandos solo lleva las mallas que pasaron el culling
+            setSceneUniforms(levelShader, projection, view, camera.Position, currentFrame);
+            levelBatch.Draw(levelShader, model, partyroomVisible.data());
+        }
+        else {
+            ourShader.use();
+            ourShader.setMat4("model", model);
+            ourModel.Draw(ourShader, partyroomVisible);
+        }
+        ourShader.use();
+        if (depthPrepassEnabled) {
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+        }
+        gpuProfiler.End();
+        glEndQuery(GL_TIME_ELAPSED);
 
         // Renderizar Slenderman con su shader específico
+        gpuProfiler.Begin("Slenderman");
         slendermanShader.use();
 
         // Configurar los uniforms para el shader de Slenderman
@@ -693,24 +1445,16 @@ int main()
         slendermanShader.setVec3("viewPos", camera.Position);
         slendermanShader.setVec3("lightPos", camera.Position); // La luz sigue al jugador para efectos dramáticos
         slendermanShader.setFloat("time", currentFrame);
-        slendermanShader.setBool("isIlluminated", slendermanIsIlluminated); // Estado de iluminación
-
-        glm::mat4 slendermanModelMatrix = glm::mat4(1.0f);
-        slendermanModelMatrix = glm::translate(slendermanModelMatrix, slendermanPosition);
+        slendermanShader.SetFeature("ILLUMINATED", slendermanIsIlluminated); // Estado de iluminación
 
-        // Hacer que Slenderman siempre mire hacia el jugador
-        glm::vec3 lookDirection = camera.Position - slendermanPosition;
-        lookDirection.y = 0.0f; // Solo rotación horizontal
-        if (glm::length(lookDirection) > 0.1f) {
-            float lookAngle = atan2(lookDirection.x, lookDirection.z);
-            slendermanModelMatrix = glm::rotate(slendermanModelMatrix, lookAngle, glm::vec3(0.0f, 1.0f, 0.0f));
-        }
-
-        slendermanModelMatrix = glm::scale(slendermanModelMatrix, glm::vec3(0.005f, 0.005f, 0.005f)); // Mucho más pequeño, tamaño humano
+        glm::mat4 slendermanModelMatrix = getSlendermanModelMatrix();
         slendermanShader.setMat4("model", slendermanModelMatrix);
-        slendermanModel.Draw(slendermanShader);
+        slendermanModel.Draw(slendermanShader, slendermanModelMatrix, cullContext);
+
+        gpuProfiler.End();
 
         // Volver a usar el shader principal para skulls y blood
+        gpuProfiler.Begin("Calaveras");
         ourShader.use();
 
         // Renderizar skull
@@ -719,166 +1463,137 @@ int main()
 
         // Skull 1 - centro de la habitación principal
         if (!skullCollected[0]) {
-            glm::mat4 skullModelMatrix1 = glm::mat4(1.0f);
-            skullModelMatrix1 = glm::translate(skullModelMatrix1, glm::vec3(-4.0f, -9.3f, -39.0f)); // Centro de la habitación
-            skullModelMatrix1 = glm::rotate(skullModelMatrix1, glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f)); 
-            skullModelMatrix1 = glm::scale(skullModelMatrix1, glm::vec3(1.8f, 1.8f, 1.8f)); 
+            glm::mat4 skullModelMatrix1 = getSkullModelMatrix(0);
             ourShader.setMat4("model", skullModelMatrix1);
-            ourShader.setBool("hasEmissiveMap", false);
-            skullModel.Draw(ourShader);
+            skullModel.Draw(ourShader, skullModelMatrix1, cullContext);
         }
 
         // Skull 2 - esquina izquierda de la habitación
         if (!skullCollected[1]) {
-            glm::mat4 skullModelMatrix2 = glm::mat4(1.0f);
-            skullModelMatrix2 = glm::translate(skullModelMatrix2, glm::vec3(-10.0f, -9.3f, -45.0f)); // Esquina izquierda
-            skullModelMatrix2 = glm::rotate(skullModelMatrix2, glm::radians(120.0f), glm::vec3(0.0f, 1.0f, 0.0f)); 
-            skullModelMatrix2 = glm::scale(skullModelMatrix2, glm::vec3(1.8f, 1.8f, 1.8f)); 
+            glm::mat4 skullModelMatrix2 = getSkullModelMatrix(1);
             ourShader.setMat4("model", skullModelMatrix2);
-            ourShader.setBool("hasEmissiveMap", false);
-            skullModel.Draw(ourShader);
+            skullModel.Draw(ourShader, skullModelMatrix2, cullContext);
         }
 
         // Skull 3 - esquina derecha de la habitación
         if (!skullCollected[2]) {
-            glm::mat4 skullModelMatrix3 = glm::mat4(1.0f);
-            skullModelMatrix3 = glm::translate(skullModelMatrix3, glm::vec3(2.0f, -9.3f, -50.0f)); // Esquina derecha
-            skullModelMatrix3 = glm::rotate(skullModelMatrix3, glm::radians(-60.0f), glm::vec3(0.0f, 1.0f, 0.0f)); 
-            skullModelMatrix3 = glm::scale(skullModelMatrix3, glm::vec3(1.8f, 1.8f, 1.8f)); 
+            glm::mat4 skullModelMatrix3 = getSkullModelMatrix(2);
             ourShader.setMat4("model", skullModelMatrix3);
-            ourShader.setBool("hasEmissiveMap", false);
-            skullModel.Draw(ourShader);
+            skullModel.Draw(ourShader, skullModelMatrix3, cullContext);
         }
 
         // Skull 4 - zona central-frontal de la habitación
         if (!skullCollected[3]) {
-            glm::mat4 skullModelMatrix4 = glm::mat4(1.0f);
-            skullModelMatrix4 = glm::translate(skullModelMatrix4, glm::vec3(-6.0f, -9.3f, -25.0f)); // Zona frontal
-            skullModelMatrix4 = glm::rotate(skullModelMatrix4, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f)); 
-            skullModelMatrix4 = glm::scale(skullModelMatrix4, glm::vec3(1.8f, 1.8f, 1.8f)); 
+            glm::mat4 skullModelMatrix4 = getSkullModelMatrix(3);
             ourShader.setMat4("model", skullModelMatrix4);
-            ourShader.setBool("hasEmissiveMap", false);
-            skullModel.Draw(ourShader);
+            skullModel.Draw(ourShader, skullModelMatrix4, cullContext);
         }
 
         // Skull 5 - zona posterior de la habitación
         if (!skullCollected[4]) {
-            glm::mat4 skullModelMatrix5 = glm::mat4(1.0f);
-            skullModelMatrix5 = glm::translate(skullModelMatrix5, glm::vec3(1.0f, -9.3f, -55.0f)); // Zona posterior
-            skullModelMatrix5 = glm::rotate(skullModelMatrix5, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)); 
-            skullModelMatrix5 = glm::scale(skullModelMatrix5, glm::vec3(1.8f, 1.8f, 1.8f)); 
+            glm::mat4 skullModelMatrix5 = getSkullModelMatrix(4);
             ourShader.setMat4("model", skullModelMatrix5);
-            ourShader.setBool("hasEmissiveMap", false);
-            skullModel.Draw(ourShader);
+            skullModel.Draw(ourShader, skullModelMatrix5, cullContext);
         }
 
         // Skull 6 - zona lateral izquierda
         if (!skullCollected[5]) {
-            glm::mat4 skullModelMatrix6 = glm::mat4(1.0f);
-            skullModelMatrix6 = glm::translate(skullModelMatrix6, glm::vec3(-8.0f, -9.3f, -33.0f)); // Lateral izquierda
-            skullModelMatrix6 = glm::rotate(skullModelMatrix6, glm::radians(270.0f), glm::vec3(0.0f, 1.0f, 0.0f)); 
-            skullModelMatrix6 = glm::scale(skullModelMatrix6, glm::vec3(1.8f, 1.8f, 1.8f)); 
+            glm::mat4 skullModelMatrix6 = getSkullModelMatrix(5);
             ourShader.setMat4("model", skullModelMatrix6);
-            ourShader.setBool("hasEmissiveMap", false);
-            skullModel.Draw(ourShader);
+            skullModel.Draw(ourShader, skullModelMatrix6, cullContext);
         }
 
         // Skull 7 - zona lateral derecha
         if (!skullCollected[6]) {
-            glm::mat4 skullModelMatrix7 = glm::mat4(1.0f);
-            skullModelMatrix7 = glm::translate(skullModelMatrix7, glm::vec3(0.0f, -9.3f, -30.0f)); // Lateral derecha
-            skullModelMatrix7 = glm::rotate(skullModelMatrix7, glm::radians(15.0f), glm::vec3(0.0f, 1.0f, 0.0f)); 
-            skullModelMatrix7 = glm::scale(skullModelMatrix7, glm::vec3(1.8f, 1.8f, 1.8f)); 
+            glm::mat4 skullModelMatrix7 = getSkullModelMatrix(6);
             ourShader.setMat4("model", skullModelMatrix7);
-            ourShader.setBool("hasEmissiveMap", false);
-            skullModel.Draw(ourShader);
+            skullModel.Draw(ourShader, skullModelMatrix7, cullContext);
         }
 
+        gpuProfiler.End();
+
         // Renderizar múltiples charcos de sangre por el escenario
-        // Configurar luz ambiente tenue para la sangre
-        ourShader.setVec3("light.position", 0.0f, -5.0f, -28.0f);
-        ourShader.setVec3("light.ambient", 0.1f, 0.02f, 0.02f); // Luz rojiza tenue
-        ourShader.setVec3("light.diffuse", 0.3f, 0.05f, 0.05f);
-        ourShader.setVec3("light.specular", 0.2f, 0.02f, 0.02f);
-        ourShader.setFloat("light.constant", 1.0f);
-        ourShader.setFloat("light.linear", 0.09f);
-        ourShader.setFloat("light.quadratic", 0.032f);
-        ourShader.setBool("hasEmissiveMap", false); // La sangre no brilla
+        gpuProfiler.Begin("Sangre");
+        // (la luz rojiza de cada charco es una luz del cluster, ya no se pisa la luz principal a mitad del frame)
 
         // Charco de sangre 1 - cerca del skull central
         glm::mat4 bloodMatrix1 = glm::mat4(1.0f);
-        bloodMatrix1 = glm::translate(bloodMatrix1, glm::vec3(-2.0f, -9.2f, -40.0f)); // Cerca del skull central
+        bloodMatrix1 = glm::translate(bloodMatrix1, bloodPuddlePositions[0]); // Cerca del skull central
         bloodMatrix1 = glm::rotate(bloodMatrix1, glm::radians(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         bloodMatrix1 = glm::scale(bloodMatrix1, glm::vec3(0.4f, 0.1f, 0.4f)); 
         ourShader.setMat4("model", bloodMatrix1);
-        bloodModel.Draw(ourShader);
+        bloodModel.Draw(ourShader, bloodMatrix1, cullContext);
 
         // Charco de sangre 2 - esquina izquierda de la habitación
         glm::mat4 bloodMatrix2 = glm::mat4(1.0f);
-        bloodMatrix2 = glm::translate(bloodMatrix2, glm::vec3(-8.0f, -9.2f, -47.0f)); // Esquina izquierda
+        bloodMatrix2 = glm::translate(bloodMatrix2, bloodPuddlePositions[1]); // Esquina izquierda
         bloodMatrix2 = glm::rotate(bloodMatrix2, glm::radians(45.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         bloodMatrix2 = glm::scale(bloodMatrix2, glm::vec3(0.3f, 0.1f, 0.5f)); 
         ourShader.setMat4("model", bloodMatrix2);
-        bloodModel.Draw(ourShader);
+        bloodModel.Draw(ourShader, bloodMatrix2, cullContext);
 
         // Charco de sangre 3 - cerca del área derecha
         glm::mat4 bloodMatrix3 = glm::mat4(1.0f);
-        bloodMatrix3 = glm::translate(bloodMatrix3, glm::vec3(0.0f, -9.2f, -52.0f)); // Área derecha
+        bloodMatrix3 = glm::translate(bloodMatrix3, bloodPuddlePositions[2]); // Área derecha
         bloodMatrix3 = glm::rotate(bloodMatrix3, glm::radians(-30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         bloodMatrix3 = glm::scale(bloodMatrix3, glm::vec3(0.4f, 0.1f, 0.3f)); 
         ourShader.setMat4("model", bloodMatrix3);
-        bloodModel.Draw(ourShader);
+        bloodModel.Draw(ourShader, bloodMatrix3, cullContext);
 
         // Charco de sangre 4 - zona central
         glm::mat4 bloodMatrix4 = glm::mat4(1.0f);
-        bloodMatrix4 = glm::translate(bloodMatrix4, glm::vec3(-4.0f, -9.2f, -35.0f)); // Zona central
+        bloodMatrix4 = glm::translate(bloodMatrix4, bloodPuddlePositions[3]); // Zona central
         bloodMatrix4 = glm::rotate(bloodMatrix4, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         bloodMatrix4 = glm::scale(bloodMatrix4, glm::vec3(0.5f, 0.1f, 0.3f)); 
         ourShader.setMat4("model", bloodMatrix4);
-        bloodModel.Draw(ourShader);
+        bloodModel.Draw(ourShader, bloodMatrix4, cullContext);
 
         // Charco de sangre 5 - zona posterior de la habitación
         glm::mat4 bloodMatrix5 = glm::mat4(1.0f);
-        bloodMatrix5 = glm::translate(bloodMatrix5, glm::vec3(-1.0f, -9.2f, -57.0f)); // Zona posterior
+        bloodMatrix5 = glm::translate(bloodMatrix5, bloodPuddlePositions[4]); // Zona posterior
         bloodMatrix5 = glm::rotate(bloodMatrix5, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         bloodMatrix5 = glm::scale(bloodMatrix5, glm::vec3(0.3f, 0.1f, 0.2f)); 
         ourShader.setMat4("model", bloodMatrix5);
-        bloodModel.Draw(ourShader);
+        bloodModel.Draw(ourShader, bloodMatrix5, cullContext);
 
         // Charco de sangre 6 - zona frontal izquierda
         glm::mat4 bloodMatrix6 = glm::mat4(1.0f);
-        bloodMatrix6 = glm::translate(bloodMatrix6, glm::vec3(-9.0f, -9.2f, -30.0f)); // Zona frontal izquierda
+        bloodMatrix6 = glm::translate(bloodMatrix6, bloodPuddlePositions[5]); // Zona frontal izquierda
         bloodMatrix6 = glm::rotate(bloodMatrix6, glm::radians(135.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         bloodMatrix6 = glm::scale(bloodMatrix6, glm::vec3(0.4f, 0.1f, 0.1f)); 
         ourShader.setMat4("model", bloodMatrix6);
-        bloodModel.Draw(ourShader);
+        bloodModel.Draw(ourShader, bloodMatrix6, cullContext);
 
         // Charco de sangre 7 - zona frontal derecha
         glm::mat4 bloodMatrix7 = glm::mat4(1.0f);
-        bloodMatrix7 = glm::translate(bloodMatrix7, glm::vec3(2.0f, -9.2f, -28.0f)); // Zona frontal derecha
+        bloodMatrix7 = glm::translate(bloodMatrix7, bloodPuddlePositions[6]); // Zona frontal derecha
         bloodMatrix7 = glm::rotate(bloodMatrix7, glm::radians(-60.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         bloodMatrix7 = glm::scale(bloodMatrix7, glm::vec3(0.3f, 0.1f, 0.1f)); 
         ourShader.setMat4("model", bloodMatrix7);
-        bloodModel.Draw(ourShader);
+        bloodModel.Draw(ourShader, bloodMatrix7, cullContext);
 
         // Charco de sangre 8 - en el pasillo
         glm::mat4 bloodMatrix8 = glm::mat4(1.0f);
-        bloodMatrix8 = glm::translate(bloodMatrix8, glm::vec3(8.0f, -9.2f, -49.0f)); // Zona del pasillo
+        bloodMatrix8 = glm::translate(bloodMatrix8, bloodPuddlePositions[7]); // Zona del pasillo
         bloodMatrix8 = glm::rotate(bloodMatrix8, glm::radians(30.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         bloodMatrix8 = glm::scale(bloodMatrix8, glm::vec3(0.3f, 0.1f, 0.2f)); 
         ourShader.setMat4("model", bloodMatrix8);
-        bloodModel.Draw(ourShader);
+        bloodModel.Draw(ourShader, bloodMatrix8, cullContext);
+        gpuProfiler.End();
 
-        // Renderizar los espejos
+        // Renderizar los espejos (la visibilidad ya se calculó antes de los reflejos)
+        gpuProfiler.Begin("Espejos");
         for (int i = 0; i < static_cast<int>(mirrors.size()); ++i) {
             const auto& mirror = mirrors[i];
+            if (!mirrorVisible[i])
+                continue;
             mirrorShader.use();
             mirrorShader.setMat4("projection", projection);
             mirrorShader.setMat4("view", view);
             mirrorShader.setVec3("viewPos", camera.Position);
 
             // Configurar uniforms de la linterna para los espejos
-            mirrorShader.setBool("flashlightOn", flashlightOn);
+            mirrorShader.SetFeature("FLASHLIGHT_ON", flashlightOn);
             if (flashlightOn) {
                 mirrorShader.setVec3("flashlight.position", camera.Position);
                 mirrorShader.setVec3("flashlight.direction", camera.Front);
@@ -897,32 +1612,386 @@ int main()
             mirrorModelMatrix = glm::rotate(mirrorModelMatrix, glm::radians(mirror.rotation), glm::vec3(0.0f, 1.0f, 0.0f));
             mirrorModelMatrix = glm::scale(mirrorModelMatrix, glm::vec3(1.2f, 1.2f, 1.2f)); // Espejos más grandes (era 0.5f)
             mirrorShader.setMat4("model", mirrorModelMatrix);
+            mirrorReflections.Bind(mirrorShader, i);
+            if (!mirrorReflectionsEnabled)
+                mirrorShader.setBool("hasReflection", false);
+            reflectionProbes.Bind(mirrorShader, reflectionProbesEnabled ? mirrorProbes[i] : reflectionProbes.ProbeCount());
 
             // Seleccionar el modelo según el tipo
-            switch (mirror.modelType) {
-            case 0:
-                mirrorModel.Draw(mirrorShader);
-                break;
-            case 1:
-                mirrorModel1.Draw(mirrorShader);
-                break;
-            case 2:
-                mirrorModel2.Draw(mirrorShader);
-                break;
-            }
+            mirrorModels[mirror.modelType]->Draw(mirrorShader, mirrorModelMatrix, cullContext);
+        }
+        gpuProfiler.End();
+
+        glEndQuery(GL_SAMPLES_PASSED);
+        samplesPassedQueryFrame++;
+        lastFrameCullStats = cullContext.stats;
+
+        gpuProfiler.Begin("Post HDR");
+        hdrRenderer.End();
+        gpuProfiler.End();
+        if (gpuProfilerHud)
+            gpuProfiler.DrawHud(hdrRenderer.Width(), hdrRenderer.Height());
+        gpuProfiler.EndFrame();
+        dynamicResolution.EndFrame(deltaTime, gpuProfiler.stats.passGpuMs, gpuProfiler.stats.framesRead);
+        {
+            CPU_ZONE("SwapBuffers");
+            presentFrame(window);
         }
-
-        glfwSwapBuffers(window);
         glfwPollEvents();
 
     }
 
+    delete levelShaderPtr;
+    delete depthPrepassMdiShaderPtr;
+    gpuProfiler.Close();
+    occlusionCuller.Release();
+    inputRecorder.Stop();
+    if (CpuProfiler::Recording())
+        CpuProfiler::WriteTrace(cpuTracePath);
+    if (headlessRun.enabled) {
+        FrameStats::Summary summary = headlessRun.frameTimes.Summarize();
+        std::cout << "Sin pantalla: " << summary.frames << " frames en " << summary.seconds << " s (" << summary.fps << " FPS), frame "
+                  << summary.meanMs << " ms de media, desviación " << summary.stdDevMs << " ms, mínimo " << summary.minMs
+                  << " ms, p50 " << summary.p50Ms << " ms, p95 " << summary.p95Ms << " ms, p99 " << summary.p99Ms << " ms, máximo "
+                  << summary.maxMs << " ms" << std::endl;
+        std::cout << "GPU (último frame medido): " << gpuProfiler.Summary() << std::endl;
+        std::cout << "Memoria: " << frameAllocations.stats.framesWithAllocations << "/" << frameAllocations.stats.frames
+                  << " frames con reservas después del arranque, " << frameAllocations.stats.totalAllocations
+                  << " reservas (peor frame: " << frameAllocations.stats.peakAllocations << "); arena de frame "
+                  << frameArena.stats.peak << " de " << frameArena.stats.capacity << " bytes" << std::endl;
+        glDeleteFramebuffers(1, &headlessRun.framebuffer);
+        glDeleteRenderbuffers(1, &headlessRun.colorBuffer);
+        glDeleteRenderbuffers(1, &headlessRun.depthBuffer);
+    }
+
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
     return 0;
 }
 
+// glfw: las teclas se leen con inputRecorder.GetKey en processInput; este callback solo las graba
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    inputRecorder.RecordKey(key, action);
+}
+
+// Repetición: aplica los eventos grabados antes de este frame, en el orden en que llegaron (las teclas quedan en el
+// estado de inputRecorder para processInput)
+void applyReplayedInput(GLFWwindow* window)
+{
+    InputRecorder::Event event;
+    while (inputRecorder.NextEvent(event)) {
+        if (event.type == InputRecorder::EventType::Cursor)
+            camera.ProcessMouseMovement(event.x, event.y);
+        else if (event.type == InputRecorder::EventType::Scroll)
+            camera.ProcessMouseScroll(event.y);
+        else if (event.type == InputRecorder::EventType::MouseButton)
+            mouseButton(event.code, event.action);
+        else if (event.type == InputRecorder::EventType::End) {
+            std::cout << "Repetición terminada: " << inputRecorder.stats.replayed << " eventos en " << simulationFrame
+                      << " frames" << std::endl;
+            glfwSetWindowShouldClose(window, true);
+        }
+    }
+}
+
+// Tramos del benchmark. Los pasillos se recorren por los centros de walkableZones (la rama norte ida y vuelta, después
+// la sur); cada grupo de espejos se mira desde el centro de una zona caminable cercana, acercándose un poco a cada
+// espejo del grupo. Los grupos son los bloques de la lista de espejos de main, en su orden
+void setupBenchmark(const std::vector<glm::vec3>& mirrorPositions) {
+    const float eyeHeight = -7.5f;
+    auto zoneCenter = [&](int zone) {
+        const glm::vec4& z = walkableZones[zone];
+        return glm::vec3((z.x + z.y) * 0.5f, eyeHeight, (z.z + z.w) * 0.5f);
+    };
+
+    BenchmarkSegment room;
+    room.name = "Discoteca";
+    room.frames = 600;
+    const glm::vec2 roomPath[] = { glm::vec2(0.0f, -32.0f), glm::vec2(-8.0f, -23.0f), glm::vec2(-10.0f, -40.0f),
+                                   glm::vec2(-8.0f, -56.0f), glm::vec2(1.5f, -56.0f), glm::vec2(1.5f, -42.0f),
+                                   glm::vec2(-4.0f, -30.0f), glm::vec2(0.0f, -24.0f), glm::vec2(2.0f, -49.5f) };
+    for (const glm::vec2& point : roomPath)
+        room.path.Add(glm::vec3(point.x, eyeHeight, point.y));
+    room.path.Build();
+    benchmarkRun.segments.push_back(room);
+
+    BenchmarkSegment corridors;
+    corridors.name = "Pasillos";
+    corridors.frames = 900;
+    const int corridorZones[] = { 1, 2, 3, 4, 5, 6, 5, 4, 3, 2, 8, 7, 9, 10, 11, 12 };
+    for (int zone : corridorZones)
+        corridors.path.Add(zoneCenter(zone));
+    corridors.path.Build();
+    benchmarkRun.segments.push_back(corridors);
+
+    // primer espejo de cada grupo y zona desde donde se mira
+    const unsigned int groupStart[] = { 0, 3, 6, 10, 13 };
+    const int groupZone[] = { 2, 9, 11, 4, 6 };
+    const unsigned int groups = sizeof(groupStart) / sizeof(groupStart[0]);
+    for (unsigned int g = 0; g < groups; g++) {
+        unsigned int end = g + 1 < groups ? groupStart[g + 1] : static_cast<unsigned int>(mirrorPositions.size());
+        if (groupStart[g] >= end || end > mirrorPositions.size())
+            continue;
+        BenchmarkSegment segment;
+        segment.name = "Espejos " + std::to_string(g + 1);
+        segment.frames = 180;
+        glm::vec3 viewpoint = zoneCenter(groupZone[g]);
+        for (unsigned int m = groupStart[g]; m < end; m++) {
+            glm::vec3 toMirror = mirrorPositions[m] - viewpoint;
+            toMirror.y = 0.0f;
+            glm::vec3 offset = glm::length(toMirror) > 0.01f ? glm::normalize(toMirror) * 0.5f : glm::vec3(0.0f);
+            segment.path.Add(viewpoint + offset, mirrorPositions[m]);
+        }
+        segment.path.Build();
+        benchmarkRun.segments.push_back(segment);
+    }
+
+    BenchmarkSegment gameOverSegment;
+    gameOverSegment.name = "Game over";
+    gameOverSegment.frames = 240;
+    gameOverSegment.ending = 1;
+    benchmarkRun.segments.push_back(gameOverSegment);
+
+    BenchmarkSegment victorySegment;
+    victorySegment.name = "Victoria";
+    victorySegment.frames = 240;
+    victorySegment.ending = 2;
+    benchmarkRun.segments.push_back(victorySegment);
+
+    unsigned int frames = benchmarkRun.warmupFrames;
+    for (BenchmarkSegment& segment : benchmarkRun.segments) {
+        segment.frameTimes.Reserve(segment.frames);
+        frames += segment.frames;
+    }
+    benchmarkRun.total.Reserve(frames);
+    std::cout << "Benchmark: " << benchmarkRun.segments.size() << " tramos, " << frames << " frames (" << benchmarkRun.warmupFrames
+              << " de calentamiento)" << std::endl;
+}
+
+// Pose de la cámara y estado del juego del frame que empieza
+void updateBenchmark() {
+    if (benchmarkRun.segment >= benchmarkRun.segments.size())
+        return;
+    BenchmarkSegment& segment = benchmarkRun.segments[benchmarkRun.segment];
+    if (segment.ending != 0) {
+        if (benchmarkRun.frame == 0 && benchmarkRun.warmup >= benchmarkRun.warmupFrames) {
+            resetGame();
+            if (segment.ending == 1)
+                gameOver = true;
+            else {
+                playerWins = true;
+                showVictoryScreen = true;
+            }
+        }
+        return;
+    }
+
+    // la linterna encendida todo el recorrido, con su mapa de sombras
+    flashlightOn = true;
+    flashlightBattery = maxBattery;
+    float fraction = benchmarkRun.warmup < benchmarkRun.warmupFrames || segment.frames < 2 ? 0.0f
+                     : static_cast<float>(benchmarkRun.frame) / (segment.frames - 1);
+    CameraPath::Pose pose = segment.path.Sample(fraction);
+    camera.Position = pose.position;
+    glm::vec3 direction = pose.target - pose.position;
+    if (glm::length(direction) > 0.001f) {
+        direction = glm::normalize(direction);
+        camera.Yaw = glm::degrees(atan2(direction.z, direction.x));
+        camera.Pitch = glm::degrees(asin(glm::clamp(direction.y, -1.0f, 1.0f)));
+        camera.ProcessMouseMovement(0.0f, 0.0f); // recalcula Front, Right y Up con el nuevo Yaw y Pitch
+    }
+}
+
+// Cuenta el frame en su tramo: tiempo entre swaps (o hasta glFinish sin pantalla), draw calls, triángulos y el último
+// frame de GPU leído. El profiler de GPU lee los frames FRAMES - 1 después, así que los primeros frames de GPU de un
+// tramo son los últimos del anterior
+void recordBenchmarkFrame(GLFWwindow* window) {
+    double now = glfwGetTime();
+    float frameSeconds = static_cast<float>(now - benchmarkRun.lastFrameEnd);
+    benchmarkRun.lastFrameEnd = now;
+    if (benchmarkRun.warmup < benchmarkRun.warmupFrames) {
+        benchmarkRun.warmup++;
+        benchmarkRun.gpuFramesRead = gpuProfiler.stats.framesRead;
+        return;
+    }
+    if (benchmarkRun.segment >= benchmarkRun.segments.size())
+        return;
+
+    BenchmarkSegment& segment = benchmarkRun.segments[benchmarkRun.segment];
+    segment.frameTimes.Add(frameSeconds);
+    benchmarkRun.total.Add(frameSeconds);
+    segment.drawCalls += DrawStats::Calls();
+    segment.triangles += DrawStats::Triangles();
+    segment.allocations += frameAllocations.stats.allocations;
+    if (gpuProfiler.stats.framesRead != benchmarkRun.gpuFramesRead) {
+        benchmarkRun.gpuFramesRead = gpuProfiler.stats.framesRead;
+        segment.gpuMs += gpuProfiler.stats.frameGpuMs;
+        segment.gpuFrames++;
+        for (const GpuProfiler::Scope& scope : gpuProfiler.Results()) {
+            if (scope.depth != 0)
+                continue;
+            unsigned int pass = 0;
+            while (pass < segment.gpuPasses.size() && segment.gpuPasses[pass].first != scope.name)
+                pass++;
+            if (pass == segment.gpuPasses.size()) {
+                segment.gpuPasses.push_back(std::make_pair(std::string(scope.name), 0.0));
+                frameAllocations.AllowThisFrame();
+            }
+            segment.gpuPasses[pass].second += scope.gpuMs;
+        }
+    }
+
+    if (++benchmarkRun.frame < segment.frames)
+        return;
+    frameAllocations.AllowThisFrame();
+    FrameStats::Summary summary = segment.frameTimes.Summarize();
+    std::cout << "Benchmark " << segment.name << ": " << summary.meanMs << " ms de media, p50 " << summary.p50Ms << ", p95 "
+              << summary.p95Ms << ", p99 " << summary.p99Ms << ", máximo " << summary.maxMs << " ms; "
+              << segment.drawCalls / segment.frames << " draw calls y " << segment.triangles / segment.frames
+              << " triángulos por frame, GPU " << (segment.gpuFrames ? segment.gpuMs / segment.gpuFrames : 0.0) << " ms" << std::endl;
+    benchmarkRun.frame = 0;
+    if (++benchmarkRun.segment < benchmarkRun.segments.size())
+        return;
+    writeBenchmarkJson();
+    glfwSetWindowShouldClose(window, true);
+}
+
+// Resultados del benchmark en JSON: un objeto por tramo y el total, en ms por frame
+bool writeBenchmarkJson() {
+    FILE* file = std::fopen(benchmarkRun.outputPath.c_str(), "w");
+    if (!file) {
+        std::cout << "ERROR::BENCHMARK:: no se puede crear " << benchmarkRun.outputPath << std::endl;
+        return false;
+    }
+    std::string renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    for (char& c : renderer)
+        if (c == '"' || c == '\\')
+            c = '\'';
+    std::fprintf(file, "{\n  \"renderer\": \"%s\",\n  \"resolution\": [%d, %d],\n  \"fixedStep\": %.6f,\n  \"warmupFrames\": %u,\n  \"segments\": [",
+                 renderer.c_str(), hdrRenderer.Width(), hdrRenderer.Height(), fixedStep, benchmarkRun.warmupFrames);
+    for (unsigned int i = 0; i < benchmarkRun.segments.size(); i++) {
+        const BenchmarkSegment& segment = benchmarkRun.segments[i];
+        FrameStats::Summary summary = segment.frameTimes.Summarize();
+        unsigned int frames = std::max(segment.frames, 1u);
+        std::fprintf(file, "%s\n    {\"name\": \"%s\", \"frames\": %u, \"meanMs\": %.4f, \"stdDevMs\": %.4f, \"p50Ms\": %.4f, "
+                           "\"p95Ms\": %.4f, \"p99Ms\": %.4f, \"maxMs\": %.4f, \"drawCalls\": %.1f, \"triangles\": %.1f, \"allocations\": %.2f, \"gpuMs\": %.4f, \"gpuPasses\": {",
+                     i ? "," : "", segment.name.c_str(), summary.frames, summary.meanMs, summary.stdDevMs, summary.p50Ms, summary.p95Ms,
+                     summary.p99Ms, summary.maxMs, static_cast<double>(segment.drawCalls) / frames,
+                     static_cast<double>(segment.triangles) / frames, static_cast<double>(segment.allocations) / frames, segment.gpuFrames ? segment.gpuMs / segment.gpuFrames : 0.0);
+        for (unsigned int p = 0; p < segment.gpuPasses.size(); p++)
+            std::fprintf(file, "%s\"%s\": %.4f", p ? ", " : "", segment.gpuPasses[p].first.c_str(),
+                         segment.gpuFrames ? segment.gpuPasses[p].second / segment.gpuFrames : 0.0);
+        std::fprintf(file, "}}");
+    }
+    FrameStats::Summary total = benchmarkRun.total.Summarize();
+    std::fprintf(file, "\n  ],\n  \"total\": {\"frames\": %u, \"seconds\": %.4f, \"fps\": %.2f, \"meanMs\": %.4f, \"stdDevMs\": %.4f, "
+                       "\"p50Ms\": %.4f, \"p95Ms\": %.4f, \"p99Ms\": %.4f, \"maxMs\": %.4f}\n}\n",
+                 total.frames, total.seconds, total.fps, total.meanMs, total.stdDevMs, total.p50Ms, total.p95Ms, total.p99Ms, total.maxMs);
+    std::fclose(file);
+    std::cout << "Benchmark: " << total.frames << " frames, " << total.meanMs << " ms de media (p99 " << total.p99Ms
+              << " ms), resultados en " << benchmarkRun.outputPath << std::endl;
+    return true;
+}
+
+// Microbenchmarks de la lógica que corre cada frame, con entradas sintéticas de 1 a 100k elementos. Una operación es
+// una llamada con todos los elementos (todas las zonas, calaveras o agentes), así ns/op dividido por el tamaño da el
+// costo por elemento. Las entradas salen de un generador fijo: dos corridas miden exactamente lo mismo
+void runMicroBenchmarks(const MicroBenchmark::Settings& settings, const std::string& csvPath) {
+    MicroBenchmark bench(settings);
+    const unsigned int sizes[] = { 1, 10, 100, 1000, 10000, 100000 };
+    unsigned int seed = 12345u;
+    auto random = [&seed](float minimum, float maximum) {
+        seed = seed * 1664525u + 1013904223u;
+        return minimum + (maximum - minimum) * static_cast<float>(seed >> 8) / 16777216.0f;
+    };
+    // posiciones del jugador que se recorren en orden, dentro del área del mapa
+    std::vector<glm::vec3> players(256);
+    for (glm::vec3& player : players)
+        player = glm::vec3(random(-60.0f, 60.0f), -7.5f, random(-120.0f, 0.0f));
+
+    bench.PrintHeader();
+    for (unsigned int size : sizes) {
+        // zonas de 2x2 a 10x10 repartidas por un mapa que crece con la cantidad, casi todas fallan (recorrido completo)
+        float extent = 60.0f + std::sqrt(static_cast<float>(size)) * 8.0f;
+        std::vector<glm::vec4> zones(size);
+        for (glm::vec4& zone : zones) {
+            float x = random(-extent, extent), z = random(-extent, extent);
+            zone = glm::vec4(x, x + random(2.0f, 10.0f), z, z + random(2.0f, 10.0f));
+        }
+        bench.Run("isPlayerInAllowedZone", size, [&](unsigned long long i) {
+            return isPlayerInAllowedZone(players[i & 255], zones);
+        });
+    }
+
+    // checkSkullCollisions y getSkullModelMatrix trabajan sobre las calaveras del juego: se cambian por otras sintéticas
+    // (para las colisiones, lejos del jugador: ninguna se recoge y cada llamada las recorre todas) y al final se devuelven
+    std::vector<glm::vec3> savedPositions = skullPositions;
+    std::vector<bool> savedCollected = skullCollected;
+    std::vector<float> savedRotations = skullRotations;
+    for (unsigned int size : sizes) {
+        skullPositions.resize(size);
+        for (glm::vec3& position : skullPositions)
+            position = glm::vec3(random(-60.0f, 60.0f), 1000.0f, random(-120.0f, 0.0f));
+        skullCollected.assign(size, false);
+        bench.Run("checkSkullCollisions", size, [&](unsigned long long i) {
+            checkSkullCollisions(players[i & 255]);
+            return skullCollected.size();
+        });
+    }
+    skullPositions = savedPositions;
+    skullCollected = savedCollected;
+
+    for (unsigned int size : sizes) {
+        std::vector<glm::vec3> agents(size);
+        for (glm::vec3& agent : agents)
+            agent = glm::vec3(random(-60.0f, 60.0f), random(-9.0f, -6.0f), random(-120.0f, 0.0f));
+        const glm::vec3 front = glm::normalize(glm::vec3(0.3f, -0.1f, -1.0f));
+        bench.Run("isInFlashlightCone", size, [&](unsigned long long i) {
+            unsigned int illuminated = 0;
+            for (const glm::vec3& agent : agents)
+                illuminated += isInFlashlightCone(players[i & 255], front, agent) ? 1 : 0;
+            return illuminated;
+        });
+
+        std::vector<float> directions(size), timers(size);
+        for (unsigned int a = 0; a < size; a++) {
+            directions[a] = random(-3.14159f, 3.14159f);
+            timers[a] = random(0.0f, 3.0f);
+        }
+        bench.Run("steerSlenderman", size, [&](unsigned long long i) {
+            float time = static_cast<float>(i) / 60.0f;
+            for (unsigned int a = 0; a < size; a++) {
+                timers[a] += 1.0f / 60.0f;
+                steerSlenderman(agents[a], directions[a], timers[a], players[i & 255], 1.0f / 60.0f, time);
+            }
+            return agents[0];
+        });
+    }
+
+    // getSkullModelMatrix: translate, rotate y scale de glm por cada prop
+    for (unsigned int size : sizes) {
+        skullPositions.resize(size);
+        skullRotations.resize(size);
+        for (unsigned int p = 0; p < size; p++) {
+            skullPositions[p] = glm::vec3(random(-60.0f, 60.0f), -9.3f, random(-120.0f, 0.0f));
+            skullRotations[p] = random(0.0f, 360.0f);
+        }
+        bench.Run("getSkullModelMatrix", size, [&](unsigned long long) {
+            float sum = 0.0f;
+            for (unsigned int p = 0; p < size; p++)
+                sum += getSkullModelMatrix(static_cast<int>(p))[3][0];
+            return sum;
+        });
+    }
+    skullPositions = savedPositions;
+    skullRotations = savedRotations;
+
+    if (!csvPath.empty() && bench.WriteCsv(csvPath))
+        std::cout << "Microbenchmarks guardados en " << csvPath << std::endl;
+}
+
 bool isPlayerInAllowedZone(glm::vec3 position, const std::vector<glm::vec4>& zones) {
     for (const auto& zone : zones) {
         // Comprueba si la posición está dentro de los límites de la zona actual
@@ -944,17 +2013,7 @@ bool isPlayerNearSkull(glm::vec3 playerPos, glm::vec3 skullPos, float radius) {
 
 // Función para verificar colisiones con todas las calaveras
 void checkSkullCollisions(glm::vec3 playerPos) {
-    // Posiciones de las calaveras (deben coincidir con las del render)
-    std::vector<glm::vec3> skullPositions = {
-        glm::vec3(-4.0f, -9.3f, -39.0f),  // Skull 1
-        glm::vec3(-10.0f, -9.3f, -45.0f), // Skull 2
-        glm::vec3(2.0f, -9.3f, -50.0f),   // Skull 3
-        glm::vec3(-6.0f, -9.3f, -25.0f),  // Skull 4
-        glm::vec3(1.0f, -9.3f, -55.0f),   // Skull 5
-        glm::vec3(-8.0f, -9.3f, -33.0f),  // Skull 6
-        glm::vec3(0.0f, -9.3f, -30.0f)    // Skull 7
-    };
-
+    CPU_ZONE("checkSkullCollisions");
     for (int i = 0; i < skullPositions.size(); i++) {
         if (!skullCollected[i] && isPlayerNearSkull(playerPos, skullPositions[i], 2.0f)) {
             // Jugador pisó una calavera nueva
@@ -985,6 +2044,7 @@ void checkSkullCollisions(glm::vec3 playerPos) {
 
 // Función para verificar si Slenderman causa daño al jugador
 void checkSlendermanDamage(glm::vec3 playerPos, glm::vec3 slendermanPos, float currentTime) {
+    CPU_ZONE("checkSlendermanDamage");
     float distance = glm::length(playerPos - slendermanPos);
     
     // Si Slenderman está muy cerca y ha pasado suficiente tiempo desde el último daño
@@ -1054,7 +2114,7 @@ void renderGameOverScreen(Shader& shader, glm::mat4 projection, glm::mat4 view)
     shader.setVec3("viewPos", camera.Position);
     shader.setFloat("material.shininess", 16.0f);
     
-    float currentTime = glfwGetTime();
+    float currentTime = simulationTime;
     float flickerEffect = 0.8f + 0.2f * sin(currentTime * 3.0f);
     float pulseEffect = 0.7f + 0.3f * sin(currentTime * 2.0f);
     
@@ -1067,24 +2127,27 @@ void renderGameOverScreen(Shader& shader, glm::mat4 projection, glm::mat4 view)
     shader.setFloat("light.linear", 0.022f); // Menor atenuación para más alcance
     shader.setFloat("light.quadratic", 0.0019f);
     
-    // Añadir una segunda luz desde arriba para mejor visibilidad
-    shader.setVec3("light2.position", 0.0f, 10.0f, -35.0f);
-    shader.setVec3("light2.ambient", 0.4f * pulseEffect, 0.05f, 0.05f);
-    shader.setVec3("light2.diffuse", 1.0f * pulseEffect, 0.2f, 0.2f);
-    shader.setVec3("light2.specular", 0.8f, 0.3f, 0.3f);
-    shader.setFloat("light2.constant", 1.0f);
-    shader.setFloat("light2.linear", 0.045f);
-    shader.setFloat("light2.quadratic", 0.0075f);
+    // Añadir una segunda luz desde arriba para mejor visibilidad (luz del cluster, el shader no tiene light2)
+    sceneLights.Clear();
+    ClusteredLights::Light topLight;
+    topLight.position = glm::vec3(0.0f, 10.0f, -35.0f);
+    topLight.radius = 60.0f;
+    topLight.color = glm::vec3(1.0f * pulseEffect, 0.2f, 0.2f);
+    topLight.ambient = 0.4f;
+    topLight.linear = 0.045f;
+    topLight.quadratic = 0.0075f;
+    sceneLights.Add(topLight);
+    sceneLights.Build(view, projection, 0.1f, 200.0f);
+    sceneLights.Bind(shader);
     
     // Desactivar linterna durante Game Over
-    shader.setBool("flashlightOn", false);
+    shader.SetFeature("FLASHLIGHT_ON", false);
     shader.setFloat("time", currentTime);
-    shader.setBool("hasEmissiveMap", false);
 }
 
 // Función para renderizar texto de Game Over usando modelos 3D
 void renderGameOverText(Shader& shader, glm::mat4 projection, glm::mat4 view) {
-    float currentTime = glfwGetTime();
+    float currentTime = simulationTime;
     float textPulse = 0.8f + 0.4f * sin(currentTime * 2.0f);
     float letterFloat = 0.5f * sin(currentTime * 1.5f);
     
@@ -1094,21 +2157,6 @@ void renderGameOverText(Shader& shader, glm::mat4 projection, glm::mat4 view) {
     shader.setVec3("light.diffuse", 2.0f * textPulse, 0.3f, 0.3f);
     shader.setVec3("light.specular", 1.5f, 0.4f, 0.4f);
     
-    // Posiciones para las letras "GAME OVER" usando calaveras
-    std::vector<glm::vec3> gamePositions = {
-        glm::vec3(-15.0f, -3.0f, -25.0f), // G
-        glm::vec3(-11.0f, -3.0f, -25.0f), // A
-        glm::vec3(-7.0f, -3.0f, -25.0f),  // M
-        glm::vec3(-3.0f, -3.0f, -25.0f)   // E
-    };
-    
-    std::vector<glm::vec3> overPositions = {
-        glm::vec3(3.0f, -3.0f, -25.0f),   // O
-        glm::vec3(7.0f, -3.0f, -25.0f),   // V
-        glm::vec3(11.0f, -3.0f, -25.0f),  // E
-        glm::vec3(15.0f, -3.0f, -25.0f)   // R
-    };
-    
     // Renderizar "GAME" 
     for (int i = 0; i < gamePositions.size(); i++) {
         glm::mat4 letterMatrix = glm::mat4(1.0f);
@@ -1142,15 +2190,6 @@ void renderGameOverText(Shader& shader, glm::mat4 projection, glm::mat4 view) {
         
         shader.setMat4("model", letterMatrix);
     }
-    
-    // Texto de instrucciones usando charcos de sangre más pequeños
-    std::vector<glm::vec3> instructionPositions = {
-        glm::vec3(-8.0f, -6.0f, -25.0f),   // "Press"
-        glm::vec3(-4.0f, -6.0f, -25.0f),   // "R"
-        glm::vec3(0.0f, -6.0f, -25.0f),    // "to"
-        glm::vec3(4.0f, -6.0f, -25.0f),    // "Restart"
-        glm::vec3(8.0f, -6.0f, -25.0f)     // "..."
-    };
 }
 
 // Función para cargar textura desde archivo
@@ -1239,7 +2278,7 @@ void renderGameOverOverlay(Shader& shader, unsigned int gameOverTexture) {
     shader.setMat4("model", model);
     
     // Efecto de fade in/out
-    float currentTime = glfwGetTime();
+    float currentTime = simulationTime;
     float alpha = 0.7f + 0.3f * sin(currentTime * 2.0f); // Pulsación de transparencia
     shader.setFloat("alpha", alpha);
     
@@ -1251,6 +2290,7 @@ void renderGameOverOverlay(Shader& shader, unsigned int gameOverTexture) {
     // Render quad
     glBindVertexArray(gameOverVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
+    DrawStats::Count(2);
     glBindVertexArray(0);
     
     // Reactivar depth test
@@ -1258,21 +2298,276 @@ void renderGameOverOverlay(Shader& shader, unsigned int gameOverTexture) {
     glDisable(GL_BLEND);
 }
 
+// Uniforms de cámara (eye es la posición desde la que se ve: el jugador o su reflejo), luz principal y linterna comunes a los shaders del escenario (shader.fs y shader_mdi.fs)
+void setSceneUniforms(Shader& shader, const glm::mat4& projection, const glm::mat4& view, const glm::vec3& eye, float currentFrame) {
+    shader.use();
+    shader.setMat4("projection", projection);
+    shader.setMat4("view", view);
+    shader.setVec3("viewPos", eye);
+    shader.setFloat("material.shininess", 16.0f);
+
+    // Luz principal tenue para ambiente de discoteca
+    shader.setVec3("light.position", 0.0f, 5.0f, -15.0f);
+    shader.setVec3("light.ambient", 0.05f, 0.05f, 0.1f);  // Muy tenue y azulado
+    shader.setVec3("light.diffuse", 0.4f, 0.2f, 0.6f);    // Púrpura para ambiente disco
+    shader.setVec3("light.specular", 0.6f, 0.4f, 0.8f);
+    shader.setFloat("light.constant", 1.0f);
+    shader.setFloat("light.linear", 0.045f);
+    shader.setFloat("light.quadratic", 0.0075f);
+
+    // Configuración de la linterna (más brillante para contraste)
+    shader.SetFeature("FLASHLIGHT_ON", flashlightOn && flashlightBattery > 0.0f);
+    if (flashlightOn && flashlightBattery > 0.0f) {
+        shader.setVec3("flashlight.position", camera.Position);
+        shader.setVec3("flashlight.direction", camera.Front);
+        shader.setFloat("flashlight.cutOff", glm::cos(glm::radians(flashlightCutOff)));
+        shader.setFloat("flashlight.outerCutOff", glm::cos(glm::radians(flashlightOuterCutOff)));
+        shader.setVec3("flashlight.ambient", 0.0f, 0.0f, 0.0f);
+        shader.setVec3("flashlight.diffuse", 1.0f, 1.0f, 0.9f);  // Luz cálida
+        shader.setVec3("flashlight.specular", 1.0f, 1.0f, 1.0f);
+        shader.setFloat("flashlight.constant", 1.0f);
+        shader.setFloat("flashlight.linear", 0.022f);
+        shader.setFloat("flashlight.quadratic", 0.0019f);
+    }
+
+    shader.setFloat("time", currentFrame);
+    sceneLights.Bind(shader);
+    flashlightShadow.Bind(shader, flashlightOn && flashlightBattery > 0.0f);
+    // sonda de la zona del jugador, también para los reflejos de los espejos (que ven la misma zona)
+    reflectionProbes.Bind(shader, reflectionProbesEnabled ? reflectionProbes.ProbeAt(camera.Position) : reflectionProbes.ProbeCount());
+}
+
+// Matriz de modelo de la calavera index a partir de skullPositions y skullRotations
+glm::mat4 getSkullModelMatrix(int index) {
+    CPU_ZONE("getSkullModelMatrix");
+    glm::mat4 skullModelMatrix = glm::mat4(1.0f);
+    skullModelMatrix = glm::translate(skullModelMatrix, skullPositions[index]);
+    skullModelMatrix = glm::rotate(skullModelMatrix, glm::radians(skullRotations[index]), glm::vec3(0.0f, 1.0f, 0.0f));
+    skullModelMatrix = glm::scale(skullModelMatrix, glm::vec3(1.8f, 1.8f, 1.8f));
+    return skullModelMatrix;
+}
+
+// Si target está dentro del cono de la linterna (ángulo exterior) que sale de eye hacia front, a una distancia razonable
+bool isInFlashlightCone(const glm::vec3& eye, const glm::vec3& front, const glm::vec3& target) {
+    // Calcular vector de la cámara hacia el objetivo
+    glm::vec3 directionToTarget = glm::normalize(target - eye);
+
+    // Calcular el ángulo entre la dirección de la cámara y la dirección hacia el objetivo
+    float angleCos = glm::dot(front, directionToTarget);
+
+    float flashlightAngle = glm::cos(glm::radians(25.0f)); // Ángulo exterior de la linterna
+    float distanceToTarget = glm::length(target - eye);
+    return angleCos > flashlightAngle && distanceToTarget < 50.0f;
+}
+
+// Persecución de Slenderman en un frame: camina hacia el jugador (más lento cerca, más rápido lejos), con un giro
+// errático de vez en cuando, sin salir de la habitación
+void steerSlenderman(glm::vec3& position, float& direction, float& movementTimer, const glm::vec3& player, float deltaTime, float currentFrame) {
+    // Calcular la dirección hacia la cámara (jugador)
+    glm::vec3 directionToPlayer = player - position;
+    directionToPlayer.y = 0.0f; // Solo movimiento horizontal
+
+    // Calcular la distancia al jugador
+    float distanceToPlayer = glm::length(directionToPlayer);
+
+    // Si está muy cerca, moverse más lento para crear tensión
+    float currentSpeed = slendermanSpeed;
+    if (distanceToPlayer < 5.0f) {
+        currentSpeed = slendermanSpeed * 0.3f; // Más lento cuando está cerca
+    }
+    else if (distanceToPlayer > 20.0f) {
+        currentSpeed = slendermanSpeed * 1.5f; // Más rápido cuando está lejos
+    }
+
+    // Normalizar la dirección y calcular el ángulo
+    if (distanceToPlayer > 0.1f) { // Evitar división por cero
+        directionToPlayer = glm::normalize(directionToPlayer);
+        direction = atan2(directionToPlayer.x, directionToPlayer.z);
+
+        // Agregar un poco de movimiento errático ocasionalmente
+        if (movementTimer > 2.0f + (sin(currentFrame * 0.5f) * 1.0f)) {
+            direction += glm::radians((sin(currentFrame * 1.2f) * 30.0f)); // Movimiento errático sutil
+            movementTimer = 0.0f;
+        }
+    }
+
+    // Calcular nueva posición
+    float moveX = sin(direction) * currentSpeed * deltaTime;
+    float moveZ = cos(direction) * currentSpeed * deltaTime;
+    glm::vec3 newPosition = position;
+    newPosition.x += moveX;
+    newPosition.z += moveZ;
+
+    // Mantener Slenderman dentro de los límites de la habitación
+    float roomMinX = -15.0f;
+    float roomMaxX = 15.0f;
+    float roomMinZ = -45.0f;
+    float roomMaxZ = -15.0f;
+
+    if (newPosition.x >= roomMinX && newPosition.x <= roomMaxX &&
+        newPosition.z >= roomMinZ && newPosition.z <= roomMaxZ) {
+        position.x = newPosition.x;
+        position.z = newPosition.z;
+    }
+}
+
+// Matriz de modelo de Slenderman: en su posición actual y siempre mirando hacia el jugador
+glm::mat4 getSlendermanModelMatrix() {
+    CPU_ZONE("getSlendermanModelMatrix");
+    glm::mat4 slendermanModelMatrix = glm::mat4(1.0f);
+    slendermanModelMatrix = glm::translate(slendermanModelMatrix, slendermanPosition);
+
+    // Hacer que Slenderman siempre mire hacia el jugador
+    glm::vec3 lookDirection = camera.Position - slendermanPosition;
+    lookDirection.y = 0.0f; // Solo rotación horizontal
+    if (glm::length(lookDirection) > 0.1f) {
+        float lookAngle = atan2(lookDirection.x, lookDirection.z);
+        slendermanModelMatrix = glm::rotate(slendermanModelMatrix, lookAngle, glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    slendermanModelMatrix = glm::scale(slendermanModelMatrix, glm::vec3(0.005f, 0.005f, 0.005f)); // Mucho más pequeño, tamaño humano
+    return slendermanModelMatrix;
+}
+
+// Centro de la zona caminable más cercana a position (para orientar los espejos hacia el interior)
+glm::vec3 nearestWalkableZoneCenter(glm::vec3 position) {
+    glm::vec3 nearestCenter = position;
+    float nearestDistance = 1e30f;
+    for (const auto& zone : walkableZones) {
+        glm::vec2 closest = glm::clamp(glm::vec2(position.x, position.z), glm::vec2(zone.x, zone.z), glm::vec2(zone.y, zone.w));
+        float distance = glm::length(closest - glm::vec2(position.x, position.z));
+        if (distance < nearestDistance) {
+            nearestDistance = distance;
+            nearestCenter = glm::vec3((zone.x + zone.y) * 0.5f, position.y, (zone.z + zone.w) * 0.5f);
+        }
+    }
+    return nearestCenter;
+}
+
+// Escena vista desde la cámara reflejada en un espejo: partyroom, Slenderman y calaveras (los espejos no se ven entre sí).
+// Las luces se reparten en los clusters de la cámara reflejada; projection es la del jugador, sin la parte oblicua.
+void renderMirrorReflection(const PlanarReflections::View& reflected, const glm::mat4& projection, Shader& ourShader, Shader& levelShader,
+                            Shader& slendermanShader, Model& ourModel, Model& slendermanModel, Model& skullModel,
+                            std::vector<unsigned char>& partyroomVisible, float currentFrame) {
+    reflectionCull.frustum = reflected.frustum;
+    sceneLights.Build(reflected.view, projection, 0.1f, 200.0f);
+    setSceneUniforms(ourShader, reflected.projection, reflected.view, reflected.eye, currentFrame);
+
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -10.0f, -30.0f));
+    ourShader.setMat4("model", model);
+    if (multiDrawEnabled && levelBatch.IsSupported()) {
+        ourModel.Cull(model, reflectionCull, partyroomVisible);
+        setSceneUniforms(levelShader, reflected.projection, reflected.view, reflected.eye, currentFrame);
+        levelBatch.Draw(levelShader, model, partyroomVisible.data());
+        ourShader.use();
+    }
+    else {
+        ourModel.Draw(ourShader, model, reflectionCull);
+    }
+
+    for (int i = 0; i < static_cast<int>(skullPositions.size()); i++) {
+        if (skullCollected[i])
+            continue;
+        glm::mat4 skullModelMatrix = getSkullModelMatrix(i);
+        ourShader.setMat4("model", skullModelMatrix);
+        skullModel.Draw(ourShader, skullModelMatrix, reflectionCull);
+    }
+
+    slendermanShader.use();
+    slendermanShader.setMat4("projection", reflected.projection);
+    slendermanShader.setMat4("view", reflected.view);
+    slendermanShader.setVec3("viewPos", reflected.eye);
+    slendermanShader.setVec3("lightPos", camera.Position);
+    slendermanShader.setFloat("time", currentFrame);
+    slendermanShader.SetFeature("ILLUMINATED", slendermanIsIlluminated);
+    glm::mat4 slendermanModelMatrix = getSlendermanModelMatrix();
+    slendermanShader.setMat4("model", slendermanModelMatrix);
+    slendermanModel.Draw(slendermanShader, slendermanModelMatrix, reflectionCull);
+}
+
+// Hornea las seis caras de cada sonda con el partyroom (lo único estático) y las luces en t = 0, después las prefiltra.
+// Durante el horneado no se leen sondas, así el piso mojado no refleja sondas a medio hacer.
+void bakeReflectionProbes(Shader& ourShader, Shader& levelShader, Model& ourModel, std::vector<unsigned char>& partyroomVisible) {
+    CullContext probeCull;
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -10.0f, -30.0f));
+    for (unsigned int probe = 0; probe < reflectionProbes.ProbeCount(); probe++) {
+        for (unsigned int face = 0; face < 6; face++) {
+            ReflectionProbes::View probeView = reflectionProbes.BeginFace(probe, face);
+            probeCull.frustum = probeView.frustum;
+            sceneLights.Clear();
+            addSceneLights(0.0f, probeView.eye);
+            sceneLights.Build(probeView.view, probeView.projection, reflectionProbes.GetSettings().nearPlane, reflectionProbes.GetSettings().farPlane);
+
+            setSceneUniforms(ourShader, probeView.projection, probeView.view, probeView.eye, 0.0f);
+            reflectionProbes.Bind(ourShader, reflectionProbes.ProbeCount());
+            ourShader.setMat4("model", model);
+            if (multiDrawEnabled && levelBatch.IsSupported()) {
+                ourModel.Cull(model, probeCull, partyroomVisible);
+                setSceneUniforms(levelShader, probeView.projection, probeView.view, probeView.eye, 0.0f);
+                reflectionProbes.Bind(levelShader, reflectionProbes.ProbeCount());
+                levelBatch.Draw(levelShader, model, partyroomVisible.data());
+            }
+            else {
+                ourModel.Draw(ourShader, model, probeCull);
+            }
+            reflectionProbes.EndFace();
+        }
+        reflectionProbes.Prefilter(probe);
+    }
+}
+
+// Luces de color de la discoteca, una luz rojiza sobre cada charco de sangre y las luces de las superficies emisivas
+// más importantes vistas desde eye
+void addSceneLights(float currentFrame, const glm::vec3& eye) {
+    // Rejilla de 4 x 6 luces bajo el techo de la discoteca (zona 1), el color gira con el tiempo
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 6; j++) {
+            float hue = glm::fract(i * 0.13f + j * 0.29f + currentFrame * 0.1f);
+            glm::vec3 color = glm::clamp(glm::abs(glm::mod(hue * 6.0f + glm::vec3(0.0f, 4.0f, 2.0f), 6.0f) - 3.0f) - 1.0f, 0.0f, 1.0f);
+            ClusteredLights::Light discoLight;
+            discoLight.position = glm::vec3(-10.0f + i * 4.3f, -5.0f, -55.0f + j * 6.8f);
+            discoLight.radius = 7.0f;
+            discoLight.color = color * 0.8f;
+            discoLight.ambient = 0.05f;
+            discoLight.linear = 0.09f;
+            discoLight.quadratic = 0.032f;
+            sceneLights.Add(discoLight);
+        }
+    }
+
+    for (const auto& puddle : bloodPuddlePositions) {
+        ClusteredLights::Light bloodLight;
+        bloodLight.position = puddle + glm::vec3(0.0f, 0.6f, 0.0f);
+        bloodLight.radius = 3.0f;
+        bloodLight.color = glm::vec3(0.6f, 0.05f, 0.05f);
+        bloodLight.ambient = 0.3f;
+        bloodLight.linear = 0.09f;
+        bloodLight.quadratic = 0.032f;
+        sceneLights.Add(bloodLight);
+    }
+
+    // Las más importantes para la posición de la cámara, con el mismo pulso que aplica shader.fs a los emisivos
+    float emissivePulse = (0.5f + 0.5f * sin(currentFrame * 3.0f)) * (0.3f + 0.7f * sin(currentFrame * 1.5f + 1.57f));
+    emissiveLights.AddToFrame(sceneLights, eye, emissiveLightBudget, glm::max(0.0f, emissivePulse) * 1.2f);
+}
+
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow* window)
 {
+    CPU_ZONE("processInput");
+    // las teclas salen de inputRecorder: las reales o, en una repetición, las grabadas; ESC siempre es la real
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
     // Si estamos en game over, solo permitir reinicio
     if (showGameOverScreen) {
         static bool rKeyPressed = false;
-        if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && !rKeyPressed) {
+        if (inputRecorder.GetKey(window, GLFW_KEY_R) == GLFW_PRESS && !rKeyPressed) {
             resetGame();
             rKeyPressed = true;
         }
-        if (glfwGetKey(window, GLFW_KEY_R) == GLFW_RELEASE) {
+        if (inputRecorder.GetKey(window, GLFW_KEY_R) == GLFW_RELEASE) {
             rKeyPressed = false;
         }
         return;
@@ -1281,11 +2576,11 @@ void processInput(GLFWwindow* window)
     // Si estamos en pantalla de victoria, permitir reinicio
     if (showVictoryScreen) {
         static bool rKeyPressed = false;
-        if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && !rKeyPressed) {
+        if (inputRecorder.GetKey(window, GLFW_KEY_R) == GLFW_PRESS && !rKeyPressed) {
             resetGame();
             rKeyPressed = true;
         }
-        if (glfwGetKey(window, GLFW_KEY_R) == GLFW_RELEASE) {
+        if (inputRecorder.GetKey(window, GLFW_KEY_R) == GLFW_RELEASE) {
             rKeyPressed = false;
         }
         return;
@@ -1298,13 +2593,13 @@ void processInput(GLFWwindow* window)
 
     glm::vec3 oldCameraPos = camera.Position;
 
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    if (inputRecorder.GetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.ProcessKeyboard(FORWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+    if (inputRecorder.GetKey(window, GLFW_KEY_S) == GLFW_PRESS)
         camera.ProcessKeyboard(BACKWARD, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    if (inputRecorder.GetKey(window, GLFW_KEY_A) == GLFW_PRESS)
         camera.ProcessKeyboard(LEFT, deltaTime);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    if (inputRecorder.GetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
     if (!isPlayerInAllowedZone(camera.Position, walkableZones))
     {
@@ -1313,16 +2608,195 @@ void processInput(GLFWwindow* window)
     }
     // Alternar linterna con tecla F (solo si hay batería)
     static bool fKeyPressed = false;
-    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS && !fKeyPressed) {
+    if (inputRecorder.GetKey(window, GLFW_KEY_F) == GLFW_PRESS && !fKeyPressed) {
         if (flashlightBattery > 0.0f) {
             flashlightOn = !flashlightOn;
             flashlightBatteryEmpty = false;
         }
         fKeyPressed = true;
     }
-    if (glfwGetKey(window, GLFW_KEY_F) == GLFW_RELEASE) {
+    if (inputRecorder.GetKey(window, GLFW_KEY_F) == GLFW_RELEASE) {
         fKeyPressed = false;
     }
+
+    // Alternar occlusion culling con tecla O (para comparar draws y fragmentos con y sin Hi-Z)
+    static bool oKeyPressed = false;
+    if (inputRecorder.GetKey(window, GLFW_KEY_O) == GLFW_PRESS && !oKeyPressed) {
+        occlusionCuller.enabled = !occlusionCuller.enabled;
+        std::cout << "Occlusion culling " << (occlusionCuller.enabled ? "activado" : "desactivado") << std::endl;
+        oKeyPressed = true;
+    }
+    if (inputRecorder.GetKey(window, GLFW_KEY_O) == GLFW_RELEASE) {
+        oKeyPressed = false;
+    }
+
+    // Alternar culling por celdas y portales con tecla P
+    static bool pKeyPressed = false;
+    if (inputRecorder.GetKey(window, GLFW_KEY_P) == GLFW_PRESS && !pKeyPressed) {
+        portalCullingEnabled = !portalCullingEnabled;
+        std::cout << "Culling por portales " << (portalCullingEnabled ? "activado" : "desactivado") << std::endl;
+        pKeyPressed = true;
+    }
+    if (inputRecorder.GetKey(window, GLFW_KEY_P) == GLFW_RELEASE) {
+        pKeyPressed = false;
+    }
+
+    // Alternar multi-draw indirect del partyroom con tecla M
+    static bool mKeyPressed = false;
+    if (inputRecorder.GetKey(window, GLFW_KEY_M) == GLFW_PRESS && !mKeyPressed) {
+        multiDrawEnabled = !multiDrawEnabled;
+        std::cout << "Multi-draw indirect " << (multiDrawEnabled ? "activado" : "desactivado") << std::endl;
+        mKeyPressed = true;
+    }
+    if (inputRecorder.GetKey(window, GLFW_KEY_M) == GLFW_RELEASE) {
+        mKeyPressed = false;
+    }
+
+    // Alternar los reflejos de los espejos con tecla E
+    static bool eKeyPressed = false;
+    if (inputRecorder.GetKey(window, GLFW_KEY_E) == GLFW_PRESS && !eKeyPressed) {
+        mirrorReflectionsEnabled = !mirrorReflectionsEnabled;
+        std::cout << "Reflejos de los espejos " << (mirrorReflectionsEnabled ? "activados" : "desactivados") << std::endl;
+        eKeyPressed = true;
+    }
+    if (inputRecorder.GetKey(window, GLFW_KEY_E) == GLFW_RELEASE) {
+        eKeyPressed = false;
+    }
+
+    // Alternar las sondas de reflejo (piso mojado y espejos sin reflejo plano) con tecla G
+    static bool gKeyPressed = false;
+    if (inputRecorder.GetKey(window, GLFW_KEY_G) == GLFW_PRESS && !gKeyPressed) {
+        reflectionProbesEnabled = !reflectionProbesEnabled;
+        std::cout << "Sondas de reflejo " << (reflectionProbesEnabled ? "activadas" : "desactivadas") << std::endl;
+        gKeyPressed = true;
+    }
+    if (inputRecorder.GetKey(window, GLFW_KEY_G) == GLFW_RELEASE) {
+        gKeyPressed = false;
+    }
+
+    // Alternar el prepaso de profundidad del partyroom con tecla Z
+    static bool zKeyPressed = false;
+    if (inputRecorder.GetKey(window, GLFW_KEY_Z) == GLFW_PRESS && !zKeyPressed) {
+        depthPrepassEnabled = !depthPrepassEnabled;
+        std::cout << "Prepaso de profundidad " << (depthPrepassEnabled ? "activado" : "desactivado") << std::endl;
+        zKeyPressed = true;
+    }
+    if (inputRecorder.GetKey(window, GLFW_KEY_Z) == GLFW_RELEASE) {
+        zKeyPressed = false;
+    }
+
+    // Alternar la resolución dinámica con tecla V (desactivada vuelve al 100%)
+    static bool vKeyPressed = false;
+    if (inputRecorder.GetKey(window, GLFW_KEY_V) == GLFW_PRESS && !vKeyPressed) {
+        dynamicResolution.SetEnabled(!dynamicResolution.IsEnabled());
+        std::cout << "Resolución dinámica " << (dynamicResolution.IsEnabled() ? "activada" : "desactivada") << std::endl;
+        vKeyPressed = true;
+    }
+    if (inputRecorder.GetKey(window, GLFW_KEY_V) == GLFW_RELEASE) {
+        vKeyPressed = false;
+    }
+
+    // Cambiar el escalado de la escena a la ventana (bilineal o adaptativo a los bordes) con tecla U
+    static bool uKeyPressed = false;
+    if (inputRecorder.GetKey(window, GLFW_KEY_U) == GLFW_PRESS && !uKeyPressed) {
+        std::cout << "Escalado: " << HdrRenderer::UpscalerName(hdrRenderer.NextUpscaler()) << std::endl;
+        uKeyPressed = true;
+    }
+    if (inputRecorder.GetKey(window, GLFW_KEY_U) == GLFW_RELEASE) {
+        uKeyPressed = false;
+    }
+
+    // Cambiar el modo de vsync (vsync, adaptativo, desactivado) con tecla Y
+    static bool yKeyPressed = false;
+    if (inputRecorder.GetKey(window, GLFW_KEY_Y) == GLFW_PRESS && !yKeyPressed) {
+        std::cout << "Vsync: " << FramePacer::SwapModeName(framePacer.NextSwapMode()) << std::endl;
+        yKeyPressed = true;
+    }
+    if (inputRecorder.GetKey(window, GLFW_KEY_Y) == GLFW_RELEASE) {
+        yKeyPressed = false;
+    }
+
+    // Empezar o terminar una captura de las zonas de CPU con tecla K (al terminar se guarda el trace)
+    static bool kKeyPressed = false;
+    if (inputRecorder.GetKey(window, GLFW_KEY_K) == GLFW_PRESS && !kKeyPressed) {
+        if (CpuProfiler::Recording()) {
+            CpuProfiler::SetRecording(false);
+            CpuProfiler::WriteTrace(cpuTracePath);
+            frameAllocations.AllowThisFrame();
+        }
+        else {
+            CpuProfiler::SetRecording(true);
+            std::cout << "Capturando zonas de CPU (tecla K para guardar en " << cpuTracePath << ")" << std::endl;
+        }
+        kKeyPressed = true;
+    }
+    if (inputRecorder.GetKey(window, GLFW_KEY_K) == GLFW_RELEASE) {
+        kKeyPressed = false;
+    }
+
+    // Mostrar u ocultar el HUD del profiler de GPU con tecla H
+    static bool hKeyPressed = false;
+    if (inputRecorder.GetKey(window, GLFW_KEY_H) == GLFW_PRESS && !hKeyPressed) {
+        gpuProfilerHud = !gpuProfilerHud;
+        if (!gpuProfilerHud)
+            glfwSetWindowTitle(window, "Exercise 16 Task 3");
+        std::cout << "HUD de GPU " << (gpuProfilerHud ? "visible" : "oculto") << std::endl;
+        hKeyPressed = true;
+    }
+    if (inputRecorder.GetKey(window, GLFW_KEY_H) == GLFW_RELEASE) {
+        hKeyPressed = false;
+    }
+
+    // Cambiar el tone mapper (recorte, Reinhard, ACES) con tecla T
+    static bool tKeyPressed = false;
+    if (inputRecorder.GetKey(window, GLFW_KEY_T) == GLFW_PRESS && !tKeyPressed) {
+        std::cout << "Tone mapper: " << HdrRenderer::ToneMapperName(hdrRenderer.NextToneMapper()) << std::endl;
+        tKeyPressed = true;
+    }
+    if (inputRecorder.GetKey(window, GLFW_KEY_T) == GLFW_RELEASE) {
+        tKeyPressed = false;
+    }
+}
+
+// Cierra el frame: con ventana intercambia los buffers; sin pantalla espera a la GPU (sin swap nada la espera y el tiempo
+// del frame no la incluiría). Después cuenta las reservas del frame y vacía la arena de frame; lo que sigue (el tramo del
+// benchmark, el PNG) ya cuenta en el frame siguiente
+void presentFrame(GLFWwindow* window) {
+    if (headlessRun.enabled)
+        glFinish();
+    else
+        glfwSwapBuffers(window);
+    frameAllocations.EndFrame();
+    frameArena.Reset();
+    if (benchmarkRun.enabled)
+        recordBenchmarkFrame(window);
+    if (headlessRun.enabled)
+        recordHeadlessFrame(window);
+}
+
+// Sin pantalla: guarda el tiempo del frame, escribe el PNG si toca y cierra la ventana al llegar a los frames o a la
+// duración pedidos
+void recordHeadlessFrame(GLFWwindow* window) {
+    double now = glfwGetTime();
+    headlessRun.frameTimes.Add(static_cast<float>(now - headlessRun.lastFrameEnd));
+    headlessRun.lastFrameEnd = now;
+
+    bool last = (headlessRun.frames > 0 && headlessRun.frame + 1 >= headlessRun.frames) ||
+                (headlessRun.seconds > 0.0f && now - headlessRun.startTime >= headlessRun.seconds);
+    if (!headlessRun.dumpDirectory.empty() && (headlessRun.frame % headlessRun.dumpEvery == 0 || last)) {
+        int width = hdrRenderer.Width(), height = hdrRenderer.Height();
+        headlessRun.pixels.resize(static_cast<size_t>(width) * height * 4);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, headlessRun.framebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, headlessRun.pixels.data());
+        char name[32];
+        std::snprintf(name, sizeof(name), "/frame_%05u.png", headlessRun.frame);
+        frameAllocations.AllowThisFrame();
+        PngWriter::Write(headlessRun.dumpDirectory + name, width, height, headlessRun.pixels.data(), true);
+    }
+    headlessRun.frame++;
+    if (last)
+        glfwSetWindowShouldClose(window, true);
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -1332,12 +2806,16 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     // make sure the viewport matches the new window dimensions; note that width and 
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+    hdrRenderer.Resize(width, height);
 }
 
 // glfw: whenever the mouse moves, this callback is called
 // -------------------------------------------------------
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 {
+    // en una repetición la cámara solo la mueven los eventos grabados
+    if (inputRecorder.Replaying())
+        return;
     if (firstMouse)
     {
         lastX = xpos;
@@ -1351,6 +2829,7 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
     lastX = xpos;
     lastY = ypos;
 
+    inputRecorder.RecordCursor(xoffset, yoffset);
     camera.ProcessMouseMovement(xoffset, yoffset);
 }
 
@@ -1358,12 +2837,24 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 // ----------------------------------------------------------------------
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
+    if (inputRecorder.Replaying())
+        return;
+    inputRecorder.RecordScroll(xoffset, yoffset);
     camera.ProcessMouseScroll(yoffset);
 }
 
 // glfw: whenever a mouse button is pressed/released, this callback is called
 // --------------------------------------------------------------------------
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+    if (inputRecorder.Replaying())
+        return;
+    inputRecorder.RecordMouseButton(button, action);
+    mouseButton(button, action);
+}
+
+// El clic izquierdo alterna la linterna (solo si hay batería)
+void mouseButton(int button, int action)
 {
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
         if (flashlightBattery > 0.0f) {
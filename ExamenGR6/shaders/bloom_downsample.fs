@@ -0,0 +1,53 @@
+#version 330 core
+out vec3 FragColor;
+
+in vec2 TexCoords;
+
+// Downsample de 13 muestras (Jimenez, "Next Generation Post Processing in Call of Duty: Advanced Warfare")
+uniform sampler2D source;
+uniform vec2 texelSize;     // separación de las muestras en coordenadas de textura (un texel de source a 2:1)
+uniform bool karisAverage;  // primer nivel: cada grupo de 4 muestras se pesa por 1 / (1 + luminancia)
+uniform vec4 sourceRegion;  // xy: parte renderizada de source (escala dinámica), zw: última coordenada dentro de ella
+
+// Muestra dentro de la región renderizada, sin mezclar con lo que quedó fuera del viewport
+vec3 Tap(vec2 offset)
+{
+    return texture(source, min((TexCoords + offset) * sourceRegion.xy, sourceRegion.zw)).rgb;
+}
+
+float KarisWeight(vec3 color)
+{
+    return 1.0 / (1.0 + dot(color, vec3(0.2126, 0.7152, 0.0722)));
+}
+
+void main()
+{
+    vec2 t = texelSize;
+    vec3 a = Tap(vec2(-2.0, 2.0) * t);
+    vec3 b = Tap(vec2(0.0, 2.0) * t);
+    vec3 c = Tap(vec2(2.0, 2.0) * t);
+    vec3 d = Tap(vec2(-2.0, 0.0) * t);
+    vec3 e = Tap(vec2(0.0));
+    vec3 f = Tap(vec2(2.0, 0.0) * t);
+    vec3 g = Tap(vec2(-2.0, -2.0) * t);
+    vec3 h = Tap(vec2(0.0, -2.0) * t);
+    vec3 i = Tap(vec2(2.0, -2.0) * t);
+    vec3 j = Tap(vec2(-1.0, 1.0) * t);
+    vec3 k = Tap(vec2(1.0, 1.0) * t);
+    vec3 l = Tap(vec2(-1.0, -1.0) * t);
+    vec3 m = Tap(vec2(1.0, -1.0) * t);
+
+    // 5 cajas de 2x2: la del centro pesa 0.5 y las 4 de las esquinas 0.125 cada una
+    vec3 boxes[5] = vec3[5]((j + k + l + m) * 0.25, (a + b + d + e) * 0.25, (b + c + e + f) * 0.25,
+                            (d + e + g + h) * 0.25, (e + f + h + i) * 0.25);
+    float weights[5] = float[5](0.5, 0.125, 0.125, 0.125, 0.125);
+
+    vec3 color = vec3(0.0);
+    float total = 0.0;
+    for (int n = 0; n < 5; n++) {
+        float w = weights[n] * (karisAverage ? KarisWeight(boxes[n]) : 1.0);
+        color += boxes[n] * w;
+        total += w;
+    }
+    FragColor = max(color / total, vec3(0.0001));
+}
@@ -0,0 +1,19 @@
+#version 330 core
+out vec3 FragColor;
+
+in vec2 TexCoords;
+
+// Upsample con un filtro tienda de 3x3; el resultado se suma (blending aditivo) al nivel más grande
+uniform sampler2D source;
+uniform vec2 filterRadius;  // radio de la tienda en coordenadas de textura
+
+void main()
+{
+    vec2 r = filterRadius;
+    vec3 color = texture(source, TexCoords).rgb * 4.0;
+    color += (texture(source, TexCoords + vec2(-r.x, 0.0)).rgb + texture(source, TexCoords + vec2(r.x, 0.0)).rgb +
+              texture(source, TexCoords + vec2(0.0, -r.y)).rgb + texture(source, TexCoords + vec2(0.0, r.y)).rgb) * 2.0;
+    color += texture(source, TexCoords + vec2(-r.x, -r.y)).rgb + texture(source, TexCoords + vec2(r.x, -r.y)).rgb +
+             texture(source, TexCoords + vec2(-r.x, r.y)).rgb + texture(source, TexCoords + vec2(r.x, r.y)).rgb;
+    FragColor = color / 16.0;
+}
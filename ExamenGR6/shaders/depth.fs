@@ -0,0 +1,6 @@
+#version 330 core
+
+// Solo se escribe profundidad
+void main()
+{
+}
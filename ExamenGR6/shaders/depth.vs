@@ -0,0 +1,10 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 viewProjection;
+
+void main()
+{
+    gl_Position = viewProjection * model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,35 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in uint aDrawIndex; // baseInstance del comando indirecto (divisor 1)
+
+// Prepaso de profundidad del lote multi-draw: misma expresión de gl_Position que shader_mdi.vs
+invariant gl_Position;
+
+struct DrawData {
+    uint transform;
+    int diffuseLayer;
+    int emissiveLayer;
+    float reflectivity;
+    float roughness;
+    uint padding0;
+    uint padding1;
+    uint padding2;
+};
+
+layout (std430, binding = 0) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
+
+layout (std430, binding = 1) readonly buffer TransformBuffer {
+    mat4 transforms[];
+};
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    mat4 model = transforms[draws[aDrawIndex].transform];
+    vec3 FragPos = vec3(model * vec4(aPos, 1.0));
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
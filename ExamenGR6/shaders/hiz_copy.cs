@@ -0,0 +1,15 @@
+#version 430 core
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// Copia el depth buffer de los oclusores al nivel 0 de la cadena Hi-Z
+layout (r32f, binding = 0) writeonly uniform image2D dstLevel;
+uniform sampler2D depthMap;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(dstLevel);
+    if (texel.x >= size.x || texel.y >= size.y)
+        return;
+    imageStore(dstLevel, texel, vec4(texelFetch(depthMap, texel, 0).r));
+}
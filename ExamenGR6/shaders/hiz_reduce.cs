@@ -0,0 +1,23 @@
+#version 430 core
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// Reducción por máximo: cada texel destino toma la profundidad más lejana de todos los texels origen que cubre
+// (con tamaños impares se incluye la fila/columna extra)
+layout (r32f, binding = 0) readonly uniform image2D srcLevel;
+layout (r32f, binding = 1) writeonly uniform image2D dstLevel;
+uniform ivec2 srcSize;
+uniform ivec2 dstSize;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (texel.x >= dstSize.x || texel.y >= dstSize.y)
+        return;
+    ivec2 srcMin = texel * srcSize / dstSize;
+    ivec2 srcMax = ((texel + 1) * srcSize + dstSize - 1) / dstSize;
+    float maxDepth = 0.0;
+    for (int y = srcMin.y; y < srcMax.y; y++)
+        for (int x = srcMin.x; x < srcMax.x; x++)
+            maxDepth = max(maxDepth, imageLoad(srcLevel, ivec2(x, y)).r);
+    imageStore(dstLevel, texel, vec4(maxDepth));
+}
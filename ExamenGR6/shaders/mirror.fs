@@ -1,4 +1,5 @@
 #version 330 core
+// Variantes compiladas por Shader según las defines: FLASHLIGHT_ON (linterna encendida)
 out vec4 FragColor;
 
 in vec3 FragPos;
@@ -6,7 +7,7 @@ in vec3 Normal;
 in vec2 TexCoords;
 
 uniform vec3 viewPos;
-uniform bool flashlightOn;
+#ifdef FLASHLIGHT_ON
 uniform struct Flashlight {
     vec3 position;
     vec3 direction;
@@ -19,10 +20,24 @@ uniform struct Flashlight {
     float linear;
     float quadratic;
 } flashlight;
+#endif
 
 // Texturas del modelo
 uniform sampler2D texture_diffuse1;
 
+// Reflejo plano (PlanarReflections): imagen de la escena vista desde la cámara reflejada en el plano del espejo
+uniform sampler2D reflectionMap;
+uniform bool hasReflection;
+uniform mat4 reflectionMatrix;  // vista-proyección con la que se renderizó la imagen (puede ser de un frame anterior)
+uniform vec3 mirrorNormal;
+
+// Sonda de reflejo (ReflectionProbes) de la zona del espejo, para cuando todavía no hay reflejo plano o está desactivado
+uniform samplerCube probeMap;
+uniform bool hasProbe;
+uniform vec3 probePosition;
+uniform vec3 probeBoxMin;
+uniform vec3 probeBoxMax;
+
 void main()
 {
     vec3 norm = normalize(Normal);
@@ -32,7 +47,8 @@ void main()
     // Color base del espejo (textura)
     vec3 baseColor = texture(texture_diffuse1, TexCoords).rgb;
 
-    if (flashlightOn) {
+#ifdef FLASHLIGHT_ON
+    {
         // Calcular dirección de la luz de la linterna
         vec3 lightDir = normalize(flashlight.position - FragPos);
         float theta = dot(lightDir, normalize(-flashlight.direction));
@@ -46,9 +62,29 @@ void main()
 
         // Combinar color base con reflexión especular
         color = baseColor + specular;
-    } else {
-        // Sin linterna, mostrar solo el color base
-        color = baseColor * 0.1;
+    }
+#else
+    // Sin linterna, mostrar solo el color base
+    color = baseColor * 0.1;
+#endif
+
+    // El vidrio es la cara delantera del espejo y su textura es gris; el marco de madera no refleja
+    float front = smoothstep(0.9, 0.98, dot(norm, mirrorNormal));
+    float saturation = max(baseColor.r, max(baseColor.g, baseColor.b)) - min(baseColor.r, min(baseColor.g, baseColor.b));
+    float glass = front * (1.0 - smoothstep(0.1, 0.25, saturation));
+    if (hasReflection) {
+        vec4 reflectionClip = reflectionMatrix * vec4(FragPos, 1.0);
+        vec2 reflectionCoords = reflectionClip.xy / reflectionClip.w * 0.5 + 0.5;
+        vec3 reflection = texture(reflectionMap, reflectionCoords).rgb;
+        color = mix(color, reflection * 0.9 + color * 0.1, glass);
+    } else if (hasProbe) {
+        // mip 0 de la sonda (rugosidad 0) con la dirección corregida por la caja de la zona
+        vec3 direction = reflect(-viewDir, norm);
+        vec3 start = clamp(FragPos, probeBoxMin, probeBoxMax);
+        vec3 exits = max((probeBoxMax - start) / direction, (probeBoxMin - start) / direction);
+        float hit = min(min(exits.x, exits.y), exits.z);
+        vec3 reflection = textureLod(probeMap, start + direction * hit - probePosition, 0.0).rgb;
+        color = mix(color, reflection * 0.9 + color * 0.1, glass);
     }
 
     FragColor = vec4(color, 1.0);
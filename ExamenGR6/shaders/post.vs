@@ -0,0 +1,10 @@
+#version 330 core
+// Triángulo que cubre toda la pantalla, sin vértices (se arma con gl_VertexID)
+out vec2 TexCoords;
+
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+    TexCoords = position * 0.5 + 0.5;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
@@ -0,0 +1,70 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 Direction;
+
+// Captura de la sonda (con sus mipmaps) y rugosidad del mip que se está escribiendo
+uniform samplerCube environmentMap;
+uniform float roughness;
+uniform float resolution;   // tamaño de una cara del nivel 0 de environmentMap
+uniform int sampleCount;
+
+const float PI = 3.14159265359;
+
+// Secuencia de Hammersley: puntos bien repartidos en el cuadrado unitario
+vec2 Hammersley(uint i, uint count)
+{
+    uint bits = i;
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return vec2(float(i) / float(count), float(bits) * 2.3283064365386963e-10);
+}
+
+// Half vector con distribución GGX alrededor de la normal n
+vec3 ImportanceSampleGGX(vec2 xi, vec3 n, float alpha)
+{
+    float phi = 2.0 * PI * xi.x;
+    float cosTheta = sqrt((1.0 - xi.y) / (1.0 + (alpha * alpha - 1.0) * xi.y));
+    float sinTheta = sqrt(1.0 - cosTheta * cosTheta);
+    vec3 h = vec3(cos(phi) * sinTheta, sin(phi) * sinTheta, cosTheta);
+
+    vec3 up = abs(n.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+    vec3 tangent = normalize(cross(up, n));
+    vec3 bitangent = cross(n, tangent);
+    return normalize(tangent * h.x + bitangent * h.y + n * h.z);
+}
+
+void main()
+{
+    vec3 n = normalize(Direction);
+    if (roughness <= 0.0) {
+        FragColor = vec4(textureLod(environmentMap, n, 0.0).rgb, 1.0);
+        return;
+    }
+
+    // se asume vista = normal (como en la aproximación de Karis); cada muestra lee el mip que cubre su ángulo sólido
+    float alpha = roughness * roughness;
+    float texelSolidAngle = 4.0 * PI / (6.0 * resolution * resolution);
+    vec3 color = vec3(0.0);
+    float weight = 0.0;
+    for (int i = 0; i < sampleCount; i++) {
+        vec3 h = ImportanceSampleGGX(Hammersley(uint(i), uint(sampleCount)), n, alpha);
+        vec3 l = normalize(2.0 * dot(n, h) * h - n);
+        float nDotL = dot(n, l);
+        if (nDotL <= 0.0)
+            continue;
+
+        float nDotH = max(dot(n, h), 0.0);
+        float d = alpha * alpha / (PI * pow(nDotH * nDotH * (alpha * alpha - 1.0) + 1.0, 2.0));
+        float pdf = d / 4.0 + 0.0001;
+        float sampleSolidAngle = 1.0 / (float(sampleCount) * pdf + 0.0001);
+        float lod = 0.5 * log2(sampleSolidAngle / texelSolidAngle) + 1.0;
+
+        color += textureLod(environmentMap, l, max(lod, 0.0)).rgb * nDotL;
+        weight += nDotL;
+    }
+    FragColor = vec4(color / max(weight, 0.0001), 1.0);
+}
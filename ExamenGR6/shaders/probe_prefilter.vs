@@ -0,0 +1,13 @@
+#version 330 core
+// Triángulo que cubre toda la cara del cubemap, sin vértices (se arma con gl_VertexID)
+out vec3 Direction;
+
+uniform mat4 inverseViewProjection; // de la cámara de la cara, en el origen
+
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+    vec4 far = inverseViewProjection * vec4(position, 1.0, 1.0);
+    Direction = far.xyz / far.w;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
@@ -0,0 +1,11 @@
+#version 330 core
+// Rectángulo del HUD del profiler en píxeles (origen arriba a la izquierda), sin vértices (se arma con gl_VertexID)
+uniform vec4 rect;       // x, y, ancho, alto
+uniform vec2 screenSize;
+
+void main()
+{
+    vec2 corner = vec2(gl_VertexID & 1, (gl_VertexID >> 1) & 1);
+    vec2 pixel = rect.xy + corner * rect.zw;
+    gl_Position = vec4(pixel.x / screenSize.x * 2.0 - 1.0, 1.0 - pixel.y / screenSize.y * 2.0, 0.0, 1.0);
+}
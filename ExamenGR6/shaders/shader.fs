@@ -1,4 +1,5 @@
 #version 330 core
+// Variantes compiladas por Shader según las defines: FLASHLIGHT_ON (linterna encendida) y HAS_EMISSIVE_MAP (material con mapa emisivo)
 out vec4 FragColor;
 
 in vec2 TexCoords;
@@ -35,16 +36,46 @@ struct SpotLight {
 };
 
 uniform sampler2D texture_diffuse1;
+#ifdef HAS_EMISSIVE_MAP
 uniform sampler2D texture_emissive1;
+#endif
 uniform vec3 viewPos;               // Posición de la cámara
 
 uniform Material material;
 uniform PointLight light;
+#ifdef FLASHLIGHT_ON
 uniform SpotLight flashlight;
-uniform bool flashlightOn;
-uniform bool hasEmissiveMap;
+#endif
 uniform float time;
 
+// Luces dinámicas del clustered forward shading (ClusteredLights): solo se recorren las del cluster del fragmento
+uniform samplerBuffer clusterLights;   // 3 texels por luz: (posición, radio), (color, ambiente), (lineal, cuadrática)
+uniform usamplerBuffer clusterRanges;  // (inicio, cantidad) de cada cluster en clusterIndices
+uniform usamplerBuffer clusterIndices;
+uniform int clusterLightCount;
+uniform vec3 clusterGrid;              // tiles en x, tiles en y, cortes en profundidad
+uniform vec2 clusterTileSize;          // tamaño de un tile en pixeles
+uniform vec4 clusterViewDepth;         // fila de la matriz de vista: profundidad = dot(clusterViewDepth, (posición, 1))
+uniform vec2 clusterSlice;             // corte = log(profundidad) * x + y
+
+#ifdef FLASHLIGHT_ON
+// Sombra de la linterna (SpotShadowMap): profundidad de las paredes cacheada más Slenderman y calaveras encima
+uniform sampler2DShadow flashlightShadowMap;
+uniform mat4 flashlightSpaceMatrix;
+uniform bool flashlightShadows;
+uniform int flashlightShadowPcf;       // radio del kernel PCF, (2r + 1)^2 muestras
+uniform float flashlightShadowOffset;  // desplazamiento sobre la normal por unidad de distancia a la linterna
+#endif
+
+// Sonda de reflejo horneada (ReflectionProbes) de la zona de la cámara: cubemap prefiltrado, un mip por rugosidad
+uniform samplerCube probeMap;
+uniform bool hasProbe;
+uniform vec3 probePosition;
+uniform vec3 probeBoxMin;              // caja de la zona, para corregir la paralaje del reflejo
+uniform vec3 probeBoxMax;
+uniform float probeMaxLod;             // mip de rugosidad 1
+uniform vec2 materialReflection;       // (reflectividad, rugosidad) del material, reflectividad 0 sin reflejo
+
 // Función para calcular iluminación de punto con efecto disco
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor)
 {
@@ -76,6 +107,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, v
     return (ambient + diffuse + specular);
 }
 
+#ifdef FLASHLIGHT_ON
 // Función para calcular iluminación de linterna (spotlight)
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor)
 {
@@ -109,6 +141,79 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec
     return (ambient + diffuse + specular);
 }
 
+// Fracción iluminada por la linterna: 1 fuera de su mapa de sombras, 0 detrás de una pared o de Slenderman
+float CalcFlashlightShadow(vec3 normal, vec3 fragPos)
+{
+    if (!flashlightShadows)
+        return 1.0;
+
+    // se empuja el punto sobre la normal según el tamaño del texel a esa distancia para evitar el acné
+    float distance = length(flashlight.position - fragPos);
+    vec4 lightSpace = flashlightSpaceMatrix * vec4(fragPos + normal * flashlightShadowOffset * distance, 1.0);
+    if (lightSpace.w <= 0.0)
+        return 1.0;
+    vec3 coords = lightSpace.xyz / lightSpace.w * 0.5 + 0.5;
+    if (coords.z > 1.0 || any(lessThan(coords.xy, vec2(0.0))) || any(greaterThan(coords.xy, vec2(1.0))))
+        return 1.0;
+
+    vec2 texel = 1.0 / vec2(textureSize(flashlightShadowMap, 0));
+    float lit = 0.0;
+    for (int x = -flashlightShadowPcf; x <= flashlightShadowPcf; x++)
+        for (int y = -flashlightShadowPcf; y <= flashlightShadowPcf; y++)
+            lit += texture(flashlightShadowMap, vec3(coords.xy + vec2(x, y) * texel, coords.z));
+    float taps = float(2 * flashlightShadowPcf + 1);
+    return lit / (taps * taps);
+}
+#endif
+
+// Reflejo de la sonda: el rayo reflejado se corta con la caja de la zona y se busca el punto de impacto visto desde la sonda
+vec3 CalcProbeReflection(vec3 normal, vec3 fragPos, vec3 viewDir, float roughness)
+{
+    vec3 direction = reflect(-viewDir, normal);
+    vec3 start = clamp(fragPos, probeBoxMin, probeBoxMax);
+    vec3 toMax = (probeBoxMax - start) / direction;
+    vec3 toMin = (probeBoxMin - start) / direction;
+    vec3 exits = max(toMax, toMin);
+    float hit = min(min(exits.x, exits.y), exits.z);
+    return textureLod(probeMap, start + direction * hit - probePosition, roughness * probeMaxLod).rgb;
+}
+
+// Suma las luces del cluster del fragmento (misma atenuación que CalcPointLight, recortada al radio de la luz)
+vec3 CalcClusterLights(vec3 normal, vec3 fragPos, vec3 viewDir, vec3 diffuseColor)
+{
+    if (clusterLightCount == 0)
+        return vec3(0.0);
+
+    // desde la posición y no desde gl_FragCoord.z, que no es lineal con la proyección oblicua de los reflejos
+    float depth = dot(clusterViewDepth, vec4(fragPos, 1.0));
+    int slice = clamp(int(log(depth) * clusterSlice.x + clusterSlice.y), 0, int(clusterGrid.z) - 1);
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterTileSize), ivec2(0), ivec2(clusterGrid.xy) - 1);
+    int cluster = (slice * int(clusterGrid.y) + tile.y) * int(clusterGrid.x) + tile.x;
+    uvec2 range = texelFetch(clusterRanges, cluster).xy;
+
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++) {
+        int index = int(texelFetch(clusterIndices, int(range.x + i)).r);
+        vec4 positionRadius = texelFetch(clusterLights, index * 3);
+        vec4 colorAmbient = texelFetch(clusterLights, index * 3 + 1);
+        vec2 falloff = texelFetch(clusterLights, index * 3 + 2).xy;
+
+        vec3 toLight = positionRadius.xyz - fragPos;
+        float distance = length(toLight);
+        if (distance >= positionRadius.w)
+            continue;
+        vec3 lightDir = toLight / distance;
+        float diff = max(dot(normal, lightDir), 0.0);
+        vec3 reflectDir = reflect(-lightDir, normal);
+        float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+
+        float attenuation = 1.0 / (1.0 + falloff.x * distance + falloff.y * (distance * distance));
+        float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+        result += colorAmbient.rgb * (colorAmbient.a + diff + spec * 0.5) * diffuseColor * attenuation * window * window;
+    }
+    return result;
+}
+
 void main()
 {
     vec3 diffuseColor = texture(texture_diffuse1, TexCoords).rgb;
@@ -120,14 +225,24 @@ void main()
     
     // Iluminación principal más tenue
     result += CalcPointLight(light, norm, FragPos, viewDir, diffuseColor) * 0.6;
+
+    // Luces de color de la discoteca, charcos de sangre, etc.
+    result += CalcClusterLights(norm, FragPos, viewDir, diffuseColor);
     
     // Agregar linterna si está activada (más brillante para contraste)
-    if (flashlightOn) {
-        result += CalcSpotLight(flashlight, norm, FragPos, viewDir, diffuseColor);
+#ifdef FLASHLIGHT_ON
+    result += CalcSpotLight(flashlight, norm, FragPos, viewDir, diffuseColor) * CalcFlashlightShadow(norm, FragPos);
+#endif
+
+    // Piso mojado: reflejo de la sonda con Fresnel de Schlick (F0 = 0.04), más fuerte en ángulos rasantes
+    if (hasProbe && materialReflection.x > 0.0) {
+        float fresnel = 0.04 + 0.96 * pow(1.0 - max(dot(norm, viewDir), 0.0), 5.0);
+        result += CalcProbeReflection(norm, FragPos, viewDir, materialReflection.y) * fresnel * materialReflection.x;
     }
     
     // Efecto emissive más dramático para luces de disco
-    if (hasEmissiveMap) {
+#ifdef HAS_EMISSIVE_MAP
+    {
         vec3 emissiveColor = texture(texture_emissive1, TexCoords).rgb;
         // Múltiples pulsos con diferentes frecuencias para efecto disco
         float pulse1 = 0.5 + 0.5 * sin(time * 3.0);
@@ -142,6 +257,7 @@ void main()
         
         result += discoColors * finalPulse * 1.2;
     }
+#endif
     
     FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
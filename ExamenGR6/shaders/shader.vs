@@ -3,6 +3,9 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
+// Misma expresión que depth_prepass para que la profundidad coincida exactamente con GL_EQUAL
+invariant gl_Position;
+
 out vec2 TexCoords;
 out vec3 FragPos;
 out vec3 Normal;
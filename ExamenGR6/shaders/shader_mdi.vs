@@ -0,0 +1,53 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in uint aDrawIndex; // baseInstance del comando indirecto (divisor 1)
+
+// Datos de cada malla del lote: matriz de modelo, capas en los arreglos de texturas (-1 si no tiene) y reflejo del material
+struct DrawData {
+    uint transform;
+    int diffuseLayer;
+    int emissiveLayer;
+    float reflectivity;
+    float roughness;
+    uint padding0;
+    uint padding1;
+    uint padding2;
+};
+
+layout (std430, binding = 0) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
+
+layout (std430, binding = 1) readonly buffer TransformBuffer {
+    mat4 transforms[];
+};
+
+// Misma expresión que depth_prepass para que la profundidad coincida exactamente con GL_EQUAL
+invariant gl_Position;
+
+out vec2 TexCoords;
+out vec3 FragPos;
+out vec3 Normal;
+flat out int DiffuseLayer;
+flat out int EmissiveLayer;
+flat out vec2 MaterialReflection; // (reflectividad, rugosidad)
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    DrawData draw = draws[aDrawIndex];
+    mat4 model = transforms[draw.transform];
+    DiffuseLayer = draw.diffuseLayer;
+    EmissiveLayer = draw.emissiveLayer;
+    MaterialReflection = vec2(draw.reflectivity, draw.roughness);
+
+    TexCoords = aTexCoords;
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    Normal = mat3(transpose(inverse(model))) * aNormal;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -1,4 +1,5 @@
 #version 330 core
+// Variantes compiladas por Shader según las defines: ILLUMINATED (iluminado por la linterna)
 out vec4 FragColor;  // El color final que se mostrará en pantalla
 
 in vec2 TexCoords;   // Coordenadas de textura recibidas del vertex shader
@@ -9,7 +10,6 @@ uniform sampler2D texture_diffuse1; // Mapa difuso (diffuse texture)
 uniform vec3 lightPos;              // Posición de la luz
 uniform vec3 viewPos;               // Posición de la cámara
 uniform float time;                 // Tiempo para efectos dinámicos
-uniform bool isIlluminated;         // Si está siendo iluminado por la linterna
 
 void main()
 {
@@ -21,7 +21,8 @@ void main()
     vec3 lightDir = normalize(lightPos - FragPos);
     vec3 viewDir = normalize(viewPos - FragPos);
     
-    if (isIlluminated) {
+#ifdef ILLUMINATED
+    {
         // Cuando está iluminado: Más visible, colores normales, menos siniestro
         vec3 ambient = vec3(0.2, 0.2, 0.2) * diffuseColor;
         float diff = max(dot(norm, lightDir), 0.0);
@@ -32,7 +33,9 @@ void main()
         vec3 result = (ambient + diffuse) * surprised;
         
         FragColor = vec4(result, 1.0);
-    } else {
+    }
+#else
+    {
         // Cuando NO está iluminado: Efectos de horror completos
         // Componente ambiental muy oscura y rojiza
         vec3 ambient = vec3(0.05, 0.02, 0.02) * diffuseColor;
@@ -52,4 +55,5 @@ void main()
         
         FragColor = vec4(result, 1.0);
     }
+#endif
 }
\ No newline at end of file
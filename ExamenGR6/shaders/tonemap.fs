@@ -0,0 +1,33 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// Escena HDR (RGBA16F) y bloom (nivel más grande de la cadena, a media resolución)
+uniform sampler2D scene;
+uniform sampler2D bloom;
+uniform float exposure;
+uniform float bloomStrength;
+uniform float bloomNormalization; // 1 / niveles sumados en el bloom
+uniform int toneMapper;     // 0 = recorte (sin tone mapping), 1 = Reinhard, 2 = ACES
+uniform vec4 sceneRegion;   // xy: parte renderizada de la escena (escala dinámica), zw: última coordenada dentro de ella
+
+// Aproximación de Narkowicz a la curva filmica ACES
+vec3 Aces(vec3 x)
+{
+    return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+void main()
+{
+    // escalado bilineal de la parte renderizada al tamaño de la ventana
+    vec3 hdr = texture(scene, min(TexCoords * sceneRegion.xy, sceneRegion.zw)).rgb;
+    vec3 glow = texture(bloom, TexCoords).rgb * bloomNormalization;
+    vec3 color = mix(hdr, glow, bloomStrength) * exposure;
+
+    if (toneMapper == 1)
+        color = color / (1.0 + color);
+    else if (toneMapper == 2)
+        color = Aces(color);
+    FragColor = vec4(clamp(color, 0.0, 1.0), 1.0);
+}
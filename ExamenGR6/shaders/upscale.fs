@@ -0,0 +1,114 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// Escalado espacial adaptativo a los bordes y enfoque adaptativo al contraste en una sola pasada (la idea de EASU y CAS
+// de AMD FidelityFX, simplificada): un filtro de Lanczos-2 de 12 muestras que se alarga a lo largo de los bordes y se
+// estrecha a través de ellos, y después un enfoque que se limita solo donde ya hay mucho contraste
+uniform sampler2D source;  // imagen con tone mapping (LDR), renderizada en la esquina inferior izquierda
+uniform vec4 sourceRegion; // xy: parte renderizada de source (escala dinámica), zw: última coordenada dentro de ella
+uniform float sharpness;   // 0 = sin enfoque, 1 = máximo
+
+ivec2 lastTexel;
+
+// texel de la región renderizada, los de fuera se repiten desde el borde
+vec3 Texel(ivec2 base, int x, int y)
+{
+    return texelFetch(source, clamp(base + ivec2(x, y), ivec2(0), lastTexel), 0).rgb;
+}
+
+float Luma(vec3 color)
+{
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// 1 en una rampa o un escalón limpio (hay borde), 0 en un detalle de un texel (ruido, no se estira)
+float EdgeLength(float left, float center, float right)
+{
+    float steepest = max(abs(right - center), abs(center - left));
+    float ratio = steepest > 0.0 ? clamp(abs(right - left) / steepest, 0.0, 1.0) : 0.0;
+    return ratio * ratio;
+}
+
+// Lanczos-2 aproximado con polinomios; d2 es la distancia al cuadrado y window acota el lóbulo negativo (1/4 a 1/2)
+float Lobe(float d2, float window)
+{
+    float base = 25.0 / 16.0 * (0.4 * d2 - 1.0) * (0.4 * d2 - 1.0) - 9.0 / 16.0;
+    float w = window * d2 - 1.0;
+    return base * w * w;
+}
+
+void main()
+{
+    vec2 size = vec2(textureSize(source, 0));
+    lastTexel = ivec2(sourceRegion.xy * size + 0.5) - 1;
+    vec2 position = TexCoords * sourceRegion.xy * size - 0.5;
+    ivec2 base = ivec2(floor(position));
+    vec2 f = position - vec2(base);
+
+    // 12 texels alrededor de la posición (4x4 sin las esquinas), la fila de b y c es la de abajo (y - 1);
+    // p, q, s y t son los 4 más cercanos
+    //      b c
+    //    o p q r
+    //    e s t h
+    //      u v
+    vec3 b = Texel(base, 0, -1), c = Texel(base, 1, -1);
+    vec3 o = Texel(base, -1, 0), p = Texel(base, 0, 0), q = Texel(base, 1, 0), r = Texel(base, 2, 0);
+    vec3 e = Texel(base, -1, 1), s = Texel(base, 0, 1), t = Texel(base, 1, 1), h = Texel(base, 2, 1);
+    vec3 u = Texel(base, 0, 2), v = Texel(base, 1, 2);
+
+    float lb = Luma(b), lc = Luma(c), lo = Luma(o), lp = Luma(p), lq = Luma(q), lr = Luma(r);
+    float le = Luma(e), ls = Luma(s), lt = Luma(t), lh = Luma(h), lu = Luma(u), lv = Luma(v);
+
+    // dirección del gradiente y fuerza del borde en los 4 texels cercanos, con pesos bilineales
+    vec4 weights = vec4((1.0 - f.x) * (1.0 - f.y), f.x * (1.0 - f.y), (1.0 - f.x) * f.y, f.x * f.y);
+    vec2 direction = vec2(lq - lo, ls - lb) * weights.x + vec2(lr - lp, lt - lc) * weights.y +
+                     vec2(lt - le, lu - lp) * weights.z + vec2(lh - ls, lv - lq) * weights.w;
+    float edge = (EdgeLength(lo, lp, lq) + EdgeLength(lb, lp, ls)) * weights.x +
+                 (EdgeLength(lp, lq, lr) + EdgeLength(lc, lq, lt)) * weights.y +
+                 (EdgeLength(le, ls, lt) + EdgeLength(lp, ls, lu)) * weights.z +
+                 (EdgeLength(ls, lt, lh) + EdgeLength(lq, lt, lv)) * weights.w;
+    edge = clamp(edge * 0.5, 0.0, 1.0);
+
+    float directionLength2 = dot(direction, direction);
+    direction = directionLength2 < 1.0 / 32768.0 ? vec2(1.0, 0.0) : direction * inversesqrt(directionLength2);
+    // en diagonal los texels quedan más lejos a lo largo del borde, el núcleo se estira más
+    float stretch = 1.0 / max(abs(direction.x), abs(direction.y));
+    // eje x: a través del borde (más estrecho), eje y: a lo largo (más ancho)
+    vec2 axes = vec2(1.0 + (stretch - 1.0) * edge, 1.0 - 0.5 * edge);
+    float window = 0.5 - 0.29 * edge;
+    float clipDistance = 1.0 / window;
+
+    vec3 taps[12] = vec3[12](b, c, o, p, q, r, e, s, t, h, u, v);
+    vec2 offsets[12] = vec2[12](vec2(0.0, -1.0), vec2(1.0, -1.0), vec2(-1.0, 0.0), vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(2.0, 0.0),
+                                vec2(-1.0, 1.0), vec2(0.0, 1.0), vec2(1.0, 1.0), vec2(2.0, 1.0), vec2(0.0, 2.0), vec2(1.0, 2.0));
+    vec3 color = vec3(0.0);
+    float total = 0.0;
+    for (int i = 0; i < 12; i++) {
+        vec2 d = offsets[i] - f;
+        vec2 rotated = vec2(dot(d, direction), dot(d, vec2(-direction.y, direction.x))) * axes;
+        float w = Lobe(min(dot(rotated, rotated), clipDistance), window);
+        color += taps[i] * w;
+        total += w;
+    }
+    // los lóbulos negativos pueden pasarse del rango de los 4 texels cercanos (halos)
+    vec3 nearMin = min(min(p, q), min(s, t));
+    vec3 nearMax = max(max(p, q), max(s, t));
+    color = clamp(color / total, nearMin, nearMax);
+
+    // enfoque: filtro en cruz con las muestras a un píxel de salida, con un peso negativo que se reduce donde el
+    // contraste local ya es alto o el color está cerca de 0 o 1
+    vec2 pixel = dFdx(TexCoords).x * vec2(1.0, 0.0) + dFdy(TexCoords).y * vec2(0.0, 1.0);
+    vec3 left = texture(source, min((TexCoords - vec2(pixel.x, 0.0)) * sourceRegion.xy, sourceRegion.zw)).rgb;
+    vec3 right = texture(source, min((TexCoords + vec2(pixel.x, 0.0)) * sourceRegion.xy, sourceRegion.zw)).rgb;
+    vec3 down = texture(source, min((TexCoords - vec2(0.0, pixel.y)) * sourceRegion.xy, sourceRegion.zw)).rgb;
+    vec3 up = texture(source, min((TexCoords + vec2(0.0, pixel.y)) * sourceRegion.xy, sourceRegion.zw)).rgb;
+    vec3 crossMin = min(min(min(left, right), min(down, up)), color);
+    vec3 crossMax = max(max(max(left, right), max(down, up)), color);
+    vec3 amount = sqrt(clamp(min(crossMin, 1.0 - crossMax) / max(crossMax, vec3(1.0 / 1024.0)), 0.0, 1.0));
+    vec3 w = -amount * (0.2 * sharpness);
+    color = (color + (left + right + down + up) * w) / (1.0 + 4.0 * w);
+
+    FragColor = vec4(clamp(color, 0.0, 1.0), 1.0);
+}
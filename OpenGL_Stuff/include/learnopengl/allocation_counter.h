@@ -0,0 +1,205 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+// Heap allocations of the whole program (every thread) and of the calling thread, counted by replacing the global
+// operator new and delete.
+// The replacement must be compiled into exactly one translation unit: define ALLOCATION_COUNTER_IMPLEMENTATION before
+// including this header there (like STB_IMAGE_IMPLEMENTATION). Without it the counts stay at zero and Installed()
+// is false. Memory that libraries get with malloc directly (the C parts of assimp, the driver) is not counted.
+class AllocationCounter
+{
+public:
+    struct Snapshot {
+        uint64_t allocations = 0;
+        uint64_t frees = 0;
+        uint64_t bytes = 0; // requested by the allocations
+    };
+
+    static Snapshot Now()
+    {
+        Snapshot snapshot;
+        snapshot.allocations = allocations().load(std::memory_order_relaxed);
+        snapshot.frees = frees().load(std::memory_order_relaxed);
+        snapshot.bytes = bytes().load(std::memory_order_relaxed);
+        return snapshot;
+    }
+
+    // only the allocations of the calling thread (the main loop, without the worker threads)
+    static Snapshot ThreadNow() { return thread(); }
+
+    static bool Installed() { return installed().load(std::memory_order_relaxed); }
+
+    // called by the replaced operators
+    static void CountAllocation(std::size_t size)
+    {
+        allocations().fetch_add(1, std::memory_order_relaxed);
+        bytes().fetch_add(size, std::memory_order_relaxed);
+        Snapshot &counts = thread();
+        counts.allocations++;
+        counts.bytes += size;
+    }
+    static void CountFree()
+    {
+        frees().fetch_add(1, std::memory_order_relaxed);
+        thread().frees++;
+    }
+    static void MarkInstalled() { installed().store(true, std::memory_order_relaxed); }
+
+private:
+    // function statics with constant initialization, usable by allocations made before main
+    static std::atomic<uint64_t> &allocations()
+    {
+        static std::atomic<uint64_t> count(0);
+        return count;
+    }
+    static std::atomic<uint64_t> &frees()
+    {
+        static std::atomic<uint64_t> count(0);
+        return count;
+    }
+    static std::atomic<uint64_t> &bytes()
+    {
+        static std::atomic<uint64_t> count(0);
+        return count;
+    }
+    static std::atomic<bool> &installed()
+    {
+        static std::atomic<bool> value(false);
+        return value;
+    }
+    // constant initialized, so the first use on a thread does not allocate
+    static Snapshot &thread()
+    {
+        thread_local Snapshot counts;
+        return counts;
+    }
+};
+
+// Heap allocations of the thread that runs the frames (the main loop), per frame: a frame goes from one EndFrame to the
+// next (from Init for the first one), so nothing between frames is missed. In assert mode a frame after the warm-up
+// that allocates is reported and stops the program, so the steady state is kept at zero allocations; frames that
+// allocate on purpose (a periodic log, a screenshot) call AllowThisFrame.
+class FrameAllocationTracker
+{
+public:
+    struct Settings {
+        bool assertZero = false;
+        unsigned int warmupFrames = 120; // frames not checked at the start (first use of buffers, lazy caches)
+    };
+
+    struct Stats {
+        uint64_t allocations = 0;          // last frame
+        uint64_t bytes = 0;
+        uint64_t peakAllocations = 0;      // worst frame after the warm-up
+        uint64_t totalAllocations = 0;     // over the frames after the warm-up
+        unsigned int frames = 0;           // frames after the warm-up
+        unsigned int framesWithAllocations = 0;
+    };
+
+    Stats stats;
+
+    void Init(const Settings &newSettings)
+    {
+        settings = newSettings;
+        stats = Stats();
+        frame = 0;
+        allowed = false;
+        start = AllocationCounter::ThreadNow();
+        if (settings.assertZero && !AllocationCounter::Installed())
+            std::cout << "ERROR::ALLOCATION_COUNTER:: the counter is not compiled in, the assert mode checks nothing" << std::endl;
+    }
+
+    void AllowThisFrame() { allowed = true; }
+
+    void EndFrame()
+    {
+        AllocationCounter::Snapshot end = AllocationCounter::ThreadNow();
+        stats.allocations = end.allocations - start.allocations;
+        stats.bytes = end.bytes - start.bytes;
+        start = end;
+        bool checked = frame++ >= settings.warmupFrames && !allowed;
+        allowed = false;
+        if (!checked)
+            return;
+        stats.frames++;
+        stats.totalAllocations += stats.allocations;
+        if (stats.allocations == 0)
+            return;
+        stats.framesWithAllocations++;
+        stats.peakAllocations = stats.allocations > stats.peakAllocations ? stats.allocations : stats.peakAllocations;
+        if (settings.assertZero)
+        {
+            std::cout << "ERROR::ALLOCATION_COUNTER:: frame " << frame - 1 << " made " << stats.allocations
+                      << " heap allocations (" << stats.bytes << " bytes)" << std::endl;
+            std::abort();
+        }
+    }
+
+    const Settings &GetSettings() const { return settings; }
+
+private:
+    Settings settings;
+    AllocationCounter::Snapshot start;
+    unsigned int frame = 0;
+    bool allowed = false;
+};
+
+#ifdef ALLOCATION_COUNTER_IMPLEMENTATION
+namespace allocation_counter_detail
+{
+    inline void *allocate(std::size_t size)
+    {
+        AllocationCounter::CountAllocation(size);
+        if (size == 0)
+            size = 1;
+        for (;;)
+        {
+            if (void *memory = std::malloc(size))
+                return memory;
+            std::new_handler handler = std::get_new_handler();
+            if (!handler)
+                throw std::bad_alloc();
+            handler();
+        }
+    }
+
+    inline void release(void *memory) noexcept
+    {
+        if (!memory)
+            return;
+        AllocationCounter::CountFree();
+        std::free(memory);
+    }
+
+    struct Installer {
+        Installer() { AllocationCounter::MarkInstalled(); }
+    };
+    static Installer installer;
+}
+
+void *operator new(std::size_t size) { return allocation_counter_detail::allocate(size); }
+void *operator new[](std::size_t size) { return allocation_counter_detail::allocate(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    try { return allocation_counter_detail::allocate(size); }
+    catch (...) { return nullptr; }
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    try { return allocation_counter_detail::allocate(size); }
+    catch (...) { return nullptr; }
+}
+void operator delete(void *memory) noexcept { allocation_counter_detail::release(memory); }
+void operator delete[](void *memory) noexcept { allocation_counter_detail::release(memory); }
+void operator delete(void *memory, std::size_t) noexcept { allocation_counter_detail::release(memory); }
+void operator delete[](void *memory, std::size_t) noexcept { allocation_counter_detail::release(memory); }
+void operator delete(void *memory, const std::nothrow_t &) noexcept { allocation_counter_detail::release(memory); }
+void operator delete[](void *memory, const std::nothrow_t &) noexcept { allocation_counter_detail::release(memory); }
+#endif
+#endif
@@ -0,0 +1,112 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <vector>
+
+// Camera path through control points: a Catmull-Rom spline (it passes through every point, with the tangents of its
+// neighbours) sampled at constant speed. The arc length is tabulated once in Build, so Sample maps the fraction of
+// the path to a distance along it instead of to a spline parameter, which would speed up on long spans.
+// Either every point has a look-at target, interpolated the same way, or none does and the camera looks ahead.
+class CameraPath
+{
+public:
+    struct Pose {
+        glm::vec3 position = glm::vec3(0.0f);
+        glm::vec3 target = glm::vec3(0.0f, 0.0f, -1.0f); // point looked at
+    };
+
+    void Clear()
+    {
+        points.clear();
+        targets.clear();
+        lengths.clear();
+    }
+
+    void Add(const glm::vec3 &point) { points.push_back(point); }
+    void Add(const glm::vec3 &point, const glm::vec3 &target)
+    {
+        points.push_back(point);
+        targets.push_back(target);
+    }
+
+    // tabulates the arc length; call after the last Add
+    void Build(unsigned int samplesPerSpan = 32)
+    {
+        if (!targets.empty())
+            targets.resize(points.size(), targets.back());
+        lengths.assign(1, 0.0f);
+        spanSamples = std::max(1u, samplesPerSpan);
+        if (points.size() < 2)
+            return;
+        glm::vec3 previous = points[0];
+        for (unsigned int span = 0; span + 1 < points.size(); span++)
+        {
+            for (unsigned int i = 1; i <= spanSamples; i++)
+            {
+                glm::vec3 point = evaluate(points, span, static_cast<float>(i) / spanSamples);
+                lengths.push_back(lengths.back() + glm::length(point - previous));
+                previous = point;
+            }
+        }
+    }
+
+    float Length() const { return lengths.empty() ? 0.0f : lengths.back(); }
+
+    // pose at a fraction (0 to 1) of the path's length
+    Pose Sample(float fraction) const
+    {
+        Pose pose;
+        if (points.empty())
+            return pose;
+        if (points.size() < 2 || lengths.size() < 2)
+        {
+            pose.position = points[0];
+            pose.target = targets.empty() ? points[0] + glm::vec3(0.0f, 0.0f, -1.0f) : targets[0];
+            return pose;
+        }
+        float distance = std::min(std::max(fraction, 0.0f), 1.0f) * Length();
+        size_t sample = std::upper_bound(lengths.begin(), lengths.end(), distance) - lengths.begin();
+        sample = std::min(std::max(sample, static_cast<size_t>(1)), lengths.size() - 1);
+        float segment = lengths[sample] - lengths[sample - 1];
+        float within = segment > 0.0f ? (distance - lengths[sample - 1]) / segment : 0.0f;
+        float parameter = (static_cast<float>(sample - 1) + within) / spanSamples; // spans from the start
+        unsigned int span = std::min(static_cast<unsigned int>(parameter), static_cast<unsigned int>(points.size()) - 2);
+        float t = parameter - span;
+
+        pose.position = evaluate(points, span, t);
+        if (!targets.empty())
+            pose.target = evaluate(targets, span, t);
+        else
+        {
+            // a little further along the path, or the last direction at the end
+            glm::vec3 ahead = evaluate(points, span, std::min(t + 0.05f, 1.0f));
+            glm::vec3 direction = ahead - pose.position;
+            if (glm::dot(direction, direction) < 1e-8f)
+                direction = points[span + 1] - points[span];
+            pose.target = pose.position + direction;
+        }
+        return pose;
+    }
+
+private:
+    std::vector<glm::vec3> points;
+    std::vector<glm::vec3> targets;
+    std::vector<float> lengths; // arc length at every tabulated sample, spanSamples per span
+    unsigned int spanSamples = 32;
+
+    // Catmull-Rom between values[span] and values[span + 1]; the ends repeat the first and last point
+    static glm::vec3 evaluate(const std::vector<glm::vec3> &values, unsigned int span, float t)
+    {
+        const glm::vec3 &p1 = values[span];
+        const glm::vec3 &p2 = values[span + 1];
+        const glm::vec3 &p0 = span > 0 ? values[span - 1] : p1;
+        const glm::vec3 &p3 = span + 2 < values.size() ? values[span + 2] : p2;
+        float t2 = t * t, t3 = t2 * t;
+        return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+                       (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+    }
+};
+#endif
@@ -0,0 +1,246 @@
+#ifndef CELLS_H
+#define CELLS_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// set of cells, one bit per cell
+typedef uint64_t CellMask;
+
+// Cell and portal visibility on the floor plane (XZ).
+// Every axis aligned rectangle (minX, maxX, minZ, maxZ) becomes a cell and every place where two rectangles touch or
+// overlap becomes a portal. The walls are vertical and the level has a single floor, so the visibility is solved in 2D:
+// starting at the camera's cell with the horizontal angle range of the view frustum, each portal narrows the range
+// and the cells reached through a non empty range are visible.
+class CellGraph
+{
+public:
+    static const unsigned int MAX_CELLS = 64;
+
+    struct Cell {
+        glm::vec4 rect; // minX, maxX, minZ, maxZ
+        std::vector<unsigned int> portals;
+    };
+
+    struct Portal {
+        unsigned int cellA;
+        unsigned int cellB;
+        glm::vec4 rect; // shared region of the two cells, can be a segment
+    };
+
+    std::vector<Cell> cells;
+    std::vector<Portal> portals;
+
+    // rectangles closer than tolerance are treated as touching; inverted rectangles are skipped.
+    // Portals are grown by padding on every side because the walkable rectangles sit slightly inside the walls.
+    void Build(const std::vector<glm::vec4> &zones, float tolerance, float padding)
+    {
+        cells.clear();
+        portals.clear();
+        for (unsigned int i = 0; i < zones.size(); i++)
+        {
+            if (zones[i].x > zones[i].y || zones[i].z > zones[i].w)
+                continue;
+            if (cells.size() == MAX_CELLS)
+            {
+                std::cout << "ERROR::CELLS:: more than " << MAX_CELLS << " cells, the rest are ignored" << std::endl;
+                break;
+            }
+            Cell cell;
+            cell.rect = zones[i];
+            cells.push_back(cell);
+        }
+
+        for (unsigned int a = 0; a < cells.size(); a++)
+        {
+            for (unsigned int b = a + 1; b < cells.size(); b++)
+            {
+                const glm::vec4 &ra = cells[a].rect;
+                const glm::vec4 &rb = cells[b].rect;
+                float minX = glm::max(ra.x, rb.x), maxX = glm::min(ra.y, rb.y);
+                float minZ = glm::max(ra.z, rb.z), maxZ = glm::min(ra.w, rb.w);
+                if (maxX < minX - tolerance || maxZ < minZ - tolerance)
+                    continue;
+                // a gap within the tolerance collapses to the middle line
+                if (maxX < minX) minX = maxX = (minX + maxX) * 0.5f;
+                if (maxZ < minZ) minZ = maxZ = (minZ + maxZ) * 0.5f;
+                // touching only at a corner is not an opening
+                if (maxX - minX < tolerance && maxZ - minZ < tolerance)
+                    continue;
+                Portal portal;
+                portal.cellA = a;
+                portal.cellB = b;
+                portal.rect = glm::vec4(minX - padding, maxX + padding, minZ - padding, maxZ + padding);
+                cells[a].portals.push_back(static_cast<unsigned int>(portals.size()));
+                cells[b].portals.push_back(static_cast<unsigned int>(portals.size()));
+                portals.push_back(portal);
+            }
+        }
+    }
+
+    // cells whose rectangle, grown by margin, overlaps the box on the floor plane (0 means outside every cell)
+    CellMask CellsOverlapping(const BoundingBox &box, float margin) const
+    {
+        CellMask mask = 0;
+        for (unsigned int i = 0; i < cells.size(); i++)
+        {
+            const glm::vec4 &r = cells[i].rect;
+            if (box.max.x >= r.x - margin && box.min.x <= r.y + margin &&
+                box.max.z >= r.z - margin && box.min.z <= r.w + margin)
+                mask |= CellMask(1) << i;
+        }
+        return mask;
+    }
+
+    CellMask CellsContaining(const glm::vec3 &point, float margin) const
+    {
+        BoundingBox box;
+        box.min = box.max = point;
+        return CellsOverlapping(box, margin);
+    }
+
+    // flood fills the visible cells from the eye through the portals
+    void ComputeVisibleCells(const glm::vec3 &eye, const glm::mat4 &viewProjection)
+    {
+        visibleMask = 0;
+        CellMask eyeCells = CellsContaining(eye, 0.05f);
+        if (eyeCells == 0)
+        {
+            // outside the level, nothing can be decided
+            visibleMask = ~CellMask(0);
+            return;
+        }
+
+        float lo, hi;
+        bool full = !viewAngleRange(eye, viewProjection, lo, hi);
+        if (full)
+        {
+            lo = -PI;
+            hi = PI;
+        }
+
+        for (unsigned int i = 0; i < cells.size(); i++)
+        {
+            if (eyeCells & (CellMask(1) << i))
+                visit(i, eye, lo, hi, full, 0, 0);
+        }
+    }
+
+    CellMask VisibleMask() const { return visibleMask; }
+
+    // objects outside every cell (mask 0) are never rejected
+    bool IsVisible(CellMask objectCells) const
+    {
+        return objectCells == 0 || (objectCells & visibleMask) != 0;
+    }
+
+    unsigned int VisibleCount() const
+    {
+        unsigned int count = 0;
+        for (unsigned int i = 0; i < cells.size(); i++)
+            count += (visibleMask >> i) & 1;
+        return count;
+    }
+
+private:
+    static constexpr float PI = 3.14159265358979f;
+    static const unsigned int MAX_DEPTH = 32;
+
+    CellMask visibleMask = ~CellMask(0);
+
+    static float wrapAngle(float a)
+    {
+        while (a > PI) a -= 2.0f * PI;
+        while (a < -PI) a += 2.0f * PI;
+        return a;
+    }
+
+    // horizontal angle range covered by the frustum corners, false if it spans half a turn or more
+    static bool viewAngleRange(const glm::vec3 &eye, const glm::mat4 &viewProjection, float &lo, float &hi)
+    {
+        glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+        glm::vec4 farCenter = inverseViewProjection * glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+        glm::vec2 forward = glm::vec2(farCenter.x, farCenter.z) / farCenter.w - glm::vec2(eye.x, eye.z);
+        if (glm::length(forward) < 1e-3f)
+            return false;
+        float center = std::atan2(forward.y, forward.x);
+        float minDelta = 0.0f, maxDelta = 0.0f;
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec4 corner = inverseViewProjection * glm::vec4((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f, 1.0f);
+            glm::vec2 d = glm::vec2(corner.x, corner.z) / corner.w - glm::vec2(eye.x, eye.z);
+            if (glm::length(d) < 1e-4f)
+                continue;
+            float delta = wrapAngle(std::atan2(d.y, d.x) - center);
+            minDelta = glm::min(minDelta, delta);
+            maxDelta = glm::max(maxDelta, delta);
+        }
+        if (maxDelta - minDelta >= PI)
+            return false;
+        lo = center + minDelta;
+        hi = center + maxDelta;
+        return true;
+    }
+
+    // path holds the cells already on the way from the eye (a portal never leads back into one of them) and depth
+    // their count, so the flood fill does not allocate
+    void visit(unsigned int cellIndex, const glm::vec3 &eye, float lo, float hi, bool full, CellMask path, unsigned int depth)
+    {
+        visibleMask |= CellMask(1) << cellIndex;
+        if (depth >= MAX_DEPTH)
+            return;
+        path |= CellMask(1) << cellIndex;
+        depth++;
+
+        const Cell &cell = cells[cellIndex];
+        for (unsigned int p = 0; p < cell.portals.size(); p++)
+        {
+            const Portal &portal = portals[cell.portals[p]];
+            unsigned int next = portal.cellA == cellIndex ? portal.cellB : portal.cellA;
+            if (path & (CellMask(1) << next))
+                continue;
+
+            const glm::vec4 &r = portal.rect;
+            const float margin = 0.05f;
+            if (eye.x >= r.x - margin && eye.x <= r.y + margin && eye.z >= r.z - margin && eye.z <= r.w + margin)
+            {
+                // standing in the opening, the range does not change
+                visit(next, eye, lo, hi, full, path, depth);
+                continue;
+            }
+
+            // angle range of the portal's corners seen from the eye
+            float center = std::atan2((r.z + r.w) * 0.5f - eye.z, (r.x + r.y) * 0.5f - eye.x);
+            float minDelta = 0.0f, maxDelta = 0.0f;
+            for (int i = 0; i < 4; i++)
+            {
+                float x = (i & 1) ? r.y : r.x;
+                float z = (i & 2) ? r.w : r.z;
+                float delta = wrapAngle(std::atan2(z - eye.z, x - eye.x) - center);
+                minDelta = glm::min(minDelta, delta);
+                maxDelta = glm::max(maxDelta, delta);
+            }
+            float portalLo = center + minDelta;
+            float portalHi = center + maxDelta;
+
+            float newLo = portalLo, newHi = portalHi;
+            if (!full)
+            {
+                // move the portal range to the same turn as the current range before intersecting
+                float shift = 2.0f * PI * std::round(((lo + hi) * 0.5f - center) / (2.0f * PI));
+                newLo = glm::max(lo, portalLo + shift);
+                newHi = glm::min(hi, portalHi + shift);
+                if (newLo > newHi)
+                    continue;
+            }
+            visit(next, eye, newLo, newHi, false, path, depth);
+        }
+    }
+};
+#endif
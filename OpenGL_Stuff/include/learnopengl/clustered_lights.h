@@ -0,0 +1,287 @@
+#ifndef CLUSTERED_LIGHTS_H
+#define CLUSTERED_LIGHTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+// Clustered forward lighting.
+// The view frustum is split into TILES_X x TILES_Y screen tiles and SLICES depth slices (exponential in depth). Every
+// frame the lights are binned on the CPU into the clusters their sphere of influence touches, and three texture buffers
+// are uploaded: the lights, the (offset, count) range of each cluster and the light indices of all the ranges.
+// The fragment shader finds its cluster from gl_FragCoord and only loops over those lights. Texture buffers are core
+// since OpenGL 3.1, so this works on the 3.3 context as well.
+class ClusteredLights
+{
+public:
+    static const unsigned int TILES_X = 16;
+    static const unsigned int TILES_Y = 9;
+    static const unsigned int SLICES = 24;
+    static const unsigned int CLUSTER_COUNT = TILES_X * TILES_Y * SLICES;
+    static const unsigned int MAX_LIGHTS = 256;
+    static const unsigned int MAX_LIGHT_INDICES = 64 * 1024;
+    // texture units of the three buffers (the material slots use the first units)
+    static const unsigned int FIRST_UNIT = 4;
+
+    // point light with the same attenuation terms as the PointLight of shader.fs (constant 1), clipped to radius
+    struct Light {
+        glm::vec3 position;
+        float radius;
+        glm::vec3 color;
+        float ambient;   // fraction of color added as ambient
+        float linear;
+        float quadratic;
+    };
+
+    struct Stats {
+        unsigned int lights = 0;
+        unsigned int indices = 0;       // light references over all clusters
+        unsigned int maxPerCluster = 0;
+        unsigned int droppedLights = 0; // over MAX_LIGHTS or MAX_LIGHT_INDICES
+        float buildMs = 0.0f;
+    };
+
+    Stats stats;
+
+    void Init()
+    {
+        lights.reserve(MAX_LIGHTS);
+        pairs.reserve(MAX_LIGHT_INDICES);
+        counts.resize(CLUSTER_COUNT);
+        ranges.resize(CLUSTER_COUNT * 2);
+        indices.resize(MAX_LIGHT_INDICES);
+        lightTexels.resize(MAX_LIGHTS * TEXELS_PER_LIGHT);
+        clusterBounds.resize(CLUSTER_COUNT);
+        rowBounds.resize(SLICES * TILES_Y);
+
+        createBuffer(lightBuffer, lightTexture, MAX_LIGHTS * TEXELS_PER_LIGHT * sizeof(glm::vec4), GL_RGBA32F);
+        createBuffer(rangeBuffer, rangeTexture, CLUSTER_COUNT * 2 * sizeof(unsigned int), GL_RG32UI);
+        createBuffer(indexBuffer, indexTexture, MAX_LIGHT_INDICES * sizeof(unsigned int), GL_R32UI);
+    }
+
+    void Clear()
+    {
+        lights.clear();
+        stats.droppedLights = 0;
+    }
+
+    bool Add(const Light &light)
+    {
+        if (lights.size() >= MAX_LIGHTS)
+        {
+            stats.droppedLights++;
+            return false;
+        }
+        lights.push_back(light);
+        return true;
+    }
+
+    unsigned int Count() const { return static_cast<unsigned int>(lights.size()); }
+
+    // bins the lights for this camera and uploads the buffers; nearPlane/farPlane must match the projection
+    void Build(const glm::mat4 &view, const glm::mat4 &projection, float nearPlane, float farPlane)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (projection != lastProjection || nearPlane != zNear || farPlane != zFar)
+            computeClusterBounds(projection, nearPlane, farPlane);
+
+        // third row of the view matrix, negated: the shader gets the view depth of a world position with one dot product
+        viewDepth = -glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]);
+
+        std::fill(counts.begin(), counts.end(), 0u);
+        pairs.clear();
+        const float logRatio = std::log(zFar / zNear);
+        for (unsigned int l = 0; l < lights.size(); l++)
+        {
+            const Light &light = lights[l];
+            glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+            float depthMin = -center.z - light.radius;
+            float depthMax = -center.z + light.radius;
+            if (depthMax < zNear || depthMin > zFar)
+                continue;
+            unsigned int sliceMin = sliceOf(glm::max(depthMin, zNear), logRatio);
+            unsigned int sliceMax = sliceOf(glm::min(depthMax, zFar), logRatio);
+            for (unsigned int row = sliceMin * TILES_Y; row < (sliceMax + 1) * TILES_Y; row++)
+            {
+                // a whole row of tiles is rejected first
+                if (!sphereTouchesBox(center, light.radius, rowBounds[row]))
+                    continue;
+                for (unsigned int c = row * TILES_X; c < (row + 1) * TILES_X; c++)
+                {
+                    if (!sphereTouchesBox(center, light.radius, clusterBounds[c]))
+                        continue;
+                    if (pairs.size() == MAX_LIGHT_INDICES)
+                    {
+                        stats.droppedLights++;
+                        break;
+                    }
+                    pairs.push_back(Pair{ c, l });
+                    counts[c]++;
+                }
+            }
+        }
+
+        // ranges as a prefix sum of the counts, then the indices scattered into their ranges in light order
+        unsigned int offset = 0;
+        stats.maxPerCluster = 0;
+        for (unsigned int c = 0; c < CLUSTER_COUNT; c++)
+        {
+            ranges[c * 2] = offset;
+            ranges[c * 2 + 1] = 0;
+            offset += counts[c];
+            stats.maxPerCluster = std::max(stats.maxPerCluster, counts[c]);
+        }
+        for (unsigned int i = 0; i < pairs.size(); i++)
+        {
+            unsigned int c = pairs[i].cluster;
+            indices[ranges[c * 2] + ranges[c * 2 + 1]++] = pairs[i].light;
+        }
+
+        for (unsigned int l = 0; l < lights.size(); l++)
+        {
+            const Light &light = lights[l];
+            lightTexels[l * TEXELS_PER_LIGHT + 0] = glm::vec4(light.position, light.radius);
+            lightTexels[l * TEXELS_PER_LIGHT + 1] = glm::vec4(light.color, light.ambient);
+            lightTexels[l * TEXELS_PER_LIGHT + 2] = glm::vec4(light.linear, light.quadratic, 0.0f, 0.0f);
+        }
+        upload(lightBuffer, lightTexels.data(), lights.size() * TEXELS_PER_LIGHT * sizeof(glm::vec4));
+        upload(rangeBuffer, ranges.data(), ranges.size() * sizeof(unsigned int));
+        upload(indexBuffer, indices.data(), pairs.size() * sizeof(unsigned int));
+
+        stats.lights = Count();
+        stats.indices = static_cast<unsigned int>(pairs.size());
+        stats.buildMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // binds the buffers and sets the cluster uniforms for the current viewport; the shader must be in use
+    void Bind(const Shader &shader) const
+    {
+        glActiveTexture(GL_TEXTURE0 + FIRST_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, lightTexture);
+        glActiveTexture(GL_TEXTURE0 + FIRST_UNIT + 1);
+        glBindTexture(GL_TEXTURE_BUFFER, rangeTexture);
+        glActiveTexture(GL_TEXTURE0 + FIRST_UNIT + 2);
+        glBindTexture(GL_TEXTURE_BUFFER, indexTexture);
+        glActiveTexture(GL_TEXTURE0);
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        // slice = log(depth) * scale + bias
+        float scale = SLICES / std::log(zFar / zNear);
+        shader.setInt("clusterLights", FIRST_UNIT);
+        shader.setInt("clusterRanges", FIRST_UNIT + 1);
+        shader.setInt("clusterIndices", FIRST_UNIT + 2);
+        shader.setInt("clusterLightCount", static_cast<int>(lights.size()));
+        shader.setVec3("clusterGrid", float(TILES_X), float(TILES_Y), float(SLICES));
+        shader.setVec2("clusterTileSize", float(viewport[2]) / TILES_X, float(viewport[3]) / TILES_Y);
+        shader.setVec4("clusterViewDepth", viewDepth);
+        shader.setVec2("clusterSlice", scale, -std::log(zNear) * scale);
+    }
+
+private:
+    static const unsigned int TEXELS_PER_LIGHT = 3;
+
+    struct Pair {
+        unsigned int cluster;
+        unsigned int light;
+    };
+
+    std::vector<Light> lights;
+    std::vector<Pair> pairs;
+    std::vector<unsigned int> counts;
+    std::vector<unsigned int> ranges;  // offset, count per cluster
+    std::vector<unsigned int> indices;
+    std::vector<glm::vec4> lightTexels;
+    std::vector<BoundingBox> clusterBounds; // view space
+    std::vector<BoundingBox> rowBounds;     // union of the clusters of each row of tiles in a slice
+
+    glm::mat4 lastProjection = glm::mat4(0.0f);
+    float zNear = 0.1f, zFar = 100.0f;
+    glm::vec4 viewDepth = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+
+    unsigned int lightBuffer = 0, lightTexture = 0;
+    unsigned int rangeBuffer = 0, rangeTexture = 0;
+    unsigned int indexBuffer = 0, indexTexture = 0;
+
+    static void createBuffer(unsigned int &buffer, unsigned int &texture, size_t size, GLenum format)
+    {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferData(GL_TEXTURE_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    static void upload(unsigned int buffer, const void *data, size_t size)
+    {
+        if (size == 0)
+            return;
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    unsigned int sliceOf(float depth, float logRatio) const
+    {
+        int slice = static_cast<int>(std::log(depth / zNear) / logRatio * SLICES);
+        return static_cast<unsigned int>(glm::clamp(slice, 0, static_cast<int>(SLICES) - 1));
+    }
+
+    static bool sphereTouchesBox(const glm::vec3 &center, float radius, const BoundingBox &box)
+    {
+        glm::vec3 closest = glm::clamp(center, box.min, box.max);
+        glm::vec3 d = closest - center;
+        return glm::dot(d, d) <= radius * radius;
+    }
+
+    // view space box of every cluster, only redone when the projection changes
+    void computeClusterBounds(const glm::mat4 &projection, float nearPlane, float farPlane)
+    {
+        lastProjection = projection;
+        zNear = nearPlane;
+        zFar = farPlane;
+        glm::mat4 inverseProjection = glm::inverse(projection);
+        for (unsigned int z = 0; z < SLICES; z++)
+        {
+            float depthNear = zNear * std::pow(zFar / zNear, float(z) / SLICES);
+            float depthFar = zNear * std::pow(zFar / zNear, float(z + 1) / SLICES);
+            for (unsigned int y = 0; y < TILES_Y; y++)
+            {
+                for (unsigned int x = 0; x < TILES_X; x++)
+                {
+                    BoundingBox &box = clusterBounds[(z * TILES_Y + y) * TILES_X + x];
+                    for (int corner = 0; corner < 4; corner++)
+                    {
+                        float ndcX = -1.0f + 2.0f * float(x + (corner & 1)) / TILES_X;
+                        float ndcY = -1.0f + 2.0f * float(y + (corner >> 1)) / TILES_Y;
+                        glm::vec4 onNear = inverseProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+                        glm::vec3 ray = glm::vec3(onNear) / onNear.w;
+                        glm::vec3 a = ray * (depthNear / -ray.z);
+                        glm::vec3 b = ray * (depthFar / -ray.z);
+                        if (corner == 0)
+                        {
+                            box.min = glm::min(a, b);
+                            box.max = glm::max(a, b);
+                        }
+                        box.min = glm::min(box.min, glm::min(a, b));
+                        box.max = glm::max(box.max, glm::max(a, b));
+                    }
+                    BoundingBox &row = rowBounds[z * TILES_Y + y];
+                    row.min = x == 0 ? box.min : glm::min(row.min, box.min);
+                    row.max = x == 0 ? box.max : glm::max(row.max, box.max);
+                }
+            }
+        }
+    }
+};
+#endif
@@ -0,0 +1,264 @@
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// CPU time of named zones in the render loop, the game logic and the worker threads.
+// CPU_ZONE("name") times the rest of the enclosing block; Begin and End do the same for code that is not a block.
+// Every thread writes its zones into its own ring buffer, registered under a lock the first time the thread records
+// and never again, so recording takes no lock and no atomic read-modify-write: the owner thread publishes its write
+// index with a release store. WriteTrace copies the rings from any thread and drops the entries the owners may have
+// overwritten during the copy, then writes a Chrome trace event file that ui.perfetto.dev and chrome://tracing open.
+// With recording off a zone costs the load and the branch on a flag that only changes on a key press; defining
+// CPU_PROFILER_DISABLED removes the zones from the build.
+// Zone names are kept as pointers, so they have to outlive the profiler (string literals).
+class CpuProfiler
+{
+public:
+    static const unsigned int CAPACITY = 1u << 15; // zones kept per thread, the oldest are overwritten
+    static const unsigned int MAX_DEPTH = 64;      // open zones per thread, deeper ones are not recorded
+
+    struct Overhead {
+        double baselineNs = 0.0; // per iteration of the loop without a zone
+        double disabledNs = 0.0; // added by a zone with recording off
+        double enabledNs = 0.0;  // added by a recorded zone
+    };
+
+    class Zone
+    {
+    public:
+        explicit Zone(const char *name) : active(Recording())
+        {
+            if (active)
+                Begin(name);
+        }
+        ~Zone()
+        {
+            if (active)
+                End();
+        }
+        Zone(const Zone &) = delete;
+        Zone &operator=(const Zone &) = delete;
+
+    private:
+        bool active;
+    };
+
+    static bool Recording() { return recordingFlag().load(std::memory_order_relaxed); }
+
+    // starts a capture (the trace only keeps zones that began after this) or stops it
+    static void SetRecording(bool recording)
+    {
+        if (recording && !Recording())
+            captureStart().store(now(), std::memory_order_relaxed);
+        recordingFlag().store(recording, std::memory_order_relaxed);
+    }
+
+    // name shown for the calling thread in the trace
+    static void SetThreadName(const std::string &name)
+    {
+        ThreadBuffer &buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(registryMutex());
+        buffer.name = name;
+    }
+
+    // name must outlive the profiler
+    static void Begin(const char *name)
+    {
+        ThreadBuffer &buffer = threadBuffer();
+        if (buffer.depth < MAX_DEPTH)
+        {
+            buffer.open[buffer.depth].name = name;
+            buffer.open[buffer.depth].startNs = now();
+        }
+        buffer.depth++;
+    }
+
+    static void End()
+    {
+        ThreadBuffer &buffer = threadBuffer();
+        if (buffer.depth == 0)
+            return;
+        buffer.depth--;
+        if (buffer.depth >= MAX_DEPTH)
+            return;
+        uint64_t head = buffer.head.load(std::memory_order_relaxed);
+        Event &event = buffer.events[head % CAPACITY];
+        event.name = buffer.open[buffer.depth].name;
+        event.startNs = buffer.open[buffer.depth].startNs;
+        event.endNs = now();
+        event.depth = buffer.depth;
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    // Chrome trace event file with the zones of every thread since the capture started; false when it cannot be
+    // written. The GPU profiler writes its trace with pid 2, so both files can be loaded together.
+    static bool WriteTrace(const std::string &path)
+    {
+        FILE *file = std::fopen(path.c_str(), "w");
+        if (!file)
+        {
+            std::cout << "ERROR::CPU_PROFILER:: cannot create " << path << std::endl;
+            return false;
+        }
+        int64_t start = captureStart().load(std::memory_order_relaxed);
+        std::vector<Event> events;
+        std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+                           "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"CPU\"}}");
+        std::lock_guard<std::mutex> lock(registryMutex());
+        std::vector<ThreadBuffer *> &buffers = registry();
+        size_t written = 0;
+        for (size_t t = 0; t < buffers.size(); t++)
+        {
+            ThreadBuffer &buffer = *buffers[t];
+            std::fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                         buffer.id, buffer.name.c_str());
+            snapshot(buffer, events);
+            for (size_t i = 0; i < events.size(); i++)
+            {
+                const Event &event = events[i];
+                if (event.startNs < start)
+                    continue;
+                std::fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                             event.name, buffer.id, (event.startNs - start) / 1000.0, (event.endNs - event.startNs) / 1000.0);
+                written++;
+            }
+        }
+        std::fprintf(file, "\n]}\n");
+        std::fclose(file);
+        std::cout << "CPU_PROFILER:: " << written << " zones of " << buffers.size() << " threads written to " << path << std::endl;
+        return true;
+    }
+
+    // times a loop of iterations with and without a zone; leaves recording as it was
+    static Overhead MeasureOverhead(unsigned int iterations = 10000000)
+    {
+        bool wasRecording = Recording();
+        volatile unsigned int sink = 0;
+        Overhead overhead;
+        int64_t begin = now();
+        for (unsigned int i = 0; i < iterations; i++)
+            sink = sink + 1;
+        overhead.baselineNs = static_cast<double>(now() - begin) / iterations;
+
+        SetRecording(false);
+        begin = now();
+        for (unsigned int i = 0; i < iterations; i++)
+        {
+            Zone zone("Benchmark");
+            sink = sink + 1;
+        }
+        overhead.disabledNs = static_cast<double>(now() - begin) / iterations - overhead.baselineNs;
+
+        SetRecording(true);
+        begin = now();
+        for (unsigned int i = 0; i < iterations; i++)
+        {
+            Zone zone("Benchmark");
+            sink = sink + 1;
+        }
+        overhead.enabledNs = static_cast<double>(now() - begin) / iterations - overhead.baselineNs;
+        SetRecording(wasRecording);
+        return overhead;
+    }
+
+private:
+    struct Event {
+        const char *name;
+        int64_t startNs;
+        int64_t endNs;
+        unsigned int depth;
+    };
+
+    struct OpenZone {
+        const char *name;
+        int64_t startNs;
+    };
+
+    struct ThreadBuffer {
+        std::atomic<uint64_t> head;    // events written, only the owner thread stores it
+        std::vector<Event> events;
+        OpenZone open[MAX_DEPTH];
+        unsigned int depth = 0;
+        unsigned int id = 0;
+        std::string name;
+    };
+
+    static int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static std::atomic<bool> &recordingFlag()
+    {
+        static std::atomic<bool> recording(false);
+        return recording;
+    }
+
+    static std::atomic<int64_t> &captureStart()
+    {
+        static std::atomic<int64_t> start(0);
+        return start;
+    }
+
+    static std::mutex &registryMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    // buffers are never freed, a thread that finished still shows up in the trace
+    static std::vector<ThreadBuffer *> &registry()
+    {
+        static std::vector<ThreadBuffer *> buffers;
+        return buffers;
+    }
+
+    static ThreadBuffer &threadBuffer()
+    {
+        thread_local ThreadBuffer *buffer = nullptr;
+        if (!buffer)
+        {
+            buffer = new ThreadBuffer();
+            buffer->head.store(0, std::memory_order_relaxed);
+            buffer->events.resize(CAPACITY);
+            std::lock_guard<std::mutex> lock(registryMutex());
+            buffer->id = static_cast<unsigned int>(registry().size()) + 1;
+            buffer->name = "Thread " + std::to_string(buffer->id);
+            registry().push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    // the events of the ring that were not overwritten while they were copied, oldest first
+    static void snapshot(const ThreadBuffer &buffer, std::vector<Event> &events)
+    {
+        uint64_t head = buffer.head.load(std::memory_order_acquire);
+        uint64_t first = head > CAPACITY ? head - CAPACITY : 0;
+        events.clear();
+        for (uint64_t i = first; i < head; i++)
+            events.push_back(buffer.events[i % CAPACITY]);
+        // the owner writes event i + CAPACITY into the slot of event i before it publishes the new head
+        uint64_t after = buffer.head.load(std::memory_order_acquire);
+        uint64_t safe = after >= CAPACITY ? after - CAPACITY + 1 : 0;
+        if (safe > first)
+            events.erase(events.begin(), events.begin() + static_cast<size_t>(std::min(safe - first, static_cast<uint64_t>(events.size()))));
+    }
+};
+
+#define CPU_PROFILER_CONCAT_INNER(a, b) a##b
+#define CPU_PROFILER_CONCAT(a, b) CPU_PROFILER_CONCAT_INNER(a, b)
+#ifdef CPU_PROFILER_DISABLED
+#define CPU_ZONE(name)
+#else
+#define CPU_ZONE(name) CpuProfiler::Zone CPU_PROFILER_CONCAT(cpuZone, __LINE__)(name)
+#endif
+#endif
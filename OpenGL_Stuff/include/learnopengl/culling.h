@@ -0,0 +1,19 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/hiz.h>
+#include <learnopengl/cells.h>
+#include <learnopengl/pvs.h>
+
+// per frame culling state shared by every culled Model::Draw call.
+// The frustum is always tested, the occlusion culler and the cell graph only when set.
+struct CullContext {
+    Frustum frustum;
+    CullStats stats;
+    const HiZCuller *occlusion = nullptr;
+    const CellGraph *cells = nullptr;
+    // how far outside a cell a mesh may reach and still belong to it (walls sit just outside the walkable rectangles)
+    float cellMargin = 1.0f;
+};
+#endif
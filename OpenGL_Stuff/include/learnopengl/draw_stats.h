@@ -0,0 +1,38 @@
+#ifndef DRAW_STATS_H
+#define DRAW_STATS_H
+
+// Draw calls and triangles submitted since the last Reset, counted where the engine issues its draws (meshes, the
+// multi-draw, the shadow, Hi-Z and post passes). A multi-draw is one call with the triangles of all its commands.
+// Plain counters, they are only touched from the thread that owns the GL context.
+class DrawStats
+{
+public:
+    static void Count(unsigned long long triangles)
+    {
+        calls()++;
+        triangleCount() += triangles;
+    }
+
+    static unsigned long long Calls() { return calls(); }
+    static unsigned long long Triangles() { return triangleCount(); }
+
+    static void Reset()
+    {
+        calls() = 0;
+        triangleCount() = 0;
+    }
+
+private:
+    static unsigned long long &calls()
+    {
+        static unsigned long long count = 0;
+        return count;
+    }
+
+    static unsigned long long &triangleCount()
+    {
+        static unsigned long long count = 0;
+        return count;
+    }
+};
+#endif
@@ -0,0 +1,145 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+// Picks the render scale of the scene (a fraction of the window size per axis) that keeps the GPU frame time under a
+// target. The GPU time is the busy time of the passes of a finished frame (GpuProfiler::Stats::passGpuMs, read a few
+// frames late so the CPU never waits): the gaps in which the GPU waits for the CPU are not counted, a lower resolution
+// would not shorten them. The scale moves in fixed steps between minScale and maxScale with hysteresis: it drops after
+// a few frames over the target and only rises after many frames in which the cost predicted for the next step (scaled
+// by its pixel count) stays well under the target. While the CPU side of the frame is over the target and longer than
+// the GPU time the frame is CPU bound and the scale is held, neither resolution would change the frame rate.
+class DynamicResolution
+{
+public:
+    struct Settings {
+        bool enabled = true;
+        float minScale = 0.5f;
+        float maxScale = 1.0f;
+        float step = 0.05f;            // difference between two levels
+        float targetMs = 14.0f;        // GPU frame time to hold, leaves room under a 60 Hz vsync
+        float raiseThreshold = 0.8f;   // rise when the next level is predicted under this fraction of the target
+        unsigned int dropFrames = 3;   // consecutive frames over the target before dropping
+        unsigned int raiseFrames = 60; // consecutive frames with room before rising
+        float smoothing = 0.1f;        // weight of the newest sample in the averaged GPU and CPU times
+    };
+
+    struct Stats {
+        float gpuMs = 0.0f;                // averaged GPU busy time of the passes
+        float lastGpuMs = 0.0f;            // last measured frame
+        float cpuMs = 0.0f;                // averaged CPU time from BeginFrame to EndFrame
+        bool cpuBound = false;             // the scale is held because the CPU is the slower side
+        unsigned int changes = 0;          // times the scale changed
+        std::vector<float> secondsAtLevel; // time spent at each level, level 0 is minScale
+    };
+
+    Stats stats;
+
+    void Init(const Settings &newSettings)
+    {
+        settings = newSettings;
+        settings.maxScale = std::min(1.0f, std::max(settings.maxScale, 0.1f));
+        settings.minScale = std::min(settings.maxScale, std::max(settings.minScale, 0.1f));
+        settings.step = std::max(settings.step, 0.01f);
+        levelCount = static_cast<unsigned int>(std::floor((settings.maxScale - settings.minScale) / settings.step + 0.5f)) + 1;
+        level = levelCount - 1;
+        stats.secondsAtLevel.assign(levelCount, 0.0f);
+        gpuSample = 0;
+    }
+
+    // start of the CPU work of the frame, right after the frame pacing wait
+    void BeginFrame()
+    {
+        cpuStart = std::chrono::steady_clock::now();
+    }
+
+    // end of the CPU work of the frame, before the swap. frameSeconds is the wall time of the frame, added to the
+    // current level; gpuMs is the GPU busy time of the last frame the profiler read and sample its count of frames
+    // read, so a frame is only counted once
+    void EndFrame(float frameSeconds, float gpuMs, unsigned int sample)
+    {
+        float cpuMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - cpuStart).count();
+        stats.cpuMs = stats.cpuMs == 0.0f ? cpuMs : stats.cpuMs + (cpuMs - stats.cpuMs) * settings.smoothing;
+        stats.secondsAtLevel[level] += frameSeconds;
+        if (sample == gpuSample)
+            return;
+        gpuSample = sample;
+
+        stats.lastGpuMs = gpuMs;
+        stats.gpuMs = stats.gpuMs == 0.0f ? stats.lastGpuMs : stats.gpuMs + (stats.lastGpuMs - stats.gpuMs) * settings.smoothing;
+        stats.cpuBound = stats.cpuMs > settings.targetMs && stats.cpuMs > stats.gpuMs;
+        if (stats.cpuBound)
+            framesOver = framesUnder = 0;
+        else if (settings.enabled)
+            control();
+    }
+
+    void SetEnabled(bool enabled)
+    {
+        settings.enabled = enabled;
+        if (!enabled)
+            setLevel(levelCount - 1);
+    }
+    bool IsEnabled() const { return settings.enabled; }
+
+    float Scale() const { return LevelScale(level); }
+    unsigned int Level() const { return level; }
+    unsigned int LevelCount() const { return levelCount; }
+    float LevelScale(unsigned int index) const { return std::min(settings.maxScale, settings.minScale + index * settings.step); }
+    const Settings &GetSettings() const { return settings; }
+
+private:
+    Settings settings;
+    std::chrono::steady_clock::time_point cpuStart;
+    unsigned int gpuSample = 0;
+    unsigned int levelCount = 1;
+    unsigned int level = 0;
+    unsigned int framesOver = 0;
+    unsigned int framesUnder = 0;
+
+    void control()
+    {
+        if (stats.gpuMs > settings.targetMs)
+        {
+            framesUnder = 0;
+            if (++framesOver >= settings.dropFrames && level > 0)
+            {
+                // jump straight to the level whose pixel count fits the target, at least one step
+                float wanted = Scale() * std::sqrt(settings.targetMs / stats.gpuMs);
+                unsigned int fit = wanted <= settings.minScale ? 0u
+                                   : static_cast<unsigned int>(std::floor((wanted - settings.minScale) / settings.step));
+                setLevel(std::min(fit, level - 1));
+            }
+            return;
+        }
+        framesOver = 0;
+        if (level + 1 >= levelCount)
+            return;
+        float next = LevelScale(level + 1);
+        float predicted = stats.gpuMs * (next * next) / (Scale() * Scale());
+        if (predicted < settings.targetMs * settings.raiseThreshold)
+        {
+            if (++framesUnder >= settings.raiseFrames)
+                setLevel(level + 1);
+        }
+        else
+            framesUnder = 0;
+    }
+
+    // the averaged time is rescaled by the pixel count so the new level is not judged by the old one's cost
+    void setLevel(unsigned int newLevel)
+    {
+        if (newLevel == level)
+            return;
+        float ratio = LevelScale(newLevel) / Scale();
+        stats.gpuMs *= ratio * ratio;
+        level = newLevel;
+        framesOver = framesUnder = 0;
+        stats.changes++;
+    }
+};
+#endif
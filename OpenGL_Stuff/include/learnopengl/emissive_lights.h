@@ -0,0 +1,209 @@
+#ifndef EMISSIVE_LIGHTS_H
+#define EMISSIVE_LIGHTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/clustered_lights.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <vector>
+
+// Point lights generated from the emissive surfaces of a static model.
+// At import every triangle of a mesh with an emissive map is sampled in a small mip of the map; its emitted power
+// (area * luminance) and colour are accumulated into a world space grid. Every grid cell that emits becomes one proxy
+// light at the power weighted centre of its surfaces, pushed out along their normal. Only the most powerful lights are
+// kept, and each frame the closest/strongest ones within a budget are handed to the clustered lights.
+class EmissiveProxyLights
+{
+public:
+    struct Settings {
+        float cellSize = 2.5f;          // surfaces closer than this end up in the same light
+        float minLuminance = 0.05f;     // darker texels do not emit
+        unsigned int maxLights = 64;    // cap after the extraction, the least powerful cells are dropped
+        unsigned int sampleSize = 64;   // the emissive map is read at the first mip level not larger than this
+        float normalOffset = 0.3f;      // distance from the surface to the light
+        float intensityScale = 0.5f;    // light colour = emissive colour * min(maxIntensity, power * intensityScale)
+        float maxIntensity = 1.5f;
+        float radiusScale = 3.0f;       // radius = radiusScale * sqrt(power), clamped to [minRadius, maxRadius]
+        float minRadius = 1.5f;
+        float maxRadius = 8.0f;
+    };
+
+    struct Proxy {
+        ClusteredLights::Light light;
+        float power;
+    };
+
+    std::vector<Proxy> proxies; // sorted by power, most powerful first
+
+    void Extract(const std::vector<Mesh> &meshes, const glm::mat4 &modelMatrix, const Settings &settings)
+    {
+        proxies.clear();
+        std::map<unsigned int, Image> images;
+        std::map<long long, Cell> cells;
+        glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
+
+        for (unsigned int m = 0; m < meshes.size(); m++)
+        {
+            const Mesh &mesh = meshes[m];
+            unsigned int emissive = mesh.material.Texture(TextureSlot::Emissive);
+            if (emissive == 0)
+                continue;
+            if (images.find(emissive) == images.end())
+                images[emissive] = readBack(emissive, settings.sampleSize);
+            const Image &image = images[emissive];
+            if (image.width == 0)
+                continue;
+
+            for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+            {
+                const Vertex &a = mesh.vertices[mesh.indices[i]];
+                const Vertex &b = mesh.vertices[mesh.indices[i + 1]];
+                const Vertex &c = mesh.vertices[mesh.indices[i + 2]];
+                glm::vec3 pa = glm::vec3(modelMatrix * glm::vec4(a.Position, 1.0f));
+                glm::vec3 pb = glm::vec3(modelMatrix * glm::vec4(b.Position, 1.0f));
+                glm::vec3 pc = glm::vec3(modelMatrix * glm::vec4(c.Position, 1.0f));
+                glm::vec3 cross = glm::cross(pb - pa, pc - pa);
+                float area = 0.5f * glm::length(cross);
+                if (area <= 0.0f)
+                    continue;
+
+                // average of the corners and the centre of the triangle in the map
+                glm::vec2 uvCenter = (a.TexCoords + b.TexCoords + c.TexCoords) / 3.0f;
+                glm::vec3 color = (image.Sample(a.TexCoords) + image.Sample(b.TexCoords) + image.Sample(c.TexCoords) +
+                                   image.Sample(uvCenter) * 3.0f) / 6.0f;
+                float luminance = glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+                if (luminance < settings.minLuminance)
+                    continue;
+
+                glm::vec3 center = (pa + pb + pc) / 3.0f;
+                glm::vec3 normal = normalMatrix * (a.Normal + b.Normal + c.Normal);
+                float power = area * luminance;
+                Cell &cell = cells[cellKey(center, settings.cellSize)];
+                cell.power += power;
+                cell.position += center * power;
+                cell.color += color * area;
+                cell.normal += glm::length(normal) > 0.0f ? glm::normalize(normal) * power : glm::vec3(0.0f);
+                cell.area += area;
+            }
+        }
+
+        for (std::map<long long, Cell>::const_iterator it = cells.begin(); it != cells.end(); ++it)
+        {
+            const Cell &cell = it->second;
+            glm::vec3 color = cell.color / cell.area;
+            float maxComponent = glm::max(color.r, glm::max(color.g, color.b));
+            glm::vec3 normal = glm::length(cell.normal) > 0.0f ? glm::normalize(cell.normal) : glm::vec3(0.0f);
+
+            Proxy proxy;
+            proxy.power = cell.power;
+            proxy.light.position = cell.position / cell.power + normal * settings.normalOffset;
+            proxy.light.color = color / maxComponent * glm::min(settings.maxIntensity, cell.power * settings.intensityScale);
+            proxy.light.radius = glm::clamp(settings.radiusScale * std::sqrt(cell.power), settings.minRadius, settings.maxRadius);
+            proxy.light.ambient = 0.05f;
+            proxy.light.linear = 0.09f;
+            proxy.light.quadratic = 0.032f;
+            proxies.push_back(proxy);
+        }
+
+        std::sort(proxies.begin(), proxies.end(), [](const Proxy &a, const Proxy &b) { return a.power > b.power; });
+        if (proxies.size() > settings.maxLights)
+            proxies.resize(settings.maxLights);
+        order.reserve(proxies.size());
+    }
+
+    // adds the budget most important proxies for this frame (power over squared distance to the eye), with their colour
+    // multiplied by scale; returns how many were added
+    unsigned int AddToFrame(ClusteredLights &lights, const glm::vec3 &eye, unsigned int budget, float scale)
+    {
+        order.clear();
+        for (unsigned int i = 0; i < proxies.size(); i++)
+        {
+            glm::vec3 d = proxies[i].light.position - eye;
+            order.push_back(Ranked{ proxies[i].power / (1.0f + glm::dot(d, d)), i });
+        }
+        unsigned int count = glm::min(budget, static_cast<unsigned int>(order.size()));
+        std::partial_sort(order.begin(), order.begin() + count, order.end(),
+                          [](const Ranked &a, const Ranked &b) { return a.importance > b.importance; });
+
+        unsigned int added = 0;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            ClusteredLights::Light light = proxies[order[i].index].light;
+            light.color *= scale;
+            if (lights.Add(light))
+                added++;
+        }
+        return added;
+    }
+
+private:
+    struct Image {
+        int width = 0, height = 0;
+        std::vector<unsigned char> pixels; // RGBA
+
+        // nearest texel with repeat wrapping, as the material's sampler does
+        glm::vec3 Sample(const glm::vec2 &uv) const
+        {
+            int x = static_cast<int>(std::floor((uv.x - std::floor(uv.x)) * width)) % width;
+            int y = static_cast<int>(std::floor((uv.y - std::floor(uv.y)) * height)) % height;
+            const unsigned char *p = &pixels[(y * width + x) * 4];
+            return glm::vec3(p[0], p[1], p[2]) / 255.0f;
+        }
+    };
+
+    struct Cell {
+        float power = 0.0f;
+        float area = 0.0f;
+        glm::vec3 position = glm::vec3(0.0f); // weighted by power
+        glm::vec3 color = glm::vec3(0.0f);    // weighted by area
+        glm::vec3 normal = glm::vec3(0.0f);
+    };
+
+    struct Ranked {
+        float importance;
+        unsigned int index;
+    };
+
+    std::vector<Ranked> order;
+
+    static long long cellKey(const glm::vec3 &p, float cellSize)
+    {
+        long long x = static_cast<long long>(std::floor(p.x / cellSize)) & 0x1FFFFF;
+        long long y = static_cast<long long>(std::floor(p.y / cellSize)) & 0x1FFFFF;
+        long long z = static_cast<long long>(std::floor(p.z / cellSize)) & 0x1FFFFF;
+        return (x << 42) | (y << 21) | z;
+    }
+
+    // reads the first mip level that fits in maxSize back from the GPU
+    static Image readBack(unsigned int texture, unsigned int maxSize)
+    {
+        Image image;
+        glBindTexture(GL_TEXTURE_2D, texture);
+        int level = 0;
+        GLint width = 0, height = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        while ((width > static_cast<GLint>(maxSize) || height > static_cast<GLint>(maxSize)) && (width > 1 || height > 1))
+        {
+            level++;
+            width = glm::max(1, width / 2);
+            height = glm::max(1, height / 2);
+        }
+        if (width > 0 && height > 0)
+        {
+            image.width = width;
+            image.height = height;
+            image.pixels.resize(width * height * 4);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glGetTexImage(GL_TEXTURE_2D, level, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return image;
+    }
+};
+#endif
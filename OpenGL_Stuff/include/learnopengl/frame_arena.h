@@ -0,0 +1,119 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Linear allocator for the scratch memory of one frame: Allocate moves a pointer forward, freeing does nothing and
+// Reset, at the end of the frame, takes everything back at once. When a frame needs more than the block it takes
+// another one from the heap; the next Reset replaces the blocks with a single one as large as all of them, so after the
+// first frames of a scene the arena stops touching the heap.
+// Whatever is allocated from it dies at Reset: containers using FrameAllocator must not outlive the frame.
+class FrameArena
+{
+public:
+    struct Stats {
+        size_t used = 0;         // bytes handed out this frame
+        size_t peak = 0;         // most bytes in one frame
+        size_t capacity = 0;     // bytes of all the blocks
+        unsigned int grows = 0;  // frames that needed another block
+    };
+
+    Stats stats;
+
+    void Init(size_t capacity)
+    {
+        blocks.clear();
+        addBlock(std::max<size_t>(capacity, 256));
+        stats = Stats();
+        stats.capacity = blocks.back().size;
+    }
+
+    // align must be a power of two
+    void *Allocate(size_t size, size_t align)
+    {
+        if (blocks.empty())
+            Init(64 * 1024);
+        Block &block = blocks.back();
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.memory.get());
+        size_t offset = ((base + block.used + align - 1) & ~(static_cast<uintptr_t>(align) - 1)) - base;
+        if (offset + size > block.size)
+        {
+            addBlock(std::max(block.size * 2, size + align));
+            return Allocate(size, align);
+        }
+        stats.used += offset + size - block.used;
+        block.used = offset + size;
+        return block.memory.get() + offset;
+    }
+
+    // end of the frame: everything allocated since the last Reset is released
+    void Reset()
+    {
+        stats.peak = std::max(stats.peak, stats.used);
+        stats.used = 0;
+        if (blocks.size() > 1)
+        {
+            size_t total = 0;
+            for (const Block &block : blocks)
+                total += block.size;
+            blocks.clear();
+            addBlock(total);
+            stats.grows++;
+        }
+        blocks.back().used = 0;
+        stats.capacity = blocks.back().size;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<unsigned char[]> memory;
+        size_t size;
+        size_t used;
+    };
+    std::vector<Block> blocks;
+
+    void addBlock(size_t size)
+    {
+        Block block;
+        block.memory.reset(new unsigned char[size]);
+        block.size = size;
+        block.used = 0;
+        blocks.push_back(std::move(block));
+        stats.capacity += size;
+    }
+};
+
+// STL allocator on a FrameArena, for the std containers of one frame: FrameVector<T> and FrameString
+template <typename T>
+class FrameAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit FrameAllocator(FrameArena &arena) : arena(&arena) {}
+    template <typename U>
+    FrameAllocator(const FrameAllocator<U> &other) : arena(other.Arena()) {}
+
+    T *allocate(size_t count) { return static_cast<T *>(arena->Allocate(count * sizeof(T), alignof(T))); }
+    void deallocate(T *, size_t) {}
+
+    FrameArena *Arena() const { return arena; }
+
+private:
+    FrameArena *arena;
+};
+
+template <typename T, typename U>
+bool operator==(const FrameAllocator<T> &a, const FrameAllocator<U> &b) { return a.Arena() == b.Arena(); }
+template <typename T, typename U>
+bool operator!=(const FrameAllocator<T> &a, const FrameAllocator<U> &b) { return a.Arena() != b.Arena(); }
+
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+typedef std::basic_string<char, std::char_traits<char>, FrameAllocator<char>> FrameString;
+#endif
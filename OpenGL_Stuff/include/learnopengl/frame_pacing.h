@@ -0,0 +1,185 @@
+#ifndef FRAME_PACING_H
+#define FRAME_PACING_H
+
+#include <GLFW/glfw3.h>
+
+#include <learnopengl/cpu_profiler.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Frame pacing: swap interval, frame cap and the delta time the simulation sees.
+// The swap mode is vsync (interval 1), adaptive (interval -1, a late frame tears instead of waiting a whole refresh;
+// falls back to vsync without WGL/GLX_EXT_swap_control_tear) or off. With a frame cap Frame waits for the next
+// deadline: it sleeps in 1 ms steps while the remaining time is longer than the worst sleep seen so far (the scheduler
+// oversleeps by up to a timer tick, 15.6 ms on a stock Windows) and spins for the rest. The deadlines advance by whole
+// frame periods, so one late frame does not shift the ones after it.
+// The simulation gets the raw frame time clamped to maxDelta (a hitch does not teleport anything) and averaged with
+// the previous frames, so the jitter of the OS and the driver does not show up as uneven movement.
+class FramePacer
+{
+public:
+    enum class SwapMode : int {
+        Vsync = 0,
+        Adaptive,
+        Off,
+        Count
+    };
+
+    struct Settings {
+        SwapMode swapMode = SwapMode::Vsync;
+        float maxFps = 0.0f;            // frame cap, 0 = no cap (vsync still limits to the refresh rate)
+        float smoothing = 0.25f;        // weight of the newest frame in the simulation delta, 1 = raw
+        float maxDelta = 0.1f;          // longest frame the simulation advances by, in seconds
+        unsigned int historySize = 240; // frames in the statistics
+    };
+
+    struct Stats {
+        float meanMs = 0.0f;           // raw frame time over the history
+        float stdDevMs = 0.0f;         // its standard deviation, the pacing consistency
+        float minMs = 0.0f;
+        float maxMs = 0.0f;
+        unsigned int hitches = 0;      // frames in the history longer than 1.5 times the mean
+        float sleepOvershootMs = 0.0f; // worst oversleep measured, the limiter spins for this long
+        float waitMs = 0.0f;           // time the limiter waited in the last frame
+    };
+
+    Stats stats;
+
+    void Init(const Settings &newSettings)
+    {
+        settings = newSettings;
+        settings.smoothing = std::min(1.0f, std::max(settings.smoothing, 0.01f));
+        settings.historySize = std::max(2u, settings.historySize);
+        history.assign(settings.historySize, 0.0f);
+        historyCount = 0;
+        historyNext = 0;
+        SetSwapMode(settings.swapMode);
+        lastTime = glfwGetTime();
+        deadline = lastTime;
+    }
+
+    // needs the context current
+    void SetSwapMode(SwapMode swapMode)
+    {
+        if (swapMode == SwapMode::Adaptive && !glfwExtensionSupported("WGL_EXT_swap_control_tear") &&
+            !glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+        {
+            std::cout << "ERROR::FRAME_PACING:: adaptive vsync is not supported, using vsync" << std::endl;
+            swapMode = SwapMode::Vsync;
+        }
+        settings.swapMode = swapMode;
+        glfwSwapInterval(swapMode == SwapMode::Vsync ? 1 : (swapMode == SwapMode::Adaptive ? -1 : 0));
+    }
+    SwapMode NextSwapMode()
+    {
+        SetSwapMode(static_cast<SwapMode>((static_cast<int>(settings.swapMode) + 1) % static_cast<int>(SwapMode::Count)));
+        return settings.swapMode;
+    }
+    void SetMaxFps(float maxFps) { settings.maxFps = std::max(maxFps, 0.0f); }
+    const Settings &GetSettings() const { return settings; }
+
+    // waits for the frame cap and returns the simulation delta in seconds; call once at the start of every frame
+    float Frame()
+    {
+        waitForDeadline();
+        double now = glfwGetTime();
+        rawDelta = static_cast<float>(now - lastTime);
+        lastTime = now;
+
+        float clamped = std::min(rawDelta, settings.maxDelta);
+        delta = delta == 0.0f ? clamped : delta + (clamped - delta) * settings.smoothing;
+        record(rawDelta);
+        return delta;
+    }
+
+    float Delta() const { return delta; }
+    float RawDelta() const { return rawDelta; }
+
+    static const char *SwapModeName(SwapMode swapMode)
+    {
+        static const char *names[] = { "vsync", "adaptive", "off" };
+        return names[static_cast<int>(swapMode)];
+    }
+
+    // "vsync", "adaptive" or "off"; Count when the name is unknown
+    static SwapMode SwapModeFromName(const std::string &name)
+    {
+        for (int i = 0; i < static_cast<int>(SwapMode::Count); i++)
+            if (name == SwapModeName(static_cast<SwapMode>(i)))
+                return static_cast<SwapMode>(i);
+        return SwapMode::Count;
+    }
+
+private:
+    Settings settings;
+    double lastTime = 0.0;
+    double deadline = 0.0;
+    double sleepOvershoot = 0.001; // worst measured sleep beyond the 1 ms asked for, decays slowly
+    float rawDelta = 0.0f;
+    float delta = 0.0f;
+    std::vector<float> history;    // raw frame times in seconds, a ring
+    unsigned int historyCount = 0;
+    unsigned int historyNext = 0;
+
+    void waitForDeadline()
+    {
+        stats.waitMs = 0.0f;
+        if (settings.maxFps <= 0.0f)
+            return;
+        CPU_ZONE("Frame cap wait");
+        double period = 1.0 / settings.maxFps;
+        double start = glfwGetTime();
+        deadline += period;
+        // more than a frame late (a load, a breakpoint): start over from now instead of rushing to catch up
+        if (deadline < start - period)
+            deadline = start;
+
+        double now = start;
+        while (deadline - now > sleepOvershoot + 0.001)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            double after = glfwGetTime();
+            double overshoot = (after - now) - 0.001;
+            sleepOvershoot = overshoot > sleepOvershoot ? overshoot : sleepOvershoot * 0.99 + overshoot * 0.01;
+            now = after;
+        }
+        while (now < deadline)
+            now = glfwGetTime();
+        stats.waitMs = static_cast<float>((now - start) * 1000.0);
+        stats.sleepOvershootMs = static_cast<float>(sleepOvershoot * 1000.0);
+    }
+
+    void record(float frameSeconds)
+    {
+        history[historyNext] = frameSeconds;
+        historyNext = (historyNext + 1) % settings.historySize;
+        historyCount = std::min(historyCount + 1, settings.historySize);
+
+        double sum = 0.0, sumSquares = 0.0;
+        float minimum = history[0], maximum = history[0];
+        for (unsigned int i = 0; i < historyCount; i++)
+        {
+            sum += history[i];
+            sumSquares += static_cast<double>(history[i]) * history[i];
+            minimum = std::min(minimum, history[i]);
+            maximum = std::max(maximum, history[i]);
+        }
+        double mean = sum / historyCount;
+        double variance = std::max(0.0, sumSquares / historyCount - mean * mean);
+        stats.meanMs = static_cast<float>(mean * 1000.0);
+        stats.stdDevMs = static_cast<float>(std::sqrt(variance) * 1000.0);
+        stats.minMs = minimum * 1000.0f;
+        stats.maxMs = maximum * 1000.0f;
+        stats.hitches = 0;
+        for (unsigned int i = 0; i < historyCount; i++)
+            if (history[i] > mean * 1.5)
+                stats.hitches++;
+    }
+};
+#endif
@@ -0,0 +1,69 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Every frame time of a run (benchmarks, headless runs) and its summary with percentiles.
+// The times are kept whole instead of in a ring like the frame pacer's, so the percentiles cover the whole run;
+// Reserve up front keeps Add from allocating during the run.
+class FrameStats
+{
+public:
+    struct Summary {
+        unsigned int frames = 0;
+        double seconds = 0.0; // sum of the frame times
+        float meanMs = 0.0f;
+        float stdDevMs = 0.0f;
+        float minMs = 0.0f;
+        float maxMs = 0.0f;
+        float p50Ms = 0.0f;
+        float p95Ms = 0.0f;
+        float p99Ms = 0.0f;
+        float fps = 0.0f;     // frames / seconds
+    };
+
+    void Reserve(unsigned int frames) { times.reserve(frames); }
+    void Clear() { times.clear(); }
+    void Add(float seconds) { times.push_back(seconds); }
+    unsigned int Count() const { return static_cast<unsigned int>(times.size()); }
+
+    Summary Summarize() const
+    {
+        Summary summary;
+        if (times.empty())
+            return summary;
+        std::vector<float> sorted(times);
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0, sumSquares = 0.0;
+        for (unsigned int i = 0; i < sorted.size(); i++)
+        {
+            sum += sorted[i];
+            sumSquares += static_cast<double>(sorted[i]) * sorted[i];
+        }
+        double mean = sum / sorted.size();
+        summary.frames = static_cast<unsigned int>(sorted.size());
+        summary.seconds = sum;
+        summary.meanMs = static_cast<float>(mean * 1000.0);
+        summary.stdDevMs = static_cast<float>(std::sqrt(std::max(0.0, sumSquares / sorted.size() - mean * mean)) * 1000.0);
+        summary.minMs = sorted.front() * 1000.0f;
+        summary.maxMs = sorted.back() * 1000.0f;
+        summary.p50Ms = percentile(sorted, 0.50f) * 1000.0f;
+        summary.p95Ms = percentile(sorted, 0.95f) * 1000.0f;
+        summary.p99Ms = percentile(sorted, 0.99f) * 1000.0f;
+        summary.fps = sum > 0.0 ? static_cast<float>(sorted.size() / sum) : 0.0f;
+        return summary;
+    }
+
+private:
+    std::vector<float> times;
+
+    // nearest rank
+    static float percentile(const std::vector<float> &sorted, float fraction)
+    {
+        unsigned int rank = static_cast<unsigned int>(std::ceil(fraction * sorted.size()));
+        return sorted[std::min(std::max(rank, 1u), static_cast<unsigned int>(sorted.size())) - 1];
+    }
+};
+#endif
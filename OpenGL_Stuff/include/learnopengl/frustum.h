@@ -0,0 +1,214 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define FRUSTUM_USE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// axis aligned bounding box, used for both model space and world space bounds
+struct BoundingBox {
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+
+    glm::vec3 Center() const { return (min + max) * 0.5f; }
+    glm::vec3 Extents() const { return (max - min) * 0.5f; }
+
+    // returns the world space box that encloses this box after applying the given transform (Arvo's method)
+    BoundingBox Transformed(const glm::mat4 &m) const
+    {
+        glm::vec3 center = glm::vec3(m * glm::vec4(Center(), 1.0f));
+        glm::vec3 extents = Extents();
+        glm::vec3 worldExtents;
+        for (int i = 0; i < 3; i++)
+            worldExtents[i] = std::fabs(m[0][i]) * extents.x + std::fabs(m[1][i]) * extents.y + std::fabs(m[2][i]) * extents.z;
+        BoundingBox result;
+        result.min = center - worldExtents;
+        result.max = center + worldExtents;
+        return result;
+    }
+};
+
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+
+    // the radius is scaled by the largest axis scale so the sphere stays conservative under non uniform scaling
+    BoundingSphere Transformed(const glm::mat4 &m) const
+    {
+        BoundingSphere result;
+        result.center = glm::vec3(m * glm::vec4(center, 1.0f));
+        float sx = glm::dot(glm::vec3(m[0]), glm::vec3(m[0]));
+        float sy = glm::dot(glm::vec3(m[1]), glm::vec3(m[1]));
+        float sz = glm::dot(glm::vec3(m[2]), glm::vec3(m[2]));
+        result.radius = radius * std::sqrt(glm::max(sx, glm::max(sy, sz)));
+        return result;
+    }
+};
+
+// per frame culling counters
+struct CullStats {
+    unsigned int tested = 0;
+    unsigned int culled = 0;   // outside the view frustum
+    unsigned int occluded = 0; // inside the frustum but hidden behind occluders
+    unsigned int portalCulled = 0; // in a cell that cannot be seen through the portals
+    unsigned int pvsCulled = 0;    // not in the baked potentially visible set of the camera's cell
+
+    void Reset() { tested = 0; culled = 0; occluded = 0; portalCulled = 0; pvsCulled = 0; }
+    unsigned int Drawn() const { return tested - culled - occluded - portalCulled - pvsCulled; }
+};
+
+// view frustum built from a projection * view matrix. The six planes are stored as structure of arrays
+// (padded to eight by repeating the far plane) so one SSE register tests a bound against four planes at once.
+class Frustum
+{
+public:
+    Frustum() : planeX(), planeY(), planeZ(), planeW(), absX(), absY(), absZ() {}
+    explicit Frustum(const glm::mat4 &viewProjection) { Update(viewProjection); }
+
+    // extracts and normalizes the planes (Gribb/Hartmann), normals point into the frustum
+    void Update(const glm::mat4 &viewProjection)
+    {
+        const glm::mat4 &m = viewProjection;
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        glm::vec4 planes[6] = {
+            row3 + row0, // left
+            row3 - row0, // right
+            row3 + row1, // bottom
+            row3 - row1, // top
+            row3 + row2, // near
+            row3 - row2  // far
+        };
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec4 p = planes[i < 6 ? i : 5];
+            float invLength = 1.0f / glm::length(glm::vec3(p));
+            p *= invLength;
+            planeX[i] = p.x;
+            planeY[i] = p.y;
+            planeZ[i] = p.z;
+            planeW[i] = p.w;
+            absX[i] = std::fabs(p.x);
+            absY[i] = std::fabs(p.y);
+            absZ[i] = std::fabs(p.z);
+        }
+    }
+
+    glm::vec4 Plane(int i) const { return glm::vec4(planeX[i], planeY[i], planeZ[i], planeW[i]); }
+
+    // true if the sphere intersects or is inside the frustum
+    bool IsSphereVisible(const glm::vec3 &center, float radius) const
+    {
+#ifdef FRUSTUM_USE_SSE
+        __m128 cx = _mm_set1_ps(center.x);
+        __m128 cy = _mm_set1_ps(center.y);
+        __m128 cz = _mm_set1_ps(center.z);
+        __m128 negRadius = _mm_set1_ps(-radius);
+        int outside = 0;
+        for (int i = 0; i < 8; i += 4)
+        {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(planeX + i), cx), _mm_mul_ps(_mm_load_ps(planeY + i), cy)),
+                                  _mm_add_ps(_mm_mul_ps(_mm_load_ps(planeZ + i), cz), _mm_load_ps(planeW + i)));
+            outside |= _mm_movemask_ps(_mm_cmplt_ps(d, negRadius));
+        }
+        return outside == 0;
+#else
+        for (int i = 0; i < 6; i++)
+        {
+            if (planeX[i] * center.x + planeY[i] * center.y + planeZ[i] * center.z + planeW[i] < -radius)
+                return false;
+        }
+        return true;
+#endif
+    }
+
+    bool IsSphereVisible(const BoundingSphere &sphere) const
+    {
+        return IsSphereVisible(sphere.center, sphere.radius);
+    }
+
+    // true if the box intersects or is inside the frustum (center/extents form of the plane test)
+    bool IsBoxVisible(const BoundingBox &box) const
+    {
+        glm::vec3 c = box.Center();
+        glm::vec3 e = box.Extents();
+#ifdef FRUSTUM_USE_SSE
+        __m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+        __m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+        __m128 zero = _mm_setzero_ps();
+        int outside = 0;
+        for (int i = 0; i < 8; i += 4)
+        {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(planeX + i), cx), _mm_mul_ps(_mm_load_ps(planeY + i), cy)),
+                                  _mm_add_ps(_mm_mul_ps(_mm_load_ps(planeZ + i), cz), _mm_load_ps(planeW + i)));
+            __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(absX + i), ex), _mm_mul_ps(_mm_load_ps(absY + i), ey)),
+                                  _mm_mul_ps(_mm_load_ps(absZ + i), ez));
+            outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(d, r), zero));
+        }
+        return outside == 0;
+#else
+        for (int i = 0; i < 6; i++)
+        {
+            float d = planeX[i] * c.x + planeY[i] * c.y + planeZ[i] * c.z + planeW[i];
+            float r = absX[i] * e.x + absY[i] * e.y + absZ[i] * e.z;
+            if (d + r < 0.0f)
+                return false;
+        }
+        return true;
+#endif
+    }
+
+    // culls many spheres given as separate x/y/z/radius arrays, four spheres per iteration.
+    // visible[i] is set to 1 or 0 and the number of visible spheres is returned.
+    unsigned int CullSpheres(const float *x, const float *y, const float *z, const float *radius, unsigned int count, unsigned char *visible) const
+    {
+        unsigned int visibleCount = 0;
+        unsigned int i = 0;
+#ifdef FRUSTUM_USE_SSE
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 cx = _mm_loadu_ps(x + i);
+            __m128 cy = _mm_loadu_ps(y + i);
+            __m128 cz = _mm_loadu_ps(z + i);
+            __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+            __m128 outside = _mm_setzero_ps();
+            for (int p = 0; p < 6; p++)
+            {
+                __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planeX[p]), cx), _mm_mul_ps(_mm_set1_ps(planeY[p]), cy)),
+                                      _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planeZ[p]), cz), _mm_set1_ps(planeW[p])));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(d, negRadius));
+            }
+            int mask = _mm_movemask_ps(outside);
+            for (int k = 0; k < 4; k++)
+            {
+                visible[i + k] = (mask & (1 << k)) ? 0 : 1;
+                visibleCount += visible[i + k];
+            }
+        }
+#endif
+        for (; i < count; i++)
+        {
+            visible[i] = IsSphereVisible(glm::vec3(x[i], y[i], z[i]), radius[i]) ? 1 : 0;
+            visibleCount += visible[i];
+        }
+        return visibleCount;
+    }
+
+private:
+    alignas(16) float planeX[8];
+    alignas(16) float planeY[8];
+    alignas(16) float planeZ[8];
+    alignas(16) float planeW[8];
+    alignas(16) float absX[8];
+    alignas(16) float absY[8];
+    alignas(16) float absZ[8];
+};
+#endif
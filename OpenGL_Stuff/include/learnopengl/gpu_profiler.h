@@ -0,0 +1,388 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/cpu_profiler.h>
+#include <learnopengl/draw_stats.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// GPU time of named scopes (passes and draw groups) inside the frame.
+// Begin and End write GL_TIMESTAMP queries, which nest and do not conflict with the GL_TIME_ELAPSED queries the
+// renderers keep for their own budgets. Every frame uses its own set of queries out of FRAMES, and a frame is read
+// FRAMES - 1 frames later, when the GPU has long finished it; a frame that is still not available is dropped instead of
+// waited for. The results feed a HUD (one bar per scope along the frame), an optional CSV with one row per scope and
+// frame, and an optional Chrome trace (chrome://tracing or ui.perfetto.dev) with one complete event per scope.
+// While the CPU profiler records, every scope is also a CPU zone with the same name (the time to submit the pass).
+// Scope names are kept as pointers, so they have to outlive the profiler (string literals).
+class GpuProfiler
+{
+public:
+    static const unsigned int FRAMES = 3;
+
+    struct Settings {
+        bool enabled = true;
+        unsigned int maxScopes = 32;  // per frame, the scopes after it are not timed
+        float smoothing = 0.1f;       // weight of the newest frame in the averages shown by the HUD
+        float hudBudgetMs = 16.67f;   // frame time the width of the HUD stands for
+    };
+
+    struct Scope {
+        const char *name = nullptr;
+        unsigned int depth = 0;   // 0 = top level, 1 = inside another scope...
+        float startMs = 0.0f;     // from the start of the frame
+        float gpuMs = 0.0f;
+        float averageMs = 0.0f;
+    };
+
+    struct Stats {
+        float frameGpuMs = 0.0f;       // from BeginFrame to EndFrame of the last frame read
+        float passGpuMs = 0.0f;        // sum of its top level scopes: the GPU busy time without the gaps between passes
+        unsigned int framesRead = 0;
+        unsigned int framesDropped = 0; // not available after FRAMES - 1 frames
+        unsigned int scopesSkipped = 0; // over maxScopes in the last frame recorded
+    };
+
+    Stats stats;
+
+    void Init(const Settings &newSettings)
+    {
+        settings = newSettings;
+        settings.maxScopes = std::max(1u, settings.maxScopes);
+        for (unsigned int i = 0; i < FRAMES; i++)
+        {
+            FrameQueries &frame = frames[i];
+            if (!frame.queries.empty())
+                glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+            // two per scope plus the start and the end of the frame
+            frame.queries.assign(settings.maxScopes * 2 + 2, 0);
+            glGenQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+            frame.scopes.clear();
+            frame.scopes.reserve(settings.maxScopes);
+            frame.pending = false;
+        }
+        results.reserve(settings.maxScopes);
+        averages.reserve(settings.maxScopes);
+        openScopes.reserve(settings.maxScopes);
+        timestamps.reserve(settings.maxScopes * 2 + 2);
+        if (!hudShader)
+        {
+            hudShader = new Shader("shaders/profiler_hud.vs", "shaders/profiler_hud.fs");
+            glGenVertexArrays(1, &emptyVAO);
+        }
+    }
+
+    void SetEnabled(bool enabled) { settings.enabled = enabled; }
+    bool IsEnabled() const { return settings.enabled; }
+    const Settings &GetSettings() const { return settings; }
+
+    // scopes of the last frame read, in the order they began
+    const std::vector<Scope> &Results() const { return results; }
+
+    // top level scopes with their averaged time, "name 1.23 | name 0.45 | ..." (for the window title)
+    std::string Summary() const
+    {
+        std::string summary;
+        AppendSummary(summary);
+        return summary;
+    }
+
+    // the same appended to any string type (a FrameString, so the title does not touch the heap)
+    template <typename String>
+    void AppendSummary(String &summary) const
+    {
+        char buffer[64];
+        bool first = true;
+        for (unsigned int i = 0; i < results.size(); i++)
+        {
+            if (results[i].depth != 0)
+                continue;
+            std::snprintf(buffer, sizeof(buffer), "%s%s %.2f", first ? "" : " | ", results[i].name, results[i].averageMs);
+            summary += buffer;
+            first = false;
+        }
+    }
+
+    // starts the frame: reads the frame recorded FRAMES - 1 frames ago into Results and reuses its queries
+    void BeginFrame()
+    {
+        recording = settings.enabled;
+        FrameQueries &frame = frames[frameIndex % FRAMES];
+        if (frame.pending)
+            read(frame);
+        frame.pending = false;
+        frame.scopes.clear();
+        openScopes.clear();
+        if (recording)
+            glQueryCounter(frame.queries[0], GL_TIMESTAMP);
+    }
+
+    void EndFrame()
+    {
+        if (recording)
+        {
+            FrameQueries &frame = frames[frameIndex % FRAMES];
+            while (!openScopes.empty())
+                End();
+            glQueryCounter(frame.queries[1], GL_TIMESTAMP);
+            frame.number = frameIndex;
+            frame.pending = true;
+        }
+        recording = false;
+        frameIndex++;
+    }
+
+    // name must outlive the profiler
+    void Begin(const char *name)
+    {
+        if (CpuProfiler::Recording())
+            CpuProfiler::Begin(name);
+        if (!recording)
+            return;
+        FrameQueries &frame = frames[frameIndex % FRAMES];
+        if (frame.scopes.size() >= settings.maxScopes)
+        {
+            // still pushed so the matching End does not close an outer scope
+            openScopes.push_back(static_cast<unsigned int>(NOT_TIMED));
+            stats.scopesSkipped++;
+            return;
+        }
+        unsigned int index = static_cast<unsigned int>(frame.scopes.size());
+        frame.scopes.push_back(ScopeRecord{ name, static_cast<unsigned int>(openScopes.size()) });
+        openScopes.push_back(index);
+        glQueryCounter(frame.queries[2 + index * 2], GL_TIMESTAMP);
+    }
+
+    void End()
+    {
+        if (CpuProfiler::Recording())
+            CpuProfiler::End();
+        if (!recording || openScopes.empty())
+            return;
+        unsigned int index = openScopes.back();
+        openScopes.pop_back();
+        if (index != NOT_TIMED)
+            glQueryCounter(frames[frameIndex % FRAMES].queries[3 + index * 2], GL_TIMESTAMP);
+    }
+
+    // CSV with the columns frame, scope, depth, start_ms, gpu_ms; false when the file cannot be created
+    bool OpenCsv(const std::string &path)
+    {
+        if (csv)
+            std::fclose(csv);
+        csv = std::fopen(path.c_str(), "w");
+        if (!csv)
+        {
+            std::cout << "ERROR::GPU_PROFILER:: cannot create " << path << std::endl;
+            return false;
+        }
+        std::fprintf(csv, "frame,scope,depth,start_ms,gpu_ms\n");
+        return true;
+    }
+
+    // Chrome trace event file, closed (and made valid JSON) by Close
+    bool OpenTrace(const std::string &path)
+    {
+        if (trace)
+            closeTrace();
+        trace = std::fopen(path.c_str(), "w");
+        if (!trace)
+        {
+            std::cout << "ERROR::GPU_PROFILER:: cannot create " << path << std::endl;
+            return false;
+        }
+        std::fprintf(trace, "{\"traceEvents\":[\n"
+                            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"tid\":1,\"args\":{\"name\":\"GPU\"}}");
+        traceOrigin = 0;
+        return true;
+    }
+
+    void Close()
+    {
+        if (csv)
+            std::fclose(csv);
+        csv = nullptr;
+        if (trace)
+            closeTrace();
+    }
+
+    // bars along the frame at the top left of the window (bound framebuffer), top level scopes on the first row and
+    // the nested ones below; the width of the HUD is hudBudgetMs and the marks are every 4 ms
+    void DrawHud(int screenWidth, int screenHeight)
+    {
+        if (results.empty())
+            return;
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        GLboolean blend = glIsEnabled(GL_BLEND);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glBindVertexArray(emptyVAO);
+        hudShader->use();
+        hudShader->setVec2("screenSize", glm::vec2(screenWidth, screenHeight));
+
+        const float x = 10.0f, y = 10.0f, width = 400.0f, rowHeight = 12.0f;
+        unsigned int rows = 1;
+        for (unsigned int i = 0; i < results.size(); i++)
+            rows = std::max(rows, results[i].depth + 1);
+        float pixelsPerMs = width / settings.hudBudgetMs;
+        drawRect(x - 2.0f, y - 2.0f, width + 4.0f, rows * rowHeight + 4.0f, glm::vec4(0.0f, 0.0f, 0.0f, 0.6f));
+        for (float ms = 4.0f; ms < settings.hudBudgetMs; ms += 4.0f)
+            drawRect(x + ms * pixelsPerMs, y, 1.0f, rows * rowHeight, glm::vec4(1.0f, 1.0f, 1.0f, 0.25f));
+        for (unsigned int i = 0; i < results.size(); i++)
+        {
+            const Scope &scope = results[i];
+            float start = std::min(scope.startMs * pixelsPerMs, width);
+            float length = std::max(1.0f, std::min(scope.gpuMs * pixelsPerMs, width - start));
+            drawRect(x + start, y + scope.depth * rowHeight + 1.0f, length, rowHeight - 2.0f, glm::vec4(Color(i), 0.9f));
+        }
+        // whole frame, over the budget in red
+        float frameLength = std::min(stats.frameGpuMs * pixelsPerMs, width);
+        drawRect(x, y + rows * rowHeight + 3.0f, frameLength, 3.0f,
+                 stats.frameGpuMs > settings.hudBudgetMs ? glm::vec4(1.0f, 0.2f, 0.2f, 1.0f) : glm::vec4(1.0f));
+
+        glBindVertexArray(0);
+        if (depthTest)
+            glEnable(GL_DEPTH_TEST);
+        if (!blend)
+            glDisable(GL_BLEND);
+    }
+
+    // color of the i-th scope in the HUD, so a legend can use the same ones
+    static glm::vec3 Color(unsigned int index)
+    {
+        static const glm::vec3 palette[] = {
+            glm::vec3(0.90f, 0.30f, 0.25f), glm::vec3(0.30f, 0.70f, 0.95f), glm::vec3(0.95f, 0.75f, 0.20f),
+            glm::vec3(0.45f, 0.85f, 0.40f), glm::vec3(0.75f, 0.45f, 0.95f), glm::vec3(0.95f, 0.55f, 0.20f),
+            glm::vec3(0.30f, 0.90f, 0.80f), glm::vec3(0.95f, 0.45f, 0.70f)
+        };
+        return palette[index % (sizeof(palette) / sizeof(palette[0]))];
+    }
+
+private:
+    static const unsigned int NOT_TIMED = ~0u;
+
+    struct ScopeRecord {
+        const char *name;
+        unsigned int depth;
+    };
+
+    struct FrameQueries {
+        std::vector<unsigned int> queries; // frame start, frame end, then begin and end of every scope
+        std::vector<ScopeRecord> scopes;
+        unsigned int number = 0;
+        bool pending = false;
+    };
+
+    struct Average {
+        const char *name;
+        unsigned int depth;
+        float ms;
+    };
+
+    Settings settings;
+    FrameQueries frames[FRAMES];
+    unsigned int frameIndex = 0;
+    bool recording = false;
+    std::vector<unsigned int> openScopes;
+    std::vector<Scope> results;
+    std::vector<Average> averages;
+    std::vector<GLuint64> timestamps;
+    FILE *csv = nullptr;
+    FILE *trace = nullptr;
+    GLuint64 traceOrigin = 0;
+    Shader *hudShader = nullptr;
+    unsigned int emptyVAO = 0;
+
+    void read(const FrameQueries &frame)
+    {
+        unsigned int used = 2 + static_cast<unsigned int>(frame.scopes.size()) * 2;
+        GLint available = 0;
+        glGetQueryObjectiv(frame.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            stats.framesDropped++;
+            return;
+        }
+        timestamps.resize(used);
+        for (unsigned int i = 0; i < used; i++)
+            glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+
+        GLuint64 frameStart = timestamps[0];
+        stats.frameGpuMs = (timestamps[1] - frameStart) / 1000000.0f;
+        stats.framesRead++;
+        stats.passGpuMs = 0.0f;
+        results.clear();
+        for (unsigned int i = 0; i < frame.scopes.size(); i++)
+        {
+            Scope scope;
+            scope.name = frame.scopes[i].name;
+            scope.depth = frame.scopes[i].depth;
+            scope.startMs = (timestamps[2 + i * 2] - frameStart) / 1000000.0f;
+            scope.gpuMs = (timestamps[3 + i * 2] - timestamps[2 + i * 2]) / 1000000.0f;
+            scope.averageMs = average(scope);
+            if (scope.depth == 0)
+                stats.passGpuMs += scope.gpuMs;
+            results.push_back(scope);
+        }
+        write(frame.number, frameStart);
+    }
+
+    // running average of the scope with the same name and depth, started at its first time
+    float average(const Scope &scope)
+    {
+        for (unsigned int i = 0; i < averages.size(); i++)
+        {
+            Average &entry = averages[i];
+            if (entry.depth == scope.depth && (entry.name == scope.name || std::strcmp(entry.name, scope.name) == 0))
+            {
+                entry.ms += (scope.gpuMs - entry.ms) * settings.smoothing;
+                return entry.ms;
+            }
+        }
+        averages.push_back(Average{ scope.name, scope.depth, scope.gpuMs });
+        return scope.gpuMs;
+    }
+
+    void write(unsigned int number, GLuint64 frameStart)
+    {
+        if (csv)
+            for (unsigned int i = 0; i < results.size(); i++)
+                std::fprintf(csv, "%u,%s,%u,%.4f,%.4f\n", number, results[i].name, results[i].depth, results[i].startMs, results[i].gpuMs);
+        if (trace)
+        {
+            if (traceOrigin == 0)
+                traceOrigin = frameStart;
+            double frameUs = (frameStart - traceOrigin) / 1000.0;
+            std::fprintf(trace, ",\n{\"name\":\"Frame %u\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":2,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                         number, frameUs, stats.frameGpuMs * 1000.0);
+            for (unsigned int i = 0; i < results.size(); i++)
+                std::fprintf(trace, ",\n{\"name\":\"%s\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":2,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                             results[i].name, frameUs + results[i].startMs * 1000.0, results[i].gpuMs * 1000.0);
+        }
+    }
+
+    void closeTrace()
+    {
+        std::fprintf(trace, "\n]}\n");
+        std::fclose(trace);
+        trace = nullptr;
+    }
+
+    void drawRect(float x, float y, float width, float height, const glm::vec4 &color)
+    {
+        hudShader->setVec4("rect", glm::vec4(x, y, width, height));
+        hudShader->setVec4("color", color);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        DrawStats::Count(2);
+    }
+};
+#endif
@@ -0,0 +1,382 @@
+#ifndef HDR_H
+#define HDR_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/draw_stats.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// HDR scene target, bloom and tone mapping.
+// The frame is rendered into a half float target (Begin) so lights and emissive surfaces can go above 1. End builds the
+// bloom from a mip chain that starts at half resolution: each level is a 13 tap downsample of the previous one (the first
+// one with a Karis average so single bright pixels do not flicker), then the levels are added back up with a 3x3 tent
+// filter. The composite mixes the bloom into the scene, applies the exposure and the tone mapper and writes the default
+// framebuffer. The bloom passes are timed with GPU queries (read one frame late); when they go over the budget, scaled
+// from 1280x720 by the pixel count, the chain starts one level lower (quarter resolution) until there is room again.
+// With a render scale below 1 the scene only fills the lower left corner of its target (the viewport set by Begin); the
+// first downsample and the composite read that corner. The bilinear upscaler stretches it to the window in the
+// composite; the edge adaptive one tone maps it at the render size into an 8 bit target and then upscales that with a
+// Lanczos kernel oriented along the edges plus contrast adaptive sharpening (upscale.fs), so a 67-77% render scale still
+// looks close to native. At full scale the composite writes the window directly either way.
+class HdrRenderer
+{
+public:
+    enum class ToneMapper : int {
+        Clamp = 0, // no tone mapping, values above 1 are clipped (the old look)
+        Reinhard,
+        Aces,      // Narkowicz's fit of the ACES filmic curve
+        Count
+    };
+
+    enum class Upscaler : int {
+        Bilinear = 0,  // stretched by the composite
+        EdgeAdaptive,  // separate pass after tone mapping, with sharpening
+        Count
+    };
+
+    struct Settings {
+        ToneMapper toneMapper = ToneMapper::Aces;
+        float exposure = 1.0f;
+        float bloomStrength = 0.2f;      // how much of the bloom is mixed into the scene
+        float bloomFilterRadius = 1.0f;  // radius of the upsample tent, in texels of the level being read
+        unsigned int bloomLevels = 6;    // levels of the chain, the first one at half resolution
+        float bloomBudgetMs = 0.5f;      // GPU time of the bloom at 1280x720
+        Upscaler upscaler = Upscaler::EdgeAdaptive;
+        float sharpness = 0.5f;          // of the edge adaptive upscaler, 0 to 1
+    };
+
+    struct Stats {
+        float bloomGpuMs = 0.0f;     // last measured GPU time of the downsample and upsample passes
+        float budgetMs = 0.0f;       // bloomBudgetMs scaled to the current resolution
+        unsigned int firstLevel = 0; // 0 = the chain starts at half resolution, 1 = at quarter resolution
+    };
+
+    Stats stats;
+
+    // creates the targets for a width x height screen; can be called again to change the settings
+    void Init(int newWidth, int newHeight, const Settings &newSettings)
+    {
+        settings = newSettings;
+        settings.bloomLevels = std::max(1u, settings.bloomLevels);
+        if (!downsampleShader)
+        {
+            downsampleShader = new Shader("shaders/post.vs", "shaders/bloom_downsample.fs");
+            upsampleShader = new Shader("shaders/post.vs", "shaders/bloom_upsample.fs");
+            compositeShader = new Shader("shaders/post.vs", "shaders/tonemap.fs");
+            upscaleShader = new Shader("shaders/post.vs", "shaders/upscale.fs");
+            glGenVertexArrays(1, &emptyVAO);
+            glGenQueries(2, timerQueries);
+            glGenFramebuffers(1, &sceneFBO);
+            glGenFramebuffers(1, &bloomFBO);
+            glGenFramebuffers(1, &ldrFBO);
+        }
+        Resize(newWidth, newHeight);
+    }
+
+    // recreates the targets when the window changes size
+    void Resize(int newWidth, int newHeight)
+    {
+        if (sceneFBO == 0)
+            return; // the window can report its size before Init
+        width = std::max(1, newWidth);
+        height = std::max(1, newHeight);
+        SetRenderScale(renderScale);
+        stats.budgetMs = settings.bloomBudgetMs * (static_cast<float>(width) * height) / (1280.0f * 720.0f);
+
+        if (sceneTexture)
+            glDeleteTextures(1, &sceneTexture);
+        if (depthBuffer)
+            glDeleteRenderbuffers(1, &depthBuffer);
+        glGenTextures(1, &sceneTexture);
+        glBindTexture(GL_TEXTURE_2D, sceneTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+        setSampling(GL_LINEAR);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        GLint previous;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::HDR:: scene framebuffer is not complete" << std::endl;
+
+        // tone mapped image at the render size, the input of the edge adaptive upscaler
+        if (ldrTexture)
+            glDeleteTextures(1, &ldrTexture);
+        glGenTextures(1, &ldrTexture);
+        glBindTexture(GL_TEXTURE_2D, ldrTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        setSampling(GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, ldrFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ldrTexture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::HDR:: upscale framebuffer is not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, previous);
+
+        // bloom chain: half resolution, then halved per level (the deeper levels stop at 1x1)
+        for (unsigned int i = 0; i < bloomMips.size(); i++)
+            glDeleteTextures(1, &bloomMips[i].texture);
+        bloomMips.clear();
+        int mipWidth = width, mipHeight = height;
+        for (unsigned int i = 0; i < settings.bloomLevels + 1; i++)
+        {
+            mipWidth = std::max(1, mipWidth / 2);
+            mipHeight = std::max(1, mipHeight / 2);
+            BloomMip mip;
+            mip.width = mipWidth;
+            mip.height = mipHeight;
+            glGenTextures(1, &mip.texture);
+            glBindTexture(GL_TEXTURE_2D, mip.texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, mipWidth, mipHeight, 0, GL_RGB, GL_FLOAT, NULL);
+            setSampling(GL_LINEAR);
+            bloomMips.push_back(mip);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    const Settings &GetSettings() const { return settings; }
+    // size of the scene target and of the output
+    int Width() const { return width; }
+    int Height() const { return height; }
+    // pixels the scene is shaded at, width and height times the render scale
+    int RenderWidth() const { return renderWidth; }
+    int RenderHeight() const { return renderHeight; }
+
+    // fraction of the target (per axis) the next frames are rendered at, for dynamic resolution
+    void SetRenderScale(float scale)
+    {
+        renderScale = std::min(1.0f, std::max(scale, 0.1f));
+        renderWidth = std::max(1, static_cast<int>(width * renderScale + 0.5f));
+        renderHeight = std::max(1, static_cast<int>(height * renderScale + 0.5f));
+    }
+    float RenderScale() const { return renderScale; }
+    // framebuffer End draws the final image into, 0 (the window) unless it renders offscreen
+    void SetOutputFramebuffer(unsigned int framebuffer) { outputFBO = framebuffer; }
+    unsigned int OutputFramebuffer() const { return outputFBO; }
+    void SetExposure(float exposure) { settings.exposure = exposure; }
+    void SetToneMapper(ToneMapper toneMapper) { settings.toneMapper = toneMapper; }
+    ToneMapper NextToneMapper()
+    {
+        settings.toneMapper = static_cast<ToneMapper>((static_cast<int>(settings.toneMapper) + 1) % static_cast<int>(ToneMapper::Count));
+        return settings.toneMapper;
+    }
+
+    void SetUpscaler(Upscaler upscaler) { settings.upscaler = upscaler; }
+    Upscaler NextUpscaler()
+    {
+        settings.upscaler = static_cast<Upscaler>((static_cast<int>(settings.upscaler) + 1) % static_cast<int>(Upscaler::Count));
+        return settings.upscaler;
+    }
+
+    static const char *ToneMapperName(ToneMapper toneMapper)
+    {
+        static const char *names[] = { "clamp", "reinhard", "aces" };
+        return names[static_cast<int>(toneMapper)];
+    }
+
+    // "clamp", "reinhard" or "aces"; Count when the name is unknown
+    static ToneMapper ToneMapperFromName(const std::string &name)
+    {
+        for (int i = 0; i < static_cast<int>(ToneMapper::Count); i++)
+            if (name == ToneMapperName(static_cast<ToneMapper>(i)))
+                return static_cast<ToneMapper>(i);
+        return ToneMapper::Count;
+    }
+
+    static const char *UpscalerName(Upscaler upscaler)
+    {
+        static const char *names[] = { "bilinear", "edge" };
+        return names[static_cast<int>(upscaler)];
+    }
+
+    // "bilinear" or "edge"; Count when the name is unknown
+    static Upscaler UpscalerFromName(const std::string &name)
+    {
+        for (int i = 0; i < static_cast<int>(Upscaler::Count); i++)
+            if (name == UpscalerName(static_cast<Upscaler>(i)))
+                return static_cast<Upscaler>(i);
+        return Upscaler::Count;
+    }
+
+    // the frame is drawn into the HDR target from here until End
+    void Begin()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+        glViewport(0, 0, renderWidth, renderHeight);
+    }
+
+    // bloom and tone mapping into the output framebuffer, which stays bound afterwards (for overlays)
+    void End()
+    {
+        readTimer();
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        GLboolean blend = glIsEnabled(GL_BLEND);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        glBindVertexArray(emptyVAO);
+
+        glBeginQuery(GL_TIME_ELAPSED, timerQueries[queryFrame % 2]);
+        unsigned int first = stats.firstLevel;
+        unsigned int last = std::min(first + settings.bloomLevels, static_cast<unsigned int>(bloomMips.size())) - 1;
+        glBindFramebuffer(GL_FRAMEBUFFER, bloomFBO);
+
+        // downsample: scene -> first level -> ... -> last level
+        downsampleShader->use();
+        downsampleShader->setInt("source", 0);
+        glActiveTexture(GL_TEXTURE0);
+        for (unsigned int i = first; i <= last; i++)
+        {
+            const BloomMip &mip = bloomMips[i];
+            glBindTexture(GL_TEXTURE_2D, i == first ? sceneTexture : bloomMips[i - 1].texture);
+            // the taps are spaced by source texels at a 2:1 reduction; half a destination texel covers any ratio
+            downsampleShader->setVec2("texelSize", glm::vec2(0.5f / mip.width, 0.5f / mip.height));
+            downsampleShader->setBool("karisAverage", i == first);
+            // the scene is read from its rendered corner, the levels of the chain are full
+            if (i == first)
+                setRegion(*downsampleShader, "sourceRegion", renderWidth, renderHeight);
+            else
+                downsampleShader->setVec4("sourceRegion", glm::vec4(1.0f));
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mip.texture, 0);
+            glViewport(0, 0, mip.width, mip.height);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            DrawStats::Count(1);
+        }
+
+        // upsample: each level is tent filtered and added onto the next larger one
+        upsampleShader->use();
+        upsampleShader->setInt("source", 0);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glBlendEquation(GL_FUNC_ADD);
+        for (unsigned int i = last; i > first; i--)
+        {
+            const BloomMip &source = bloomMips[i];
+            const BloomMip &target = bloomMips[i - 1];
+            glBindTexture(GL_TEXTURE_2D, source.texture);
+            upsampleShader->setVec2("filterRadius", glm::vec2(settings.bloomFilterRadius / source.width,
+                                                              settings.bloomFilterRadius / source.height));
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0);
+            glViewport(0, 0, target.width, target.height);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            DrawStats::Count(1);
+        }
+        glDisable(GL_BLEND);
+        glEndQuery(GL_TIME_ELAPSED);
+        queryFrame++;
+
+        // composite: scene + bloom, exposure and tone mapping; for the edge adaptive upscaler it stays at the render size
+        // (the scene is read 1:1 and the bloom level covers the whole rendered image either way)
+        bool upscale = settings.upscaler == Upscaler::EdgeAdaptive && (renderWidth != width || renderHeight != height);
+        glBindFramebuffer(GL_FRAMEBUFFER, upscale ? ldrFBO : outputFBO);
+        if (upscale)
+            glViewport(0, 0, renderWidth, renderHeight);
+        else
+            glViewport(0, 0, width, height);
+        compositeShader->use();
+        compositeShader->setInt("scene", 0);
+        compositeShader->setInt("bloom", 1);
+        compositeShader->setFloat("exposure", settings.exposure);
+        compositeShader->setFloat("bloomStrength", settings.bloomStrength);
+        // every level of the chain is added into the first one, a flat image would come out (levels) times brighter
+        compositeShader->setFloat("bloomNormalization", 1.0f / (last - first + 1));
+        compositeShader->setInt("toneMapper", static_cast<int>(settings.toneMapper));
+        setRegion(*compositeShader, "sceneRegion", renderWidth, renderHeight);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, sceneTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, bloomMips[first].texture);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        DrawStats::Count(1);
+        glActiveTexture(GL_TEXTURE0);
+
+        if (upscale)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, outputFBO);
+            glViewport(0, 0, width, height);
+            upscaleShader->use();
+            upscaleShader->setInt("source", 0);
+            upscaleShader->setFloat("sharpness", settings.sharpness);
+            setRegion(*upscaleShader, "sourceRegion", renderWidth, renderHeight);
+            glBindTexture(GL_TEXTURE_2D, ldrTexture);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            DrawStats::Count(1);
+        }
+
+        glBindVertexArray(0);
+        if (depthTest)
+            glEnable(GL_DEPTH_TEST);
+        if (blend)
+            glEnable(GL_BLEND);
+    }
+
+private:
+    struct BloomMip {
+        int width = 0, height = 0;
+        unsigned int texture = 0;
+    };
+
+    Settings settings;
+    int width = 0, height = 0;
+    float renderScale = 1.0f;
+    int renderWidth = 0, renderHeight = 0;
+    unsigned int sceneFBO = 0, sceneTexture = 0, depthBuffer = 0;
+    unsigned int bloomFBO = 0;
+    unsigned int ldrFBO = 0, ldrTexture = 0;
+    unsigned int outputFBO = 0;
+    std::vector<BloomMip> bloomMips; // one extra level so the chain can start one level lower
+    unsigned int emptyVAO = 0;
+    Shader *downsampleShader = nullptr;
+    Shader *upsampleShader = nullptr;
+    Shader *compositeShader = nullptr;
+    Shader *upscaleShader = nullptr;
+    unsigned int timerQueries[2] = { 0, 0 };
+    unsigned int queryFrame = 0;
+
+    // region uniform: scale from the full target coordinates to the rendered corner (xy) and the last coordinate that
+    // does not blend with the texels outside it (zw)
+    void setRegion(Shader &shader, const char *name, int regionWidth, int regionHeight) const
+    {
+        glm::vec2 scale(static_cast<float>(regionWidth) / width, static_cast<float>(regionHeight) / height);
+        glm::vec2 limit = scale - glm::vec2(0.5f / width, 0.5f / height);
+        shader.setVec4(name, glm::vec4(scale, limit));
+    }
+
+    static void setSampling(GLint filter)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    // reads the bloom time of the previous frame and moves the start of the chain to stay within the budget; starting
+    // one level lower touches a quarter of the pixels, so it only goes back up when four times the time still fits
+    void readTimer()
+    {
+        if (queryFrame == 0)
+            return;
+        unsigned int previous = timerQueries[(queryFrame - 1) % 2];
+        GLint available = 0;
+        glGetQueryObjectiv(previous, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(previous, GL_QUERY_RESULT, &elapsed);
+        stats.bloomGpuMs = elapsed / 1000000.0f;
+        if (stats.firstLevel == 0 && stats.bloomGpuMs > stats.budgetMs)
+            stats.firstLevel = 1;
+        else if (stats.firstLevel == 1 && stats.bloomGpuMs * 4.0f < stats.budgetMs * 0.8f)
+            stats.firstLevel = 0;
+    }
+};
+#endif
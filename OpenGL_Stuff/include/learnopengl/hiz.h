@@ -0,0 +1,581 @@
+#ifndef HIZ_H
+#define HIZ_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/draw_stats.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/compute_shader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// Hierarchical-Z occlusion culler.
+// Each frame the large occluders are rasterized into a small depth buffer, a max-depth mip chain is built from it
+// and world space boxes are tested against the coarsest level where they cover at most 2x2 texels.
+// With an OpenGL 4.3 context the occluders are drawn on the GPU and the chain is reduced with a compute shader,
+// then the levels used for testing are copied into a pixel buffer and mapped a few frames later, when their fence has
+// signaled, so the CPU never waits for the GPU. The boxes are then tested against that older pyramid with the camera
+// it was built for: the box rectangle also takes in where the box is on screen now, and when the camera has moved or
+// turned more than a little since then nothing is rejected. Otherwise a CPU software rasterizer fills the pyramid.
+class HiZCuller
+{
+public:
+    // resolution of the pyramid level used for testing (the GPU renders at twice this size)
+    static const int WIDTH = 128;
+    static const int HEIGHT = 72;
+
+    // pixel buffers in flight on the GPU path; the pyramid tested is usually READBACK_FRAMES - 1 frames old
+    static const unsigned int READBACK_FRAMES = 3;
+
+    struct Settings {
+        float maxCameraMove = 0.5f; // camera movement since the pyramid was built beyond which nothing is rejected
+        float maxCameraTurn = 5.0f; // same for the view direction, in degrees
+    };
+
+    struct Stats {
+        unsigned int occluderTriangles = 0;
+        float buildMs = 0.0f;        // CPU time of Build
+        unsigned int pyramidAge = 0; // frames between the pyramid tested and the current frame (GPU path)
+        bool pyramidUsable = false;  // false: no pyramid yet or the camera moved too much, every box is visible
+    };
+
+    bool enabled = true;
+    Settings settings;
+    Stats stats;
+
+    // useGpu is ignored when the context has no compute shader support
+    void Init(bool useGpu)
+    {
+        Release();
+        gpu = useGpu && GLAD_GL_VERSION_4_3;
+        levels.clear();
+        int width = WIDTH, height = HEIGHT;
+        while (true)
+        {
+            Level level;
+            level.width = width;
+            level.height = height;
+            level.depth.assign(width * height, 1.0f);
+            levels.push_back(level);
+            if (width == 1 && height == 1)
+                break;
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+        if (gpu)
+            initGpu();
+    }
+
+    bool UsesGpu() const { return gpu; }
+
+    // frees the GL objects of the GPU path; call while the context is still current
+    void Release()
+    {
+        for (unsigned int i = 0; i < READBACK_FRAMES; i++)
+        {
+            if (readbacks[i].fence)
+                glDeleteSync(readbacks[i].fence);
+            if (readbacks[i].buffer)
+                glDeleteBuffers(1, &readbacks[i].buffer);
+            readbacks[i] = Readback();
+        }
+        if (depthShader)
+            glDeleteProgram(depthShader->ID);
+        if (copyShader)
+            glDeleteProgram(copyShader->ID);
+        if (reduceShader)
+            glDeleteProgram(reduceShader->ID);
+        depthShader.reset();
+        copyShader.reset();
+        reduceShader.reset();
+        if (depthFBO)
+            glDeleteFramebuffers(1, &depthFBO);
+        if (depthTexture)
+            glDeleteTextures(1, &depthTexture);
+        if (hizTexture)
+            glDeleteTextures(1, &hizTexture);
+        depthFBO = depthTexture = hizTexture = 0;
+    }
+
+    // picks the meshes whose world space extent is at least minExtent, biggest first, until the triangle budget runs out
+    void AddOccluders(const std::vector<Mesh> &meshes, const glm::mat4 &modelMatrix, unsigned int triangleBudget, float minExtent)
+    {
+        std::vector<std::pair<float, unsigned int>> candidates;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            glm::vec3 size = meshes[i].bounds.Transformed(modelMatrix).Extents() * 2.0f;
+            float extent = std::max(size.x, std::max(size.y, size.z));
+            if (extent >= minExtent)
+                candidates.push_back(std::make_pair(extent, i));
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const std::pair<float, unsigned int> &a, const std::pair<float, unsigned int> &b) { return a.first > b.first; });
+
+        for (unsigned int c = 0; c < candidates.size(); c++)
+        {
+            const Mesh &mesh = meshes[candidates[c].second];
+            unsigned int triangles = static_cast<unsigned int>(mesh.indices.size() / 3);
+            if (stats.occluderTriangles + triangles > triangleBudget)
+                continue;
+            stats.occluderTriangles += triangles;
+            if (gpu)
+            {
+                GpuOccluder occluder;
+                occluder.VAO = mesh.VAO;
+                occluder.indexCount = static_cast<unsigned int>(mesh.indices.size());
+                occluder.model = modelMatrix;
+                gpuOccluders.push_back(occluder);
+            }
+            else
+            {
+                for (unsigned int i = 0; i < mesh.indices.size(); i++)
+                    occluderTriangles.push_back(glm::vec3(modelMatrix * glm::vec4(mesh.vertices[mesh.indices[i]].Position, 1.0f)));
+            }
+        }
+    }
+
+    // rebuilds the pyramid for the given camera, call once per frame before testing
+    void Build(const glm::mat4 &viewProjectionMatrix)
+    {
+        viewProjection = viewProjectionMatrix;
+        frame++;
+        if (!enabled)
+            return;
+        auto start = std::chrono::steady_clock::now();
+        if (gpu)
+        {
+            collectReadbacks();
+            buildGpu();
+            stats.pyramidAge = frame - pyramidFrame;
+            stats.pyramidUsable = pyramidFrame != 0 && cameraClose(pyramidViewProjection, viewProjection);
+        }
+        else
+        {
+            rasterizeOccluders();
+            for (unsigned int l = 1; l < levels.size(); l++)
+                downsample(levels[l - 1], levels[l]);
+            pyramidViewProjection = viewProjection;
+            pyramidFrame = frame;
+            stats.pyramidAge = 0;
+            stats.pyramidUsable = true;
+        }
+        stats.buildMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // false only when the whole box is behind the occluders; boxes crossing the near plane are always visible
+    bool IsBoxVisible(const BoundingBox &box) const
+    {
+        if (!enabled || !stats.pyramidUsable)
+            return true;
+
+        // depth and rectangle with the camera of the pyramid; with an older pyramid the rectangle also covers the box
+        // as the current camera sees it
+        glm::vec2 minNdc(1e30f), maxNdc(-1e30f);
+        float minDepth = 1.0f;
+        if (!projectBox(box, pyramidViewProjection, minNdc, maxNdc, minDepth))
+            return true;
+        if (pyramidFrame != frame)
+        {
+            float currentDepth = 1.0f;
+            if (!projectBox(box, viewProjection, minNdc, maxNdc, currentDepth))
+                return true;
+        }
+
+        // the rectangle is grown by one texel: occluder texels are filled when their center is covered,
+        // so a box peeking past an occluder edge always reaches an uncovered neighbour
+        int x0 = static_cast<int>(std::floor((minNdc.x * 0.5f + 0.5f) * WIDTH)) - 1;
+        int x1 = static_cast<int>(std::floor((maxNdc.x * 0.5f + 0.5f) * WIDTH)) + 1;
+        int y0 = static_cast<int>(std::floor((minNdc.y * 0.5f + 0.5f) * HEIGHT)) - 1;
+        int y1 = static_cast<int>(std::floor((maxNdc.y * 0.5f + 0.5f) * HEIGHT)) + 1;
+        if (x1 < 0 || y1 < 0 || x0 >= WIDTH || y0 >= HEIGHT)
+            return true; // off screen, left to the frustum test
+        x0 = std::max(0, x0);
+        y0 = std::max(0, y0);
+        x1 = std::min(WIDTH - 1, x1);
+        y1 = std::min(HEIGHT - 1, y1);
+
+        // walk up the chain until the rectangle covers at most 2x2 texels
+        unsigned int l = 0;
+        while (l + 1 < levels.size() && (x1 - x0 > 1 || y1 - y0 > 1))
+        {
+            const Level &src = levels[l];
+            const Level &dst = levels[l + 1];
+            x0 = x0 * dst.width / src.width;
+            x1 = x1 * dst.width / src.width;
+            y0 = y0 * dst.height / src.height;
+            y1 = y1 * dst.height / src.height;
+            l++;
+        }
+
+        const Level &level = levels[l];
+        float maxDepth = 0.0f;
+        for (int y = y0; y <= y1; y++)
+            for (int x = x0; x <= x1; x++)
+                maxDepth = std::max(maxDepth, level.depth[y * level.width + x]);
+        return minDepth <= maxDepth;
+    }
+
+private:
+    struct Level {
+        int width;
+        int height;
+        std::vector<float> depth;
+    };
+
+    struct GpuOccluder {
+        unsigned int VAO;
+        unsigned int indexCount;
+        glm::mat4 model;
+    };
+
+    struct Readback {
+        unsigned int buffer = 0;
+        GLsync fence = nullptr;
+        glm::mat4 viewProjection;
+        unsigned int frame = 0;
+    };
+
+    bool gpu = false;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    glm::mat4 pyramidViewProjection = glm::mat4(1.0f); // camera the levels were built for
+    unsigned int frame = 0;
+    unsigned int pyramidFrame = 0; // 0 = no pyramid yet
+    std::vector<Level> levels;
+
+    // CPU path
+    std::vector<glm::vec3> occluderTriangles;
+
+    // GPU path
+    std::vector<GpuOccluder> gpuOccluders;
+    unsigned int depthFBO = 0;
+    unsigned int depthTexture = 0;
+    unsigned int hizTexture = 0;
+    int gpuLevelCount = 0;
+    std::unique_ptr<Shader> depthShader;
+    std::unique_ptr<ComputeShader> copyShader;
+    std::unique_ptr<ComputeShader> reduceShader;
+    Readback readbacks[READBACK_FRAMES];
+    unsigned int readbackNext = 0;
+    size_t readbackBytes = 0;
+
+    // widens the NDC rectangle and lowers minDepth with the corners of the box; false when it crosses the near plane
+    static bool projectBox(const BoundingBox &box, const glm::mat4 &matrix, glm::vec2 &minNdc, glm::vec2 &maxNdc, float &minDepth)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+            glm::vec4 clip = matrix * glm::vec4(corner, 1.0f);
+            if (clip.w <= 1e-4f || clip.z < -clip.w)
+                return false;
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            minNdc = glm::min(minNdc, glm::vec2(ndc));
+            maxNdc = glm::max(maxNdc, glm::vec2(ndc));
+            minDepth = std::min(minDepth, ndc.z * 0.5f + 0.5f);
+        }
+        return true;
+    }
+
+    // eye position and view direction of a view-projection matrix (the center of its near and far planes)
+    static void cameraOf(const glm::mat4 &matrix, glm::vec3 &eye, glm::vec3 &forward)
+    {
+        glm::mat4 inverse = glm::inverse(matrix);
+        glm::vec4 nearCenter = inverse * glm::vec4(0.0f, 0.0f, -1.0f, 1.0f);
+        glm::vec4 farCenter = inverse * glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+        eye = glm::vec3(nearCenter) / nearCenter.w;
+        forward = glm::normalize(glm::vec3(farCenter) / farCenter.w - eye);
+    }
+
+    bool cameraClose(const glm::mat4 &a, const glm::mat4 &b) const
+    {
+        glm::vec3 eyeA, eyeB, forwardA, forwardB;
+        cameraOf(a, eyeA, forwardA);
+        cameraOf(b, eyeB, forwardB);
+        return glm::length(eyeA - eyeB) <= settings.maxCameraMove &&
+               glm::dot(forwardA, forwardB) >= std::cos(glm::radians(settings.maxCameraTurn));
+    }
+
+    // each destination texel takes the max of every source texel it overlaps, which also handles odd sizes
+    static void downsample(const Level &src, Level &dst)
+    {
+        for (int y = 0; y < dst.height; y++)
+        {
+            int sy0 = y * src.height / dst.height;
+            int sy1 = ((y + 1) * src.height + dst.height - 1) / dst.height;
+            for (int x = 0; x < dst.width; x++)
+            {
+                int sx0 = x * src.width / dst.width;
+                int sx1 = ((x + 1) * src.width + dst.width - 1) / dst.width;
+                float maxDepth = 0.0f;
+                for (int sy = sy0; sy < sy1; sy++)
+                    for (int sx = sx0; sx < sx1; sx++)
+                        maxDepth = std::max(maxDepth, src.depth[sy * src.width + sx]);
+                dst.depth[y * dst.width + x] = maxDepth;
+            }
+        }
+    }
+
+    // software rasterizer: a texel is written when its center is inside the triangle, with the farthest depth
+    // reachable inside the texel so the occluder never claims to be closer than it really is
+    void rasterizeOccluders()
+    {
+        std::fill(levels[0].depth.begin(), levels[0].depth.end(), 1.0f);
+        for (size_t t = 0; t + 2 < occluderTriangles.size(); t += 3)
+        {
+            glm::vec4 clip[3];
+            int outsideMask = 0x3f;
+            for (int i = 0; i < 3; i++)
+            {
+                clip[i] = viewProjection * glm::vec4(occluderTriangles[t + i], 1.0f);
+                int mask = 0;
+                if (clip[i].x < -clip[i].w) mask |= 1;
+                if (clip[i].x > clip[i].w) mask |= 2;
+                if (clip[i].y < -clip[i].w) mask |= 4;
+                if (clip[i].y > clip[i].w) mask |= 8;
+                if (clip[i].z < -clip[i].w) mask |= 16;
+                if (clip[i].z > clip[i].w) mask |= 32;
+                outsideMask &= mask;
+            }
+            if (outsideMask != 0)
+                continue; // all three vertices outside the same plane
+
+            // clip against the near plane (z > -w), the result has at most 4 vertices
+            glm::vec4 polygon[4];
+            int count = 0;
+            for (int i = 0; i < 3; i++)
+            {
+                const glm::vec4 &a = clip[i];
+                const glm::vec4 &b = clip[(i + 1) % 3];
+                float da = a.z + a.w;
+                float db = b.z + b.w;
+                if (da >= 0.0f)
+                    polygon[count++] = a;
+                if ((da >= 0.0f) != (db >= 0.0f))
+                    polygon[count++] = a + (b - a) * (da / (da - db));
+            }
+            if (count < 3)
+                continue;
+
+            glm::vec3 screen[4];
+            for (int i = 0; i < count; i++)
+            {
+                float invW = 1.0f / polygon[i].w;
+                screen[i] = glm::vec3((polygon[i].x * invW * 0.5f + 0.5f) * WIDTH,
+                                      (polygon[i].y * invW * 0.5f + 0.5f) * HEIGHT,
+                                      polygon[i].z * invW * 0.5f + 0.5f);
+            }
+            for (int i = 1; i + 1 < count; i++)
+                rasterizeTriangle(screen[0], screen[i], screen[i + 1]);
+        }
+    }
+
+    void rasterizeTriangle(glm::vec3 a, glm::vec3 b, glm::vec3 c)
+    {
+        float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (std::fabs(area) < 1e-6f)
+            return;
+        if (area < 0.0f)
+        {
+            std::swap(b, c);
+            area = -area;
+        }
+
+        int minX = std::max(0, static_cast<int>(std::floor(std::min(a.x, std::min(b.x, c.x)))));
+        int maxX = std::min(WIDTH - 1, static_cast<int>(std::ceil(std::max(a.x, std::max(b.x, c.x)))));
+        int minY = std::max(0, static_cast<int>(std::floor(std::min(a.y, std::min(b.y, c.y)))));
+        int maxY = std::min(HEIGHT - 1, static_cast<int>(std::ceil(std::max(a.y, std::max(b.y, c.y)))));
+        if (minX > maxX || minY > maxY)
+            return;
+
+        // edge functions E(x, y) = A * x + B * y + C, positive inside
+        float A0 = a.y - b.y, B0 = b.x - a.x, C0 = a.x * b.y - a.y * b.x;
+        float A1 = b.y - c.y, B1 = c.x - b.x, C1 = b.x * c.y - b.y * c.x;
+        float A2 = c.y - a.y, B2 = a.x - c.x, C2 = c.x * a.y - c.y * a.x;
+
+        // depth plane z(x, y) and the extra depth reachable inside one texel
+        float invArea = 1.0f / area;
+        float dzdx = (A1 * a.z + A2 * b.z + A0 * c.z) * invArea;
+        float dzdy = (B1 * a.z + B2 * b.z + B0 * c.z) * invArea;
+        float depthSlack = 0.5f * (std::fabs(dzdx) + std::fabs(dzdy));
+
+        for (int y = minY; y <= maxY; y++)
+        {
+            float py = y + 0.5f;
+            for (int x = minX; x <= maxX; x++)
+            {
+                float px = x + 0.5f;
+                float w0 = A1 * px + B1 * py + C1; // weight of a
+                float w1 = A2 * px + B2 * py + C2; // weight of b
+                float w2 = A0 * px + B0 * py + C0; // weight of c
+                if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                    continue;
+                float depth = (w0 * a.z + w1 * b.z + w2 * c.z) * invArea + depthSlack;
+                float &stored = levels[0].depth[y * WIDTH + x];
+                if (depth < stored)
+                    stored = depth;
+            }
+        }
+    }
+
+    void initGpu()
+    {
+        const int gpuWidth = WIDTH * 2;
+        const int gpuHeight = HEIGHT * 2;
+
+        glGenTextures(1, &depthTexture);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, gpuWidth, gpuHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        glGenFramebuffers(1, &depthFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, depthFBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::HIZ:: depth framebuffer is not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        gpuLevelCount = static_cast<int>(levels.size()) + 1;
+        glGenTextures(1, &hizTexture);
+        glBindTexture(GL_TEXTURE_2D, hizTexture);
+        glTexStorage2D(GL_TEXTURE_2D, gpuLevelCount, GL_R32F, gpuWidth, gpuHeight);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // levels 1 and up back to back, the layout of levels
+        readbackBytes = 0;
+        for (unsigned int l = 0; l < levels.size(); l++)
+            readbackBytes += levels[l].depth.size() * sizeof(float);
+        for (unsigned int i = 0; i < READBACK_FRAMES; i++)
+        {
+            glGenBuffers(1, &readbacks[i].buffer);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readbacks[i].buffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, readbackBytes, NULL, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        readbackNext = 0;
+        pyramidFrame = 0;
+
+        depthShader.reset(new Shader("shaders/depth.vs", "shaders/depth.fs"));
+        copyShader.reset(new ComputeShader("shaders/hiz_copy.cs"));
+        reduceShader.reset(new ComputeShader("shaders/hiz_reduce.cs"));
+    }
+
+    // maps the newest readback whose fence has signaled into levels, without waiting for the others
+    void collectReadbacks()
+    {
+        for (unsigned int n = 0; n < READBACK_FRAMES; n++)
+        {
+            // oldest first, so the newest finished one ends up in levels
+            Readback &readback = readbacks[(readbackNext + n) % READBACK_FRAMES];
+            if (!readback.fence)
+                continue;
+            if (glClientWaitSync(readback.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                break; // the later ones are not done either
+            glDeleteSync(readback.fence);
+            readback.fence = nullptr;
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+            const char *data = static_cast<const char *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, readbackBytes, GL_MAP_READ_BIT));
+            if (data)
+            {
+                for (unsigned int l = 0; l < levels.size(); l++)
+                {
+                    std::memcpy(levels[l].depth.data(), data, levels[l].depth.size() * sizeof(float));
+                    data += levels[l].depth.size() * sizeof(float);
+                }
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                pyramidViewProjection = readback.viewProjection;
+                pyramidFrame = readback.frame;
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+    }
+
+
+    void buildGpu()
+    {
+        const int gpuWidth = WIDTH * 2;
+        const int gpuHeight = HEIGHT * 2;
+
+        GLint previousViewport[4];
+        GLint previousFramebuffer;
+        glGetIntegerv(GL_VIEWPORT, previousViewport);
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+        // 1. occluder depth
+        glBindFramebuffer(GL_FRAMEBUFFER, depthFBO);
+        glViewport(0, 0, gpuWidth, gpuHeight);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        depthShader->use();
+        depthShader->setMat4("viewProjection", viewProjection);
+        for (unsigned int i = 0; i < gpuOccluders.size(); i++)
+        {
+            depthShader->setMat4("model", gpuOccluders[i].model);
+            glBindVertexArray(gpuOccluders[i].VAO);
+            glDrawElements(GL_TRIANGLES, gpuOccluders[i].indexCount, GL_UNSIGNED_INT, 0);
+            DrawStats::Count(gpuOccluders[i].indexCount / 3);
+        }
+        glBindVertexArray(0);
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+
+        // 2. copy the depth into level 0 of the chain
+        copyShader->use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        copyShader->setInt("depthMap", 0);
+        glBindImageTexture(0, hizTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        copyShader->dispatch(gpuWidth, gpuHeight, 8, 8);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        // 3. max reduction, one dispatch per level
+        reduceShader->use();
+        int srcWidth = gpuWidth, srcHeight = gpuHeight;
+        for (int level = 1; level < gpuLevelCount; level++)
+        {
+            int dstWidth = std::max(1, srcWidth / 2);
+            int dstHeight = std::max(1, srcHeight / 2);
+            glBindImageTexture(0, hizTexture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+            glBindImageTexture(1, hizTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            reduceShader->setIVec2("srcSize", srcWidth, srcHeight);
+            reduceShader->setIVec2("dstSize", dstWidth, dstHeight);
+            reduceShader->dispatch(dstWidth, dstHeight, 8, 8);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            srcWidth = dstWidth;
+            srcHeight = dstHeight;
+        }
+
+        // 4. copy the levels used for testing (level 1 and up, a few KB) into the next pixel buffer; with a pixel
+        // buffer bound glGetTexImage only queues the copy. When every buffer is still in flight the GPU is more than
+        // READBACK_FRAMES frames behind and this frame is not read back
+        Readback &readback = readbacks[readbackNext];
+        if (readback.fence)
+            return;
+        glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT);
+        glBindTexture(GL_TEXTURE_2D, hizTexture);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        size_t offset = 0;
+        for (unsigned int l = 0; l < levels.size(); l++)
+        {
+            glGetTexImage(GL_TEXTURE_2D, l + 1, GL_RED, GL_FLOAT, reinterpret_cast<void *>(offset));
+            offset += levels[l].depth.size() * sizeof(float);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        readback.viewProjection = viewProjection;
+        readback.frame = frame;
+        readbackNext = (readbackNext + 1) % READBACK_FRAMES;
+    }
+};
+#endif
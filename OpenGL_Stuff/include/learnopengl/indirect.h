@@ -0,0 +1,385 @@
+#ifndef INDIRECT_H
+#define INDIRECT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/draw_stats.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// Draws the meshes of a static model with one glMultiDrawElementsIndirect call per texture-size group.
+// The meshes are merged into one vertex and index buffer and each draw command points at its per draw data (transform,
+// texture layers and reflection parameters) through baseInstance, which reaches the vertex shader as an instanced attribute.
+// Textures are copied at their own size into texture arrays, one array per texture size, so the image is the same as
+// mesh by mesh. The commands are grouped by the pair of diffuse and emissive arrays they sample and each group is one
+// glMultiDrawElementsIndirect call over its range of the indirect buffer (one call when every texture has the same size).
+// DrawDepth issues the same commands from a position only copy of the geometry, for a depth prepass.
+// Needs OpenGL 4.3; IsSupported() is false on older contexts and the caller keeps drawing mesh by mesh.
+class MultiDrawBatch
+{
+public:
+    // vertex attribute that receives baseInstance (one value per draw)
+    static const unsigned int DRAW_INDEX_ATTRIBUTE = 5;
+    // shader storage bindings used by shader_mdi.vs
+    static const unsigned int DRAW_DATA_BINDING = 0;
+    static const unsigned int TRANSFORM_BINDING = 1;
+
+    unsigned int drawCount = 0; // commands issued by the last Draw (meshes that survived the culling)
+    unsigned int callCount = 0; // glMultiDrawElementsIndirect calls of the last Draw, one per texture group with visible meshes
+
+    bool Init(const std::vector<Mesh> &meshes)
+    {
+        supported = GLAD_GL_VERSION_4_3 && !meshes.empty();
+        if (!supported)
+            return false;
+
+        // merged geometry, every mesh keeps its own index range and base vertex
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        std::vector<DrawData> drawData(meshes.size());
+        commands.resize(meshes.size());
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            DrawElementsIndirectCommand &command = commands[i];
+            command.count = static_cast<unsigned int>(meshes[i].indices.size());
+            command.instanceCount = 1;
+            command.firstIndex = static_cast<unsigned int>(indices.size());
+            command.baseVertex = static_cast<int>(vertices.size());
+            command.baseInstance = i;
+            vertices.insert(vertices.end(), meshes[i].vertices.begin(), meshes[i].vertices.end());
+            indices.insert(indices.end(), meshes[i].indices.begin(), meshes[i].indices.end());
+
+            drawData[i].transform = 0;
+            drawData[i].reflectivity = meshes[i].material.Reflectivity();
+            drawData[i].roughness = meshes[i].material.Roughness();
+            drawData[i].padding[0] = drawData[i].padding[1] = drawData[i].padding[2] = 0;
+            // the level shader only samples the diffuse and the emissive slot
+            int diffuseArray = placeTexture(diffuseArrays, meshes[i].material.Texture(TextureSlot::Diffuse), drawData[i].diffuseLayer);
+            int emissiveArray = placeTexture(emissiveArrays, meshes[i].material.Texture(TextureSlot::Emissive), drawData[i].emissiveLayer);
+            groupOf(diffuseArray, emissiveArray).meshes.push_back(i);
+        }
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        glGenBuffers(1, &drawIndexBuffer);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        // same layout as Mesh::setupMesh
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        // 0, 1, 2... advanced once per instance, so the first instance of command i reads baseInstance = i
+        std::vector<unsigned int> drawIndices(meshes.size());
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            drawIndices[i] = i;
+        glBindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, drawIndices.size() * sizeof(unsigned int), &drawIndices[0], GL_STATIC_DRAW);
+        glEnableVertexAttribArray(DRAW_INDEX_ATTRIBUTE);
+        glVertexAttribIPointer(DRAW_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void*)0);
+        glVertexAttribDivisor(DRAW_INDEX_ATTRIBUTE, 1);
+
+        // position only stream for DrawDepth: same indices and draw indices, a third of the vertex fetch
+        std::vector<glm::vec3> positions(vertices.size());
+        for (unsigned int i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+        glGenVertexArrays(1, &depthVAO);
+        glGenBuffers(1, &depthVBO);
+        glBindVertexArray(depthVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, depthVBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glBindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+        glEnableVertexAttribArray(DRAW_INDEX_ATTRIBUTE);
+        glVertexAttribIPointer(DRAW_INDEX_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void*)0);
+        glVertexAttribDivisor(DRAW_INDEX_ATTRIBUTE, 1);
+        glBindVertexArray(0);
+
+        glGenBuffers(1, &drawDataBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, drawData.size() * sizeof(DrawData), &drawData[0], GL_STATIC_DRAW);
+        glGenBuffers(1, &transformBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, transformBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::mat4), &transform[0][0], GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        glGenBuffers(1, &indirectBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        frameCommands.reserve(commands.size());
+
+        unsigned int diffuseCount = 0, emissiveCount = 0;
+        for (TextureArray &array : diffuseArrays)
+        {
+            buildTextureArray(array);
+            diffuseCount += static_cast<unsigned int>(array.textures.size());
+        }
+        for (TextureArray &array : emissiveArrays)
+        {
+            buildTextureArray(array);
+            emissiveCount += static_cast<unsigned int>(array.textures.size());
+        }
+        std::cout << "Multi-draw indirect: " << meshes.size() << " mallas, " << diffuseCount << " texturas difusas y "
+                  << emissiveCount << " emisivas en " << diffuseArrays.size() + emissiveArrays.size()
+                  << " arreglos (uno por tamaño), " << groups.size() << " grupos de comandos (una llamada por grupo)" << std::endl;
+        return true;
+    }
+
+    bool IsSupported() const { return supported; }
+
+    // issues one multi draw with the meshes whose visible flag is set (all of them when visible is null).
+    // The shader must be a program built from shader_mdi.vs/fs and already in use.
+    void Draw(Shader &shader, const glm::mat4 &modelMatrix, const unsigned char *visible = nullptr)
+    {
+        if (!supported || !prepareCommands(modelMatrix, visible))
+            return;
+
+        shader.setInt("diffuseMaps", 0);
+        shader.setInt("emissiveMaps", 1);
+        beginMultiDraw(VAO);
+        callCount = 0;
+        for (const DrawGroup &group : groups)
+        {
+            if (group.frameCount == 0)
+                continue;
+            // a group without one of the maps never samples that array
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, group.diffuseArray >= 0 ? diffuseArrays[group.diffuseArray].id : 0);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, group.emissiveArray >= 0 ? emissiveArrays[group.emissiveArray].id : 0);
+            multiDraw(group.frameFirst, group.frameCount);
+            callCount++;
+        }
+        endMultiDraw();
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // same commands as Draw from the position only stream, with no textures.
+    // The shader must be a program built from depth_prepass_mdi.vs and already in use.
+    void DrawDepth(const glm::mat4 &modelMatrix, const unsigned char *visible = nullptr)
+    {
+        if (!supported || !prepareCommands(modelMatrix, visible))
+            return;
+        // no textures: the groups are back to back in the buffer, one call covers them all
+        beginMultiDraw(depthVAO);
+        multiDraw(0, drawCount);
+        callCount = 1;
+        endMultiDraw();
+    }
+
+private:
+    // layout fixed by the GL specification
+    struct DrawElementsIndirectCommand {
+        unsigned int count;
+        unsigned int instanceCount;
+        unsigned int firstIndex;
+        int baseVertex;
+        unsigned int baseInstance;
+    };
+
+    // std430 layout of the DrawData struct in shader_mdi.vs
+    struct DrawData {
+        unsigned int transform;
+        int diffuseLayer;  // -1 when the mesh has no such map
+        int emissiveLayer;
+        float reflectivity; // Material::Reflectivity and Roughness
+        float roughness;
+        unsigned int padding[3];
+    };
+
+    // textures of one size, one per layer
+    struct TextureArray {
+        int width;
+        int height;
+        std::vector<unsigned int> textures;
+        unsigned int id = 0;
+    };
+
+    // meshes that sample the same diffuse and emissive arrays (-1 when they have no such map)
+    struct DrawGroup {
+        int diffuseArray;
+        int emissiveArray;
+        std::vector<unsigned int> meshes;
+        unsigned int frameFirst = 0; // range of the group in frameCommands
+        unsigned int frameCount = 0;
+    };
+
+    bool supported = false;
+    unsigned int VAO = 0, VBO = 0, EBO = 0, drawIndexBuffer = 0;
+    unsigned int depthVAO = 0, depthVBO = 0;
+    unsigned int drawDataBuffer = 0, transformBuffer = 0, indirectBuffer = 0;
+    std::vector<TextureArray> diffuseArrays, emissiveArrays;
+    std::vector<DrawGroup> groups;
+    glm::mat4 transform = glm::mat4(1.0f);
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<DrawElementsIndirectCommand> frameCommands;
+
+    // uploads the transform when it changed and builds the command list; false when every mesh was culled
+    bool prepareCommands(const glm::mat4 &modelMatrix, const unsigned char *visible)
+    {
+        if (modelMatrix != transform)
+        {
+            transform = modelMatrix;
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, transformBuffer);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(glm::mat4), &transform[0][0]);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+
+        // culled meshes are dropped from the command list, the GL call count stays the same
+        frameCommands.clear();
+        for (DrawGroup &group : groups)
+        {
+            group.frameFirst = static_cast<unsigned int>(frameCommands.size());
+            for (unsigned int i : group.meshes)
+            {
+                if (!visible || visible[i])
+                    frameCommands.push_back(commands[i]);
+            }
+            group.frameCount = static_cast<unsigned int>(frameCommands.size()) - group.frameFirst;
+        }
+        drawCount = static_cast<unsigned int>(frameCommands.size());
+        return drawCount > 0;
+    }
+
+    // uploads the command list of the frame and binds the buffers shared by every call
+    void beginMultiDraw(unsigned int vertexArray)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, drawDataBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TRANSFORM_BINDING, transformBuffer);
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, frameCommands.size() * sizeof(DrawElementsIndirectCommand), &frameCommands[0]);
+        glBindVertexArray(vertexArray);
+    }
+
+    // one call over count commands of frameCommands starting at first
+    void multiDraw(unsigned int first, unsigned int count)
+    {
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(first * sizeof(DrawElementsIndirectCommand)),
+                                    static_cast<GLsizei>(count), 0);
+        unsigned long long indexCount = 0;
+        for (unsigned int i = first; i < first + count; i++)
+            indexCount += frameCommands[i].count;
+        DrawStats::Count(indexCount / 3);
+    }
+
+    void endMultiDraw()
+    {
+        glBindVertexArray(0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    DrawGroup &groupOf(int diffuseArray, int emissiveArray)
+    {
+        for (DrawGroup &group : groups)
+            if (group.diffuseArray == diffuseArray && group.emissiveArray == emissiveArray)
+                return group;
+        DrawGroup group;
+        group.diffuseArray = diffuseArray;
+        group.emissiveArray = emissiveArray;
+        groups.push_back(group);
+        return groups.back();
+    }
+
+    // finds or adds the texture in the array of its size; returns the array and sets layer (both -1 without texture)
+    static int placeTexture(std::vector<TextureArray> &arrays, unsigned int id, int &layer)
+    {
+        layer = -1;
+        if (!id)
+            return -1;
+        GLint width = 0, height = 0;
+        glBindTexture(GL_TEXTURE_2D, id);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        if (width == 0 || height == 0)
+        {
+            std::cout << "ERROR::MULTIDRAW:: texture " << id << " has no image" << std::endl;
+            return -1;
+        }
+
+        unsigned int a = 0;
+        while (a < arrays.size() && (arrays[a].width != width || arrays[a].height != height))
+            a++;
+        if (a == arrays.size())
+        {
+            TextureArray array;
+            array.width = width;
+            array.height = height;
+            arrays.push_back(array);
+        }
+        std::vector<unsigned int> &textures = arrays[a].textures;
+        unsigned int l = 0;
+        while (l < textures.size() && textures[l] != id)
+            l++;
+        if (l == textures.size())
+            textures.push_back(id);
+        layer = static_cast<int>(l);
+        return static_cast<int>(a);
+    }
+
+    // copies every texture texel for texel into a layer of an RGBA8 array, then builds the mipmaps the same way
+    // Model::TextureFromFile does for the textures themselves
+    static void buildTextureArray(TextureArray &target)
+    {
+        unsigned int levels = 1;
+        while ((std::max(target.width, target.height) >> levels) > 0)
+            levels++;
+        const std::vector<unsigned int> &textures = target.textures;
+
+        unsigned int array;
+        glGenTextures(1, &array);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, target.width, target.height, static_cast<GLsizei>(textures.size()));
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        GLint previousFramebuffer;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        unsigned int framebuffers[2];
+        glGenFramebuffers(2, framebuffers);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], 0);
+            glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, array, 0, i);
+            if (glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            {
+                std::cout << "ERROR::MULTIDRAW:: texture " << textures[i] << " can not be copied into the array" << std::endl;
+                continue;
+            }
+            // same size on both sides: no filtering, an exact copy
+            glBlitFramebuffer(0, 0, target.width, target.height, 0, 0, target.width, target.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        glDeleteFramebuffers(2, framebuffers);
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        target.id = array;
+    }
+};
+#endif
@@ -0,0 +1,344 @@
+#ifndef INPUT_RECORDER_H
+#define INPUT_RECORDER_H
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Records the input events of a session (keys, mouse movement, scroll, mouse buttons) to a binary file and plays them
+// back, for repeatable performance runs.
+// Every event is stamped with the simulation time of the frame it arrived in (seconds since the first frame); the
+// callbacks run inside glfwPollEvents at the end of a frame, so the game reacts to them in the next one. On replay
+// NextEvent hands out the events stamped before the current frame's time, which is the same frame when the simulation
+// advances by the same fixed step as the recording, and the first frame after the recorded time otherwise.
+// The replayed key state is kept here and GetKey answers from it, so the polling code reads keys the same way live
+// and on replay.
+// File: "INPR", uint16 version, uint16 0, float fixed step (0 = the recording used the frame time), double simulation
+// start time, then the events: float time, uint8 type and the payload of the type; little endian.
+class InputRecorder
+{
+public:
+    enum class Mode {
+        Off,
+        Record,
+        Replay
+    };
+
+    enum class EventType : unsigned char {
+        Key = 1,     // code = key, action = GLFW_PRESS or GLFW_RELEASE
+        Cursor,      // x, y = offset the camera turned by
+        Scroll,      // x, y = scroll offsets
+        MouseButton, // code = button, action = GLFW_PRESS or GLFW_RELEASE
+        End          // the recording stopped
+    };
+
+    struct Event {
+        float time = 0.0f;
+        EventType type = EventType::End;
+        int code = 0;
+        int action = 0;
+        float x = 0.0f, y = 0.0f;
+    };
+
+    struct Stats {
+        unsigned int events = 0; // recorded or loaded
+        unsigned int replayed = 0;
+        size_t bytes = 0;        // size of the file
+    };
+
+    Stats stats;
+
+    ~InputRecorder() { Stop(); }
+
+    bool StartRecording(const std::string &path, float newFixedStep, double newStartTime)
+    {
+        Stop();
+        file = std::fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            std::cout << "ERROR::INPUT_RECORDER:: cannot create " << path << std::endl;
+            return false;
+        }
+        fixedStep = newFixedStep;
+        startTime = newStartTime;
+        stats = Stats();
+        std::vector<unsigned char> header(magic(), magic() + 4);
+        put16(header, VERSION);
+        put16(header, 0);
+        putFloat(header, fixedStep);
+        putDouble(header, startTime);
+        write(header);
+        mode = Mode::Record;
+        return true;
+    }
+
+    bool StartReplay(const std::string &path)
+    {
+        Stop();
+        FILE *input = std::fopen(path.c_str(), "rb");
+        if (!input)
+        {
+            std::cout << "ERROR::INPUT_RECORDER:: cannot open " << path << std::endl;
+            return false;
+        }
+        std::vector<unsigned char> bytes;
+        unsigned char chunk[4096];
+        size_t read;
+        while ((read = std::fread(chunk, 1, sizeof(chunk), input)) > 0)
+            bytes.insert(bytes.end(), chunk, chunk + read);
+        std::fclose(input);
+
+        size_t offset = 0;
+        if (bytes.size() < HEADER_SIZE || std::memcmp(bytes.data(), magic(), 4) != 0 || get16(bytes, 4) != VERSION)
+        {
+            std::cout << "ERROR::INPUT_RECORDER:: " << path << " is not an input recording" << std::endl;
+            return false;
+        }
+        fixedStep = getFloat(bytes, 8);
+        startTime = getDouble(bytes, 12);
+        offset = HEADER_SIZE;
+        events.clear();
+        while (offset + 5 <= bytes.size())
+        {
+            Event event;
+            event.time = getFloat(bytes, offset);
+            event.type = static_cast<EventType>(bytes[offset + 4]);
+            offset += 5;
+            size_t size = payloadSize(event.type);
+            if (size == INVALID || offset + size > bytes.size())
+            {
+                std::cout << "ERROR::INPUT_RECORDER:: " << path << " is truncated or damaged after " << events.size() << " events" << std::endl;
+                break;
+            }
+            if (event.type == EventType::Key)
+            {
+                event.code = get16(bytes, offset);
+                event.action = bytes[offset + 2];
+            }
+            else if (event.type == EventType::MouseButton)
+            {
+                event.code = bytes[offset];
+                event.action = bytes[offset + 1];
+            }
+            else if (event.type == EventType::Cursor || event.type == EventType::Scroll)
+            {
+                event.x = getFloat(bytes, offset);
+                event.y = getFloat(bytes, offset + 4);
+            }
+            offset += size;
+            events.push_back(event);
+        }
+        // a recording that was cut short (a crash) ends after its last event
+        if (events.empty() || events.back().type != EventType::End)
+        {
+            Event end;
+            end.time = events.empty() ? 0.0f : events.back().time;
+            events.push_back(end);
+        }
+        stats = Stats();
+        stats.events = static_cast<unsigned int>(events.size());
+        stats.bytes = bytes.size();
+        std::fill(keys, keys + GLFW_KEY_LAST + 1, static_cast<unsigned char>(GLFW_RELEASE));
+        nextEvent = 0;
+        time = 0.0f;
+        mode = Mode::Replay;
+        return true;
+    }
+
+    // ends a recording (writes the End event and closes the file) or a replay
+    void Stop()
+    {
+        if (mode == Mode::Record)
+        {
+            Event end;
+            record(end);
+            std::fclose(file);
+            file = nullptr;
+            std::cout << "INPUT_RECORDER:: " << stats.events << " events (" << stats.bytes << " bytes) recorded" << std::endl;
+        }
+        mode = Mode::Off;
+    }
+
+    Mode GetMode() const { return mode; }
+    bool Recording() const { return mode == Mode::Record; }
+    bool Replaying() const { return mode == Mode::Replay; }
+    // simulation step of the recording, 0 when it used the frame time
+    float FixedStep() const { return fixedStep; }
+    // simulation time of the recording's first frame, so the replay starts at the same time
+    double StartTime() const { return startTime; }
+    // replay: the End event was handed out
+    bool Finished() const { return mode == Mode::Replay && nextEvent >= events.size(); }
+
+    // simulation time of the frame that starts, in seconds since the first frame
+    void BeginFrame(float frameTime) { time = frameTime; }
+
+    void RecordKey(int key, int action)
+    {
+        if (mode != Mode::Record || key < 0 || key > GLFW_KEY_LAST || action == GLFW_REPEAT)
+            return;
+        Event event;
+        event.type = EventType::Key;
+        event.code = key;
+        event.action = action;
+        record(event);
+    }
+    void RecordCursor(float x, float y) { recordMotion(EventType::Cursor, x, y); }
+    void RecordScroll(float x, float y) { recordMotion(EventType::Scroll, x, y); }
+    void RecordMouseButton(int button, int action)
+    {
+        if (mode != Mode::Record || button < 0 || button > GLFW_MOUSE_BUTTON_LAST)
+            return;
+        Event event;
+        event.type = EventType::MouseButton;
+        event.code = button;
+        event.action = action;
+        record(event);
+    }
+
+    // replay: the next event recorded before the current frame; key events also update GetKey
+    bool NextEvent(Event &event)
+    {
+        if (mode != Mode::Replay || nextEvent >= events.size() || !(events[nextEvent].time < time))
+            return false;
+        event = events[nextEvent++];
+        if (event.type == EventType::Key)
+            keys[event.code] = static_cast<unsigned char>(event.action);
+        stats.replayed++;
+        return true;
+    }
+
+    // GLFW_PRESS or GLFW_RELEASE: the replayed state on replay, glfwGetKey otherwise
+    int GetKey(GLFWwindow *window, int key) const
+    {
+        if (mode == Mode::Replay)
+            return key >= 0 && key <= GLFW_KEY_LAST ? keys[key] : GLFW_RELEASE;
+        return glfwGetKey(window, key);
+    }
+
+private:
+    static const uint16_t VERSION = 1;
+    static const size_t HEADER_SIZE = 20;
+    static const size_t INVALID = ~static_cast<size_t>(0);
+
+    Mode mode = Mode::Off;
+    FILE *file = nullptr;
+    float fixedStep = 0.0f;
+    double startTime = 0.0;
+    float time = 0.0f;
+    std::vector<Event> events; // replay
+    size_t nextEvent = 0;
+    unsigned char keys[GLFW_KEY_LAST + 1] = {};
+
+    static const char *magic() { return "INPR"; }
+
+    static size_t payloadSize(EventType type)
+    {
+        switch (type)
+        {
+        case EventType::Key: return 3;
+        case EventType::Cursor:
+        case EventType::Scroll: return 8;
+        case EventType::MouseButton: return 2;
+        case EventType::End: return 0;
+        }
+        return INVALID;
+    }
+
+    void recordMotion(EventType type, float x, float y)
+    {
+        if (mode != Mode::Record)
+            return;
+        Event event;
+        event.type = type;
+        event.x = x;
+        event.y = y;
+        record(event);
+    }
+
+    void record(const Event &event)
+    {
+        std::vector<unsigned char> bytes;
+        putFloat(bytes, time);
+        bytes.push_back(static_cast<unsigned char>(event.type));
+        if (event.type == EventType::Key)
+        {
+            put16(bytes, static_cast<uint16_t>(event.code));
+            bytes.push_back(static_cast<unsigned char>(event.action));
+        }
+        else if (event.type == EventType::MouseButton)
+        {
+            bytes.push_back(static_cast<unsigned char>(event.code));
+            bytes.push_back(static_cast<unsigned char>(event.action));
+        }
+        else if (event.type == EventType::Cursor || event.type == EventType::Scroll)
+        {
+            putFloat(bytes, event.x);
+            putFloat(bytes, event.y);
+        }
+        write(bytes);
+        stats.events++;
+    }
+
+    void write(const std::vector<unsigned char> &bytes)
+    {
+        std::fwrite(bytes.data(), 1, bytes.size(), file);
+        stats.bytes += bytes.size();
+    }
+
+    static void put16(std::vector<unsigned char> &bytes, uint16_t value)
+    {
+        bytes.push_back(static_cast<unsigned char>(value));
+        bytes.push_back(static_cast<unsigned char>(value >> 8));
+    }
+    static void put32(std::vector<unsigned char> &bytes, uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+            bytes.push_back(static_cast<unsigned char>(value >> (8 * i)));
+    }
+    static void putFloat(std::vector<unsigned char> &bytes, float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        put32(bytes, bits);
+    }
+    static void putDouble(std::vector<unsigned char> &bytes, double value)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        put32(bytes, static_cast<uint32_t>(bits));
+        put32(bytes, static_cast<uint32_t>(bits >> 32));
+    }
+
+    static uint16_t get16(const std::vector<unsigned char> &bytes, size_t offset)
+    {
+        return static_cast<uint16_t>(bytes[offset] | (bytes[offset + 1] << 8));
+    }
+    static uint32_t get32(const std::vector<unsigned char> &bytes, size_t offset)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++)
+            value |= static_cast<uint32_t>(bytes[offset + i]) << (8 * i);
+        return value;
+    }
+    static float getFloat(const std::vector<unsigned char> &bytes, size_t offset)
+    {
+        uint32_t bits = get32(bytes, offset);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    static double getDouble(const std::vector<unsigned char> &bytes, size_t offset)
+    {
+        uint64_t bits = get32(bytes, offset) | (static_cast<uint64_t>(get32(bytes, offset + 4)) << 32);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+#endif
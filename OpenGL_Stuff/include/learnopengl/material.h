@@ -0,0 +1,131 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+// texture slots known to the shaders, each one is bound to the texture unit with the same number
+enum class TextureSlot : unsigned int {
+    Diffuse = 0,
+    Specular,
+    Normal,
+    Emissive,
+    Count
+};
+
+// GLSL sampler names of each slot (only the first texture of each type is used)
+inline const char *TextureSlotSampler(TextureSlot slot)
+{
+    static const char *names[] = { "texture_diffuse1", "texture_specular1", "texture_normal1", "texture_emissive1" };
+    return names[static_cast<unsigned int>(slot)];
+}
+
+// Texture type name given by Model::loadMaterialTextures, Count when it is not one of the slots
+inline TextureSlot TextureSlotFromType(const std::string &type)
+{
+    if (type == "texture_diffuse") return TextureSlot::Diffuse;
+    if (type == "texture_specular") return TextureSlot::Specular;
+    if (type == "texture_normal") return TextureSlot::Normal;
+    if (type == "texture_emissive") return TextureSlot::Emissive;
+    return TextureSlot::Count;
+}
+
+// Textures of a mesh resolved once at import into a fixed slot table, so binding it is a short loop of
+// glActiveTexture/glBindTexture with no string building or comparison and no allocation.
+// Besides the textures it carries the feature flags and the reflection parameters the shaders read; the flags
+// pick the material part of a shader with permutations (bit i defines the i-th material define of the Shader).
+// The sampler uniforms of every program are pointed at the slot units the first time the program is seen.
+class Material
+{
+public:
+    static const unsigned int SLOT_COUNT = static_cast<unsigned int>(TextureSlot::Count);
+
+    enum Flags : unsigned int {
+        HAS_EMISSIVE_MAP = 1 << 0
+    };
+
+    std::string name; // name in the model file, to find materials that need extra setup (reflections...)
+
+    Material() : textures(), flags(0), reflectivity(0.0f), roughness(1.0f), boundCount(0), boundUnits() {}
+
+    // the first texture of each type takes the slot, the rest are ignored
+    void SetTexture(TextureSlot slot, unsigned int id)
+    {
+        unsigned int index = static_cast<unsigned int>(slot);
+        if (index >= SLOT_COUNT || textures[index] != 0)
+            return;
+        textures[index] = id;
+        if (slot == TextureSlot::Emissive)
+            flags |= HAS_EMISSIVE_MAP;
+        // list of the units that really have a texture, in slot order
+        boundCount = 0;
+        for (unsigned int i = 0; i < SLOT_COUNT; i++)
+            if (textures[i] != 0)
+                boundUnits[boundCount++] = i;
+    }
+
+    // strength of the reflection probe on this material (0 = none) and roughness that picks the probe mip
+    void SetReflection(float newReflectivity, float newRoughness)
+    {
+        reflectivity = newReflectivity;
+        roughness = newRoughness;
+    }
+
+    unsigned int Texture(TextureSlot slot) const { return textures[static_cast<unsigned int>(slot)]; }
+    bool HasEmissiveMap() const { return (flags & HAS_EMISSIVE_MAP) != 0; }
+    unsigned int Flags() const { return flags; }
+    float Reflectivity() const { return reflectivity; }
+    float Roughness() const { return roughness; }
+
+    // binds the textures to their units and uploads the reflection parameters; the program must be in use
+    void Bind(unsigned int program) const
+    {
+        const ProgramBindings &bindings = bindingsFor(program);
+        for (unsigned int i = 0; i < boundCount; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + boundUnits[i]);
+            glBindTexture(GL_TEXTURE_2D, textures[boundUnits[i]]);
+        }
+        if (bindings.reflection >= 0)
+            glUniform2f(bindings.reflection, reflectivity, roughness);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    unsigned int textures[SLOT_COUNT]; // 0 = empty slot
+    unsigned int flags;
+    float reflectivity;
+    float roughness;
+    unsigned int boundCount;
+    unsigned int boundUnits[SLOT_COUNT];
+
+    // uniform locations of a program, looked up once
+    struct ProgramBindings {
+        unsigned int program;
+        GLint reflection; // vec2 materialReflection: (reflectivity, roughness)
+    };
+
+    static const ProgramBindings &bindingsFor(unsigned int program)
+    {
+        static std::vector<ProgramBindings> programs;
+        for (unsigned int i = 0; i < programs.size(); i++)
+            if (programs[i].program == program)
+                return programs[i];
+
+        // first draw with this program: fix its samplers to the slot units (program state, so this is done only once)
+        for (unsigned int i = 0; i < SLOT_COUNT; i++)
+        {
+            GLint location = glGetUniformLocation(program, TextureSlotSampler(static_cast<TextureSlot>(i)));
+            if (location >= 0)
+                glUniform1i(location, static_cast<GLint>(i));
+        }
+        ProgramBindings bindings;
+        bindings.program = program;
+        bindings.reflection = glGetUniformLocation(program, "materialReflection");
+        programs.push_back(bindings);
+        return programs.back();
+    }
+};
+#endif
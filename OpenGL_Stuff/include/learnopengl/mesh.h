@@ -7,6 +7,9 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/material.h>
+#include <learnopengl/draw_stats.h>
 
 #include <string>
 #include <vector>
@@ -37,7 +40,12 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    // texture slots and flags resolved from textures, used for drawing
+    Material             material;
     unsigned int VAO;
+    // bounding volumes in model space, filled in by Model::processMesh
+    BoundingBox          bounds;
+    BoundingSphere       sphere;
 
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
@@ -45,6 +53,8 @@ public:
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        for (unsigned int i = 0; i < textures.size(); i++)
+            material.SetTexture(TextureSlotFromType(textures[i].type), textures[i].id);
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
@@ -53,48 +63,52 @@ public:
     // render the mesh
     void Draw(Shader& shader)
     {
-        unsigned int diffuseNr = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr = 1;
-        unsigned int emissiveNr = 1;
-        bool hasEmissive = false; // Variable para rastrear si encontramos un mapa emisivo
-
-        for (unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i);
-            string number;
-            string name = textures[i].type;
-
-            if (name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if (name == "texture_specular")
-                number = std::to_string(specularNr++);
-            else if (name == "texture_normal")
-                number = std::to_string(normalNr++);
-            else if (name == "texture_emissive") // --- AQU EST LA DETECCIN! ---
-            {
-                number = std::to_string(emissiveNr++);
-                hasEmissive = true;
-            }
-
-            shader.setInt((name + number).c_str(), i);
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
-
-        // --- AQU SE ENVA LA SEAL AL SHADER! ---
-        shader.setBool("hasEmissiveMap", hasEmissive);
+        // variante del shader segn las banderas del material (mapa emisivo...), sin efecto en shaders sin permutaciones
+        shader.SetMaterialFeatures(material.Flags());
+        // texturas ya resueltas en el material, sin construir strings por cada draw
+        material.Bind(shader.ID);
 
         // Dibujar malla
         glBindVertexArray(VAO);
         glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+        DrawStats::Count(indices.size() / 3);
         glBindVertexArray(0);
+    }
 
-        glActiveTexture(GL_TEXTURE0);
+    // render the mesh from a position only stream (attribute 0), for depth only passes; no textures are bound.
+    // The stream is created the first time, so only meshes that take part in a depth pass pay for it.
+    void DrawDepth()
+    {
+        if (depthVAO == 0)
+            setupDepthStream();
+        glBindVertexArray(depthVAO);
+        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+        DrawStats::Count(indices.size() / 3);
+        glBindVertexArray(0);
     }
 
 private:
     // render data 
     unsigned int VBO, EBO;
+    unsigned int depthVAO = 0, depthVBO = 0;
+
+    // tightly packed positions sharing the index buffer of the full vertex stream
+    void setupDepthStream()
+    {
+        vector<glm::vec3> positions(vertices.size());
+        for (unsigned int i = 0; i < vertices.size(); i++)
+            positions[i] = vertices[i].Position;
+
+        glGenVertexArrays(1, &depthVAO);
+        glGenBuffers(1, &depthVBO);
+        glBindVertexArray(depthVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, depthVBO);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glBindVertexArray(0);
+    }
 
     // initializes all the buffer objects/arrays
     void setupMesh()
@@ -0,0 +1,137 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include <learnopengl/allocation_counter.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// CPU microbenchmarks: Run times an operation in batches, growing the batch until it takes minSeconds, then repeats
+// the batch and keeps the median time per operation (the median ignores the batches a context switch landed in).
+// Allocations per operation come from the AllocationCounter, so they only show up where its implementation is
+// compiled in. The value an operation returns is folded into a volatile sink, so the compiler cannot drop the work.
+class MicroBenchmark
+{
+public:
+    struct Settings {
+        double minSeconds = 0.02;     // shortest batch
+        unsigned int repetitions = 7; // batches measured, the median is kept
+        std::string filter;           // only benchmarks whose name contains it, empty = all
+    };
+
+    struct Result {
+        std::string name;
+        unsigned int size = 0;       // input size (zones, pickups, agents...)
+        double nsPerOp = 0.0;
+        double allocationsPerOp = 0.0;
+        double bytesPerOp = 0.0;
+        unsigned long long operations = 0; // per batch
+    };
+
+    explicit MicroBenchmark(const Settings &newSettings) : settings(newSettings) {}
+
+    bool Selected(const std::string &name) const { return settings.filter.empty() || name.find(settings.filter) != std::string::npos; }
+
+    // operation(i) runs the i-th operation and returns a value that depends on the work
+    template <typename Operation>
+    void Run(const std::string &name, unsigned int size, Operation operation)
+    {
+        if (!Selected(name))
+            return;
+        unsigned long long operations = 1;
+        for (;;)
+        {
+            double seconds = batch(operation, operations);
+            if (seconds >= settings.minSeconds || operations >= (1ull << 40))
+                break;
+            // aim a little past the minimum, at most 10 times more per step
+            double scale = seconds > 0.0 ? settings.minSeconds * 1.2 / seconds : 10.0;
+            operations = static_cast<unsigned long long>(operations * std::min(std::max(scale, 1.5), 10.0));
+        }
+
+        // reserved before the snapshot, the harness itself does not allocate while it counts
+        std::vector<double> times;
+        times.reserve(std::max(1u, settings.repetitions));
+        AllocationCounter::Snapshot before = AllocationCounter::Now();
+        for (unsigned int i = 0; i < std::max(1u, settings.repetitions); i++)
+            times.push_back(batch(operation, operations) * 1e9 / operations);
+        AllocationCounter::Snapshot after = AllocationCounter::Now();
+        std::sort(times.begin(), times.end());
+
+        Result result;
+        result.name = name;
+        result.size = size;
+        result.nsPerOp = times[times.size() / 2];
+        double total = static_cast<double>(operations) * times.size();
+        result.allocationsPerOp = (after.allocations - before.allocations) / total;
+        result.bytesPerOp = (after.bytes - before.bytes) / total;
+        result.operations = operations;
+        results.push_back(result);
+        print(result);
+    }
+
+    const std::vector<Result> &Results() const { return results; }
+
+    void PrintHeader() const
+    {
+        std::printf("%-32s %8s %14s %12s %12s\n", "benchmark", "size", "ns/op", "allocs/op", "bytes/op");
+        if (!AllocationCounter::Installed())
+            std::printf("(allocation counter not compiled in, allocations show as 0)\n");
+    }
+
+    // one row per result: name,size,ns_per_op,allocs_per_op,bytes_per_op
+    bool WriteCsv(const std::string &path) const
+    {
+        FILE *file = std::fopen(path.c_str(), "w");
+        if (!file)
+        {
+            std::cout << "ERROR::MICROBENCH:: cannot create " << path << std::endl;
+            return false;
+        }
+        std::fprintf(file, "name,size,ns_per_op,allocs_per_op,bytes_per_op\n");
+        for (const Result &result : results)
+            std::fprintf(file, "%s,%u,%.3f,%.4f,%.1f\n", result.name.c_str(), result.size, result.nsPerOp,
+                         result.allocationsPerOp, result.bytesPerOp);
+        std::fclose(file);
+        return true;
+    }
+
+private:
+    Settings settings;
+    std::vector<Result> results;
+    volatile unsigned char sink = 0;
+
+    template <typename Operation>
+    double batch(Operation &operation, unsigned long long operations)
+    {
+        unsigned char folded = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned long long i = 0; i < operations; i++)
+            folded ^= fold(operation(i));
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        sink = sink ^ folded;
+        return seconds;
+    }
+
+    template <typename T>
+    static unsigned char fold(const T &value)
+    {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&value);
+        unsigned char folded = 0;
+        for (size_t i = 0; i < sizeof(T); i++)
+            folded ^= bytes[i];
+        return folded;
+    }
+
+    static void print(const Result &result)
+    {
+        std::printf("%-32s %8u %14.2f %12.3f %12.1f\n", result.name.c_str(), result.size, result.nsPerOp,
+                    result.allocationsPerOp, result.bytesPerOp);
+        std::fflush(stdout);
+    }
+};
+#endif
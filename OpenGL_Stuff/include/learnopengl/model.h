@@ -12,7 +12,9 @@
 
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/culling.h>
 
+#include <cstdio>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -22,6 +24,7 @@
 using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+unsigned int TextureFromColor(const glm::vec3 &color);
 
 class Model 
 {
@@ -31,6 +34,9 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // bounding volumes enclosing every mesh, in model space
+    BoundingBox     bounds;
+    BoundingSphere  sphere;
 
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
@@ -44,8 +50,99 @@ public:
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
+
+    // marks in visible the meshes that survive the culling in cull: outside the frustum, in a cell that is not visible
+    // through the portals or hidden behind the occluders are rejected. meshCells optionally gives the precomputed cells
+    // of each mesh (for static models), otherwise they are found from the world bounds.
+    // Static models baked into a potentially visible set pass it in pvs (mesh i is object firstObject + i); the set then
+    // replaces the portal and occlusion tests and only the frustum is still tested.
+    void Cull(const glm::mat4 &modelMatrix, CullContext &cull, vector<unsigned char> &visible, const CellMask *meshCells = nullptr,
+              const PotentiallyVisibleSet *pvs = nullptr, unsigned int firstObject = 0) const
+    {
+        if (pvs && !pvs->IsReady())
+            pvs = nullptr;
+        CullStats &stats = cull.stats;
+        visible.assign(meshes.size(), 0);
+        stats.tested += static_cast<unsigned int>(meshes.size());
+        // reject the whole model first with its bounding sphere
+        if (!cull.frustum.IsSphereVisible(sphere.Transformed(modelMatrix)))
+        {
+            stats.culled += static_cast<unsigned int>(meshes.size());
+            return;
+        }
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            BoundingBox worldBox = meshes[i].bounds.Transformed(modelMatrix);
+            if (pvs)
+            {
+                if (!pvs->IsVisible(firstObject + i))
+                    stats.pvsCulled++;
+                else if (!cull.frustum.IsBoxVisible(worldBox))
+                    stats.culled++;
+                else
+                    visible[i] = 1;
+                continue;
+            }
+            if (cull.cells)
+            {
+                CellMask mask = meshCells ? meshCells[i] : cull.cells->CellsOverlapping(worldBox, cull.cellMargin);
+                if (!cull.cells->IsVisible(mask))
+                {
+                    stats.portalCulled++;
+                    continue;
+                }
+            }
+            if (!cull.frustum.IsBoxVisible(worldBox))
+            {
+                stats.culled++;
+                continue;
+            }
+            if (cull.occlusion && !cull.occlusion->IsBoxVisible(worldBox))
+            {
+                stats.occluded++;
+                continue;
+            }
+            visible[i] = 1;
+        }
+    }
+
+    // draws the meshes marked in visible (the result of Cull)
+    void Draw(Shader &shader, const vector<unsigned char> &visible)
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (visible[i])
+                meshes[i].Draw(shader);
+        }
+    }
+
+    // draws the positions of the meshes marked in visible, for a depth prepass; the depth program must be in use
+    void DrawDepth(const vector<unsigned char> &visible)
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (visible[i])
+                meshes[i].DrawDepth();
+        }
+    }
+
+    // draws only the meshes that survive Cull.
+    // modelMatrix must be the same matrix uploaded to the shader's "model" uniform.
+    void Draw(Shader &shader, const glm::mat4 &modelMatrix, CullContext &cull, const CellMask *meshCells = nullptr,
+              const PotentiallyVisibleSet *pvs = nullptr, unsigned int firstObject = 0)
+    {
+        Cull(modelMatrix, cull, meshVisible, meshCells, pvs, firstObject);
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (meshVisible[i])
+                meshes[i].Draw(shader);
+        }
+    }
     
 private:
+    // result of the last Cull done by Draw, kept to avoid allocating every frame
+    vector<unsigned char> meshVisible;
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
@@ -63,6 +160,21 @@ private:
 
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
+
+        // merge the mesh bounds into the model bounds
+        if (!meshes.empty())
+        {
+            bounds = meshes[0].bounds;
+            for (unsigned int i = 1; i < meshes.size(); i++)
+            {
+                bounds.min = glm::min(bounds.min, meshes[i].bounds.min);
+                bounds.max = glm::max(bounds.max, meshes[i].bounds.max);
+            }
+            sphere.center = bounds.Center();
+            sphere.radius = 0.0f;
+            for (unsigned int i = 0; i < meshes.size(); i++)
+                sphere.radius = glm::max(sphere.radius, glm::length(meshes[i].sphere.center - sphere.center) + meshes[i].sphere.radius);
+        }
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -131,6 +243,10 @@ private:
 
         // Carga de texturas
         vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+        // sin mapa difuso, el color Kd del material como textura de 1x1: si no, la malla muestrea lo que haya quedado
+        // en la unidad 0 (cambia segn qu mallas pasaron el culling) y el lote multi-draw no tendra con qu dibujarla
+        if (diffuseMaps.empty())
+            diffuseMaps.push_back(loadColorTexture(material));
         textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
 
         vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
@@ -143,7 +259,28 @@ private:
         vector<Texture> emissiveMaps = loadMaterialTextures(material, aiTextureType_EMISSIVE, "texture_emissive");
         textures.insert(textures.end(), emissiveMaps.begin(), emissiveMaps.end());
 
-        return Mesh(vertices, indices, textures);
+        Mesh result(vertices, indices, textures);
+        result.material.name = material->GetName().C_Str();
+
+        // bounding box from the vertex positions, sphere centered on the box with the farthest vertex as radius
+        if (!vertices.empty())
+        {
+            result.bounds.min = result.bounds.max = vertices[0].Position;
+            for (unsigned int i = 1; i < vertices.size(); i++)
+            {
+                result.bounds.min = glm::min(result.bounds.min, vertices[i].Position);
+                result.bounds.max = glm::max(result.bounds.max, vertices[i].Position);
+            }
+            result.sphere.center = result.bounds.Center();
+            float maxDistance2 = 0.0f;
+            for (unsigned int i = 0; i < vertices.size(); i++)
+            {
+                glm::vec3 d = vertices[i].Position - result.sphere.center;
+                maxDistance2 = glm::max(maxDistance2, glm::dot(d, d));
+            }
+            result.sphere.radius = std::sqrt(maxDistance2);
+        }
+        return result;
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -178,6 +315,26 @@ private:
         }
         return textures;
     }
+
+    // 1x1 texture with the diffuse color of the material, shared by the materials with the same color
+    Texture loadColorTexture(aiMaterial *mat)
+    {
+        aiColor3D color(1.0f, 1.0f, 1.0f);
+        mat->Get(AI_MATKEY_COLOR_DIFFUSE, color);
+        char path[64];
+        std::snprintf(path, sizeof(path), "#color %.4f %.4f %.4f", color.r, color.g, color.b);
+        for (unsigned int j = 0; j < textures_loaded.size(); j++)
+        {
+            if (textures_loaded[j].path == path)
+                return textures_loaded[j];
+        }
+        Texture texture;
+        texture.id = TextureFromColor(glm::vec3(color.r, color.g, color.b));
+        texture.type = "texture_diffuse";
+        texture.path = path;
+        textures_loaded.push_back(texture);
+        return texture;
+    }
 };
 
 
@@ -220,4 +377,25 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
 
     return textureID;
 }
+
+unsigned int TextureFromColor(const glm::vec3 &color)
+{
+    glm::vec3 clamped = glm::clamp(color, 0.0f, 1.0f);
+    unsigned char texel[3] = { static_cast<unsigned char>(clamped.r * 255.0f + 0.5f),
+                               static_cast<unsigned char>(clamped.g * 255.0f + 0.5f),
+                               static_cast<unsigned char>(clamped.b * 255.0f + 0.5f) };
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, texel);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    return textureID;
+}
 #endif
\ No newline at end of file
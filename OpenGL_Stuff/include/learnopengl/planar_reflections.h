@@ -0,0 +1,249 @@
+#ifndef PLANAR_REFLECTIONS_H
+#define PLANAR_REFLECTIONS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Planar reflections for a set of static mirrors.
+// Each mirror owns a reduced resolution color target. The scene is rendered into it from the camera reflected about
+// the mirror plane, with the near plane of the projection replaced by the mirror plane (Lengyel's oblique clipping) so
+// nothing behind the mirror shows up, and the caller culls against the reflected frustum returned by Begin.
+// Rendering every visible mirror each frame is too expensive, so Schedule picks at most budget mirrors per frame by
+// screen coverage, distance and age of their image; the others keep their last image. The mirror shader projects its
+// fragments with the view projection the image was rendered with, so a stale image still lines up with the mirror.
+class PlanarReflections
+{
+public:
+    // texture unit of the reflection image (after the material slots, the clustered lights and the flashlight shadow)
+    static const unsigned int UNIT = 8;
+
+    struct Settings {
+        float resolutionScale = 0.5f; // size of the targets relative to the screen
+        unsigned int budget = 2;      // mirrors re-rendered per frame
+        float distanceWeight = 0.1f;  // priority = coverage / (1 + distance * distanceWeight) * (1 + age * ageWeight)
+        float ageWeight = 0.25f;      // age in frames since the last update
+        float clipOffset = 0.02f;     // the clip plane is moved this far behind the mirror so its own surface is kept
+    };
+
+    struct Stats {
+        unsigned int candidates = 0; // visible mirrors facing the camera this frame
+        unsigned int updated = 0;    // re-rendered this frame
+        unsigned int stale = 0;      // drawn with an image from an earlier frame
+    };
+
+    // camera used to render one reflection
+    struct View {
+        glm::mat4 view;
+        glm::mat4 projection; // oblique, clips at the mirror plane
+        glm::vec3 eye;
+        Frustum frustum;      // of the oblique projection, its near plane is the mirror plane
+    };
+
+    Stats stats;
+
+    void Init(int screenWidth, int screenHeight, const Settings &newSettings)
+    {
+        settings = newSettings;
+        width = std::max(1, static_cast<int>(screenWidth * settings.resolutionScale));
+        height = std::max(1, static_cast<int>(screenHeight * settings.resolutionScale));
+
+        // one depth buffer is shared by all the targets, only one reflection is rendered at a time
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    }
+
+    // plane through point with normal pointing to the side the mirror is seen from; bounds in world space
+    unsigned int AddMirror(const glm::vec3 &point, const glm::vec3 &normal, const BoundingBox &bounds)
+    {
+        Mirror mirror;
+        glm::vec3 n = glm::normalize(normal);
+        mirror.plane = glm::vec4(n, -glm::dot(n, point));
+        mirror.bounds = bounds;
+        createTarget(mirror);
+        mirrors.push_back(mirror);
+        order.reserve(mirrors.size());
+        scheduled.reserve(mirrors.size());
+        return static_cast<unsigned int>(mirrors.size() - 1);
+    }
+
+    unsigned int MirrorCount() const { return static_cast<unsigned int>(mirrors.size()); }
+    const Settings &GetSettings() const { return settings; }
+    bool IsReady(unsigned int index) const { return mirrors[index].ready; }
+
+    // picks the mirrors to re-render this frame among the visible ones (visible[i] != 0) facing the eye
+    const std::vector<unsigned int> &Schedule(const glm::vec3 &eye, const glm::mat4 &viewProjection, const unsigned char *visible)
+    {
+        frame++;
+        order.clear();
+        scheduled.clear();
+        stats.candidates = 0;
+        for (unsigned int i = 0; i < mirrors.size(); i++)
+        {
+            const Mirror &mirror = mirrors[i];
+            if (!visible[i] || glm::dot(glm::vec3(mirror.plane), eye) + mirror.plane.w <= 0.0f)
+                continue;
+            stats.candidates++;
+            float distance = glm::length(mirror.bounds.Center() - eye);
+            float age = mirror.ready ? static_cast<float>(frame - mirror.lastUpdate) : 1e6f;
+            float priority = screenCoverage(mirror.bounds, viewProjection) / (1.0f + distance * settings.distanceWeight) *
+                             (1.0f + age * settings.ageWeight);
+            order.push_back(Ranked{ priority, i });
+        }
+        unsigned int count = std::min(settings.budget, static_cast<unsigned int>(order.size()));
+        std::partial_sort(order.begin(), order.begin() + count, order.end(),
+                          [](const Ranked &a, const Ranked &b) { return a.priority > b.priority; });
+        for (unsigned int i = 0; i < count; i++)
+            scheduled.push_back(order[i].index);
+
+        stats.updated = count;
+        stats.stale = 0;
+        for (unsigned int i = count; i < order.size(); i++)
+            if (mirrors[order[i].index].ready)
+                stats.stale++;
+        return scheduled;
+    }
+
+    // binds the target of the mirror and returns the reflected camera; render the scene with it, then call End
+    View Begin(unsigned int index, const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &eye)
+    {
+        Mirror &mirror = mirrors[index];
+        glm::vec3 n = glm::vec3(mirror.plane);
+        float d = mirror.plane.w;
+
+        // reflection about the plane: x' = x - 2 (n.x + d) n
+        glm::mat4 reflection(1.0f);
+        for (int c = 0; c < 3; c++)
+            for (int r = 0; r < 3; r++)
+                reflection[c][r] -= 2.0f * n[r] * n[c];
+        reflection[3] = glm::vec4(-2.0f * d * n, 1.0f);
+
+        View result;
+        result.view = view * reflection;
+        result.eye = glm::vec3(reflection * glm::vec4(eye, 1.0f));
+        result.projection = obliqueProjection(projection, result.view, glm::vec4(n, d + settings.clipOffset));
+        result.frustum.Update(result.projection * result.view);
+
+        // the x and y rows of the oblique projection are unchanged, so this maps the mirror surface to the image too
+        mirror.textureMatrix = projection * result.view;
+        mirror.lastUpdate = frame;
+        mirror.ready = true;
+
+        glGetIntegerv(GL_VIEWPORT, previousViewport);
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, mirror.fbo);
+        glViewport(0, 0, width, height);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        return result;
+    }
+
+    void End()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    }
+
+    // binds the image of the mirror for the mirror shader; the shader must be in use
+    void Bind(const Shader &shader, unsigned int index) const
+    {
+        const Mirror &mirror = mirrors[index];
+        glActiveTexture(GL_TEXTURE0 + UNIT);
+        glBindTexture(GL_TEXTURE_2D, mirror.texture);
+        glActiveTexture(GL_TEXTURE0);
+        shader.setInt("reflectionMap", UNIT);
+        shader.setBool("hasReflection", mirror.ready);
+        shader.setMat4("reflectionMatrix", mirror.textureMatrix);
+        shader.setVec3("mirrorNormal", glm::vec3(mirror.plane));
+    }
+
+private:
+    struct Mirror {
+        glm::vec4 plane;
+        BoundingBox bounds;
+        unsigned int fbo = 0;
+        unsigned int texture = 0;
+        glm::mat4 textureMatrix = glm::mat4(1.0f);
+        unsigned int lastUpdate = 0;
+        bool ready = false;
+    };
+
+    struct Ranked {
+        float priority;
+        unsigned int index;
+    };
+
+    Settings settings;
+    int width = 0, height = 0;
+    unsigned int depthBuffer = 0;
+    unsigned int frame = 0;
+    std::vector<Mirror> mirrors;
+    std::vector<Ranked> order;
+    std::vector<unsigned int> scheduled;
+    GLint previousViewport[4] = { 0, 0, 0, 0 };
+    GLint previousFramebuffer = 0;
+
+    void createTarget(Mirror &mirror)
+    {
+        glGenTextures(1, &mirror.texture);
+        glBindTexture(GL_TEXTURE_2D, mirror.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        GLint previous;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+        glGenFramebuffers(1, &mirror.fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, mirror.fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mirror.texture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::PLANAR_REFLECTIONS:: mirror framebuffer is not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, previous);
+    }
+
+    // replaces the near plane of projection with the world space plane (Lengyel, "Oblique View Frustum Depth Projection
+    // and Clipping"); the plane normal points to the side that is kept
+    static glm::mat4 obliqueProjection(glm::mat4 projection, const glm::mat4 &view, const glm::vec4 &worldPlane)
+    {
+        glm::vec4 plane = glm::transpose(glm::inverse(view)) * worldPlane;
+        glm::vec4 corner = glm::inverse(projection) * glm::vec4(plane.x > 0.0f ? 1.0f : (plane.x < 0.0f ? -1.0f : 0.0f),
+                                                                plane.y > 0.0f ? 1.0f : (plane.y < 0.0f ? -1.0f : 0.0f), 1.0f, 1.0f);
+        glm::vec4 scaled = plane * (2.0f / glm::dot(plane, corner));
+        projection[0][2] = scaled.x - projection[0][3];
+        projection[1][2] = scaled.y - projection[1][3];
+        projection[2][2] = scaled.z - projection[2][3];
+        projection[3][2] = scaled.w - projection[3][3];
+        return projection;
+    }
+
+    // fraction of the screen covered by the projected box (1 when the box reaches behind the eye)
+    static float screenCoverage(const BoundingBox &box, const glm::mat4 &viewProjection)
+    {
+        glm::vec2 minNdc(1e30f), maxNdc(-1e30f);
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+            glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+            if (clip.w <= 1e-4f)
+                return 1.0f;
+            glm::vec2 ndc = glm::vec2(clip) / clip.w;
+            minNdc = glm::min(minNdc, ndc);
+            maxNdc = glm::max(maxNdc, ndc);
+        }
+        glm::vec2 size = glm::clamp(maxNdc, -1.0f, 1.0f) - glm::clamp(minNdc, -1.0f, 1.0f);
+        return glm::max(size.x, 0.0f) * glm::max(size.y, 0.0f) * 0.25f;
+    }
+};
+#endif
@@ -0,0 +1,129 @@
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Writes 8 bit RGBA images as PNG without a compression library: the zlib stream uses stored (uncompressed) deflate
+// blocks, so the files are about as big as the raw pixels but any viewer reads them. Meant for frame dumps.
+class PngWriter
+{
+public:
+    // rows go from top to bottom unless flipRows, which takes them bottom up (glReadPixels order)
+    static bool Write(const std::string &path, int width, int height, const unsigned char *rgba, bool flipRows)
+    {
+        FILE *file = std::fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            std::cout << "ERROR::PNG:: cannot create " << path << std::endl;
+            return false;
+        }
+        static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        std::fwrite(signature, 1, sizeof(signature), file);
+
+        std::vector<unsigned char> header;
+        put32(header, static_cast<uint32_t>(width));
+        put32(header, static_cast<uint32_t>(height));
+        header.push_back(8); // bits per channel
+        header.push_back(6); // RGBA
+        header.push_back(0); // deflate
+        header.push_back(0); // adaptive filters (every row uses none)
+        header.push_back(0); // not interlaced
+        writeChunk(file, "IHDR", header);
+
+        // every row starts with its filter type, 0 = none
+        size_t rowSize = static_cast<size_t>(width) * 4;
+        std::vector<unsigned char> raw;
+        raw.reserve((rowSize + 1) * height);
+        for (int y = 0; y < height; y++)
+        {
+            const unsigned char *row = rgba + rowSize * (flipRows ? height - 1 - y : y);
+            raw.push_back(0);
+            raw.insert(raw.end(), row, row + rowSize);
+        }
+
+        std::vector<unsigned char> zlib;
+        zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+        zlib.push_back(0x78); // deflate, 32K window
+        zlib.push_back(0x01); // no preset dictionary, check bits
+        size_t offset = 0;
+        do
+        {
+            size_t length = std::min(raw.size() - offset, static_cast<size_t>(65535));
+            bool last = offset + length == raw.size();
+            zlib.push_back(last ? 1 : 0); // stored block
+            zlib.push_back(static_cast<unsigned char>(length & 0xFF));
+            zlib.push_back(static_cast<unsigned char>(length >> 8));
+            zlib.push_back(static_cast<unsigned char>(~length & 0xFF));
+            zlib.push_back(static_cast<unsigned char>((~length >> 8) & 0xFF));
+            zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+            offset += length;
+        } while (offset < raw.size());
+        put32(zlib, adler32(raw));
+        writeChunk(file, "IDAT", zlib);
+        writeChunk(file, "IEND", std::vector<unsigned char>());
+
+        bool ok = std::ferror(file) == 0;
+        std::fclose(file);
+        if (!ok)
+            std::cout << "ERROR::PNG:: cannot write " << path << std::endl;
+        return ok;
+    }
+
+private:
+    static void put32(std::vector<unsigned char> &bytes, uint32_t value)
+    {
+        bytes.push_back(static_cast<unsigned char>(value >> 24));
+        bytes.push_back(static_cast<unsigned char>(value >> 16));
+        bytes.push_back(static_cast<unsigned char>(value >> 8));
+        bytes.push_back(static_cast<unsigned char>(value));
+    }
+
+    static void writeChunk(FILE *file, const char *type, const std::vector<unsigned char> &data)
+    {
+        std::vector<unsigned char> chunk;
+        chunk.reserve(data.size() + 12);
+        put32(chunk, static_cast<uint32_t>(data.size()));
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        // the CRC covers the type and the data
+        put32(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+        std::fwrite(chunk.data(), 1, chunk.size(), file);
+    }
+
+    static uint32_t crc32(const unsigned char *bytes, size_t size)
+    {
+        static uint32_t table[256];
+        static bool tableReady = false;
+        if (!tableReady)
+        {
+            for (uint32_t n = 0; n < 256; n++)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                table[n] = c;
+            }
+            tableReady = true;
+        }
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < size; i++)
+            crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+        return crc ^ 0xFFFFFFFFu;
+    }
+
+    static uint32_t adler32(const std::vector<unsigned char> &bytes)
+    {
+        uint32_t a = 1, b = 0;
+        for (size_t i = 0; i < bytes.size(); i++)
+        {
+            a = (a + bytes[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        return (b << 16) | a;
+    }
+};
+#endif
@@ -0,0 +1,563 @@
+#ifndef PVS_H
+#define PVS_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/cells.h>
+#include <learnopengl/cpu_profiler.h>
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Potentially visible set for static geometry.
+// The baker samples points inside every cell and on every static object and casts rays between them against the
+// level triangles; an object is potentially visible from a cell when at least one ray reaches it. The result is one
+// bitset per cell, stored run length compressed on disk. At runtime the camera's cell picks the bitset in O(1).
+class PotentiallyVisibleSet
+{
+public:
+    struct BakeSettings {
+        float eyeHeight = -7.5f;          // the camera never leaves this height
+        float cellSampleSpacing = 1.0f;   // distance between sample points inside a cell
+        unsigned int maxCellSamples = 64;
+        unsigned int objectSamples = 32;  // points sampled on the surface of each object
+        float cellMargin = 1.0f;          // objects this close to a cell are always visible from it
+        unsigned int threads = 0;         // 0 = one per hardware thread
+    };
+
+    struct Stats {
+        unsigned long long rays = 0;
+        float bakeMs = 0.0f;
+        unsigned int visiblePairs = 0;
+    };
+
+    Stats stats;
+
+    // static objects in world space; occluders also block the rays, objects that are not occluders are only targets
+    unsigned int AddObject(const std::vector<glm::vec3> &worldTriangles, bool occluder)
+    {
+        Object object;
+        object.triangles = worldTriangles;
+        object.occluder = occluder;
+        for (unsigned int i = 0; i < worldTriangles.size(); i++)
+        {
+            object.bounds.min = i == 0 ? worldTriangles[i] : glm::min(object.bounds.min, worldTriangles[i]);
+            object.bounds.max = i == 0 ? worldTriangles[i] : glm::max(object.bounds.max, worldTriangles[i]);
+        }
+        if (occluder)
+            occluderTriangles.insert(occluderTriangles.end(), worldTriangles.begin(), worldTriangles.end());
+        objects.push_back(object);
+        return static_cast<unsigned int>(objects.size() - 1);
+    }
+
+    // adds every mesh of a model as its own object
+    void AddMeshes(const std::vector<Mesh> &meshes, const glm::mat4 &modelMatrix, bool occluder)
+    {
+        for (unsigned int m = 0; m < meshes.size(); m++)
+        {
+            std::vector<glm::vec3> triangles;
+            triangles.reserve(meshes[m].indices.size());
+            for (unsigned int i = 0; i < meshes[m].indices.size(); i++)
+                triangles.push_back(glm::vec3(modelMatrix * glm::vec4(meshes[m].vertices[meshes[m].indices[i]].Position, 1.0f)));
+            AddObject(triangles, occluder);
+        }
+    }
+
+    // adds all the meshes of a model as a single object, returns its index
+    unsigned int AddMeshGroup(const std::vector<Mesh> &meshes, const glm::mat4 &modelMatrix, bool occluder)
+    {
+        std::vector<glm::vec3> triangles;
+        for (unsigned int m = 0; m < meshes.size(); m++)
+            for (unsigned int i = 0; i < meshes[m].indices.size(); i++)
+                triangles.push_back(glm::vec3(modelMatrix * glm::vec4(meshes[m].vertices[meshes[m].indices[i]].Position, 1.0f)));
+        return AddObject(triangles, occluder);
+    }
+
+    unsigned int ObjectCount() const { return static_cast<unsigned int>(objects.size()); }
+
+    // identifies the inputs of a bake, a stored set is only used when the key matches. The triangles are hashed per
+    // object, in the order they were added: occluderTriangles holds the same positions but the BVH build reorders them
+    uint64_t Key(const CellGraph &cells, const BakeSettings &settings) const
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        auto add = [&hash](const void *data, size_t size) {
+            const unsigned char *bytes = static_cast<const unsigned char *>(data);
+            for (size_t i = 0; i < size; i++)
+                hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        };
+        for (unsigned int i = 0; i < cells.cells.size(); i++)
+            add(&cells.cells[i].rect, sizeof(glm::vec4));
+        for (unsigned int i = 0; i < objects.size(); i++)
+        {
+            unsigned int triangleCount = static_cast<unsigned int>(objects[i].triangles.size());
+            unsigned char occluder = objects[i].occluder ? 1 : 0;
+            add(&triangleCount, sizeof(triangleCount));
+            add(&occluder, sizeof(occluder));
+            add(&objects[i].bounds, sizeof(BoundingBox));
+            if (triangleCount > 0)
+                add(&objects[i].triangles[0], triangleCount * sizeof(glm::vec3));
+        }
+        add(&settings.eyeHeight, sizeof(float));
+        add(&settings.cellSampleSpacing, sizeof(float));
+        add(&settings.maxCellSamples, sizeof(unsigned int));
+        add(&settings.objectSamples, sizeof(unsigned int));
+        add(&settings.cellMargin, sizeof(float));
+        return hash;
+    }
+
+    void Bake(const CellGraph &cells, const BakeSettings &settings)
+    {
+        auto start = std::chrono::steady_clock::now();
+        cellRects.clear();
+        for (unsigned int i = 0; i < cells.cells.size(); i++)
+            cellRects.push_back(cells.cells[i].rect);
+        key = Key(cells, settings);
+
+        buildBvh();
+
+        // sample points, fixed seed so two bakes of the same level give the same set
+        std::mt19937 random(1234);
+        std::vector<std::vector<glm::vec3>> cellSamples(cellRects.size());
+        for (unsigned int c = 0; c < cellRects.size(); c++)
+            cellSamples[c] = sampleCell(cellRects[c], settings, random);
+        std::vector<std::vector<glm::vec3>> objectSamples(objects.size());
+        for (unsigned int o = 0; o < objects.size(); o++)
+            objectSamples[o] = sampleObject(objects[o], settings.objectSamples, random);
+
+        unsigned int objectCount = ObjectCount();
+        std::vector<unsigned char> visible(cellRects.size() * objectCount, 0);
+        std::atomic<unsigned int> nextJob(0);
+        std::atomic<unsigned long long> rayCount(0);
+        unsigned int jobCount = static_cast<unsigned int>(cellRects.size()) * objectCount;
+
+        auto worker = [&]() {
+            CPU_ZONE("PVS worker");
+            unsigned long long rays = 0;
+            while (true)
+            {
+                unsigned int job = nextJob.fetch_add(1);
+                if (job >= jobCount)
+                    break;
+                unsigned int c = job / objectCount;
+                unsigned int o = job % objectCount;
+                const glm::vec4 &r = cellRects[c];
+                const BoundingBox &b = objects[o].bounds;
+                if (b.max.x >= r.x - settings.cellMargin && b.min.x <= r.y + settings.cellMargin &&
+                    b.max.z >= r.z - settings.cellMargin && b.min.z <= r.w + settings.cellMargin)
+                {
+                    visible[job] = 1;
+                    continue;
+                }
+                for (unsigned int i = 0; i < cellSamples[c].size() && !visible[job]; i++)
+                {
+                    for (unsigned int j = 0; j < objectSamples[o].size(); j++)
+                    {
+                        rays++;
+                        if (!segmentBlocked(cellSamples[c][i], objectSamples[o][j]))
+                        {
+                            visible[job] = 1;
+                            break;
+                        }
+                    }
+                }
+            }
+            rayCount += rays;
+        };
+
+        unsigned int threadCount = settings.threads ? settings.threads : std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < threadCount; t++)
+            threads.push_back(std::thread(worker));
+        for (unsigned int t = 0; t < threadCount; t++)
+            threads[t].join();
+
+        cellBits.assign(cellRects.size(), std::vector<uint64_t>(wordCount(), 0));
+        stats.visiblePairs = 0;
+        for (unsigned int c = 0; c < cellRects.size(); c++)
+        {
+            for (unsigned int o = 0; o < objectCount; o++)
+            {
+                if (visible[c * objectCount + o])
+                {
+                    cellBits[c][o / 64] |= uint64_t(1) << (o % 64);
+                    stats.visiblePairs++;
+                }
+            }
+        }
+        currentBits.assign(wordCount(), ~uint64_t(0));
+        stats.rays = rayCount;
+        stats.bakeMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // file layout: "PVS1", key, cell count, object count, then per cell the compressed size and bytes
+    bool Save(const std::string &path) const
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        uint32_t cellCount = static_cast<uint32_t>(cellBits.size());
+        uint32_t objectCount = ObjectCount();
+        file.write("PVS1", 4);
+        file.write(reinterpret_cast<const char *>(&key), sizeof(key));
+        file.write(reinterpret_cast<const char *>(&cellCount), sizeof(cellCount));
+        file.write(reinterpret_cast<const char *>(&objectCount), sizeof(objectCount));
+        for (uint32_t c = 0; c < cellCount; c++)
+        {
+            std::vector<unsigned char> compressed = compress(cellBits[c]);
+            uint32_t size = static_cast<uint32_t>(compressed.size());
+            file.write(reinterpret_cast<const char *>(&size), sizeof(size));
+            file.write(reinterpret_cast<const char *>(compressed.data()), size);
+        }
+        return file.good();
+    }
+
+    // objects must already be added so the key can be checked; false if missing, stale or corrupt
+    bool Load(const std::string &path, const CellGraph &cells, const BakeSettings &settings)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        char magic[4];
+        uint64_t storedKey;
+        uint32_t cellCount, objectCount;
+        file.read(magic, 4);
+        file.read(reinterpret_cast<char *>(&storedKey), sizeof(storedKey));
+        file.read(reinterpret_cast<char *>(&cellCount), sizeof(cellCount));
+        file.read(reinterpret_cast<char *>(&objectCount), sizeof(objectCount));
+        if (!file || std::memcmp(magic, "PVS1", 4) != 0 || storedKey != Key(cells, settings) ||
+            cellCount != cells.cells.size() || objectCount != ObjectCount())
+            return false;
+
+        std::vector<std::vector<uint64_t>> loaded(cellCount);
+        for (uint32_t c = 0; c < cellCount; c++)
+        {
+            uint32_t size;
+            file.read(reinterpret_cast<char *>(&size), sizeof(size));
+            if (!file || size > wordCount() * 8 * 2)
+                return false;
+            std::vector<unsigned char> compressed(size);
+            file.read(reinterpret_cast<char *>(compressed.data()), size);
+            if (!file || !decompress(compressed, loaded[c]))
+                return false;
+        }
+
+        key = storedKey;
+        cellBits = loaded;
+        cellRects.clear();
+        for (unsigned int i = 0; i < cells.cells.size(); i++)
+            cellRects.push_back(cells.cells[i].rect);
+        currentBits.assign(wordCount(), ~uint64_t(0));
+        return true;
+    }
+
+    bool IsReady() const { return !cellBits.empty(); }
+
+    // selects the set for the camera position (union when standing where cells overlap, everything outside the level)
+    void UpdateCamera(const glm::vec3 &eye)
+    {
+        bool inside = false;
+        std::fill(currentBits.begin(), currentBits.end(), 0);
+        for (unsigned int c = 0; c < cellRects.size(); c++)
+        {
+            const glm::vec4 &r = cellRects[c];
+            const float margin = 0.05f;
+            if (eye.x >= r.x - margin && eye.x <= r.y + margin && eye.z >= r.z - margin && eye.z <= r.w + margin)
+            {
+                inside = true;
+                for (unsigned int w = 0; w < currentBits.size(); w++)
+                    currentBits[w] |= cellBits[c][w];
+            }
+        }
+        if (!inside)
+            std::fill(currentBits.begin(), currentBits.end(), ~uint64_t(0));
+    }
+
+    bool IsVisible(unsigned int object) const
+    {
+        return object >= ObjectCount() || ((currentBits[object / 64] >> (object % 64)) & 1) != 0;
+    }
+
+    unsigned int VisibleCount() const
+    {
+        unsigned int count = 0;
+        for (unsigned int o = 0; o < ObjectCount(); o++)
+            count += IsVisible(o) ? 1 : 0;
+        return count;
+    }
+
+private:
+    struct Object {
+        std::vector<glm::vec3> triangles;
+        BoundingBox bounds;
+        bool occluder;
+    };
+
+    struct BvhNode {
+        BoundingBox bounds;
+        unsigned int first; // first triangle for leaves, right child for inner nodes (left child is the next node)
+        unsigned int count; // triangles in a leaf, 0 for inner nodes
+    };
+
+    std::vector<Object> objects;
+    std::vector<glm::vec4> cellRects;
+    std::vector<std::vector<uint64_t>> cellBits;
+    std::vector<uint64_t> currentBits;
+    uint64_t key = 0;
+
+    std::vector<glm::vec3> occluderTriangles; // 3 vertices per triangle, reordered by the BVH build
+    std::vector<BvhNode> bvh;
+
+    size_t wordCount() const { return (objects.size() + 63) / 64; }
+
+    // ------------------------------------------------------------------------
+    // sampling
+
+    std::vector<glm::vec3> sampleCell(const glm::vec4 &rect, const BakeSettings &settings, std::mt19937 &random) const
+    {
+        unsigned int countX = std::max(2u, static_cast<unsigned int>((rect.y - rect.x) / settings.cellSampleSpacing) + 1);
+        unsigned int countZ = std::max(2u, static_cast<unsigned int>((rect.w - rect.z) / settings.cellSampleSpacing) + 1);
+        while (countX * countZ > settings.maxCellSamples && (countX > 2 || countZ > 2))
+        {
+            if (countX >= countZ) countX--;
+            else countZ--;
+        }
+        std::uniform_real_distribution<float> jitter(-0.25f, 0.25f);
+        std::vector<glm::vec3> samples;
+        for (unsigned int z = 0; z < countZ; z++)
+        {
+            for (unsigned int x = 0; x < countX; x++)
+            {
+                float fx = (x + 0.5f + jitter(random)) / countX;
+                float fz = (z + 0.5f + jitter(random)) / countZ;
+                samples.push_back(glm::vec3(rect.x + (rect.y - rect.x) * fx, settings.eyeHeight, rect.z + (rect.w - rect.z) * fz));
+            }
+        }
+        return samples;
+    }
+
+    // area weighted random points on the surface
+    std::vector<glm::vec3> sampleObject(const Object &object, unsigned int count, std::mt19937 &random) const
+    {
+        std::vector<glm::vec3> samples;
+        std::vector<float> cumulativeArea;
+        float total = 0.0f;
+        for (size_t t = 0; t + 2 < object.triangles.size(); t += 3)
+        {
+            total += 0.5f * glm::length(glm::cross(object.triangles[t + 1] - object.triangles[t], object.triangles[t + 2] - object.triangles[t]));
+            cumulativeArea.push_back(total);
+        }
+        if (cumulativeArea.empty() || total <= 0.0f)
+        {
+            samples.push_back(object.bounds.Center());
+            return samples;
+        }
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        for (unsigned int i = 0; i < count; i++)
+        {
+            size_t t = std::lower_bound(cumulativeArea.begin(), cumulativeArea.end(), uniform(random) * total) - cumulativeArea.begin();
+            t = std::min(t, cumulativeArea.size() - 1) * 3;
+            float u = uniform(random), v = uniform(random);
+            if (u + v > 1.0f)
+            {
+                u = 1.0f - u;
+                v = 1.0f - v;
+            }
+            samples.push_back(object.triangles[t] + u * (object.triangles[t + 1] - object.triangles[t]) + v * (object.triangles[t + 2] - object.triangles[t]));
+        }
+        return samples;
+    }
+
+    // ------------------------------------------------------------------------
+    // ray casting
+
+    void buildBvh()
+    {
+        bvh.clear();
+        unsigned int triangleCount = static_cast<unsigned int>(occluderTriangles.size() / 3);
+        if (triangleCount == 0)
+            return;
+        std::vector<unsigned int> order(triangleCount);
+        for (unsigned int i = 0; i < triangleCount; i++)
+            order[i] = i;
+        bvh.reserve(triangleCount * 2);
+        buildNode(order, 0, triangleCount);
+
+        std::vector<glm::vec3> sorted(occluderTriangles.size());
+        for (unsigned int i = 0; i < triangleCount; i++)
+            for (int k = 0; k < 3; k++)
+                sorted[i * 3 + k] = occluderTriangles[order[i] * 3 + k];
+        occluderTriangles.swap(sorted);
+    }
+
+    unsigned int buildNode(std::vector<unsigned int> &order, unsigned int first, unsigned int count)
+    {
+        unsigned int index = static_cast<unsigned int>(bvh.size());
+        bvh.push_back(BvhNode());
+        BoundingBox bounds;
+        bounds.min = bounds.max = occluderTriangles[order[first] * 3];
+        for (unsigned int i = first; i < first + count; i++)
+            for (int k = 0; k < 3; k++)
+            {
+                bounds.min = glm::min(bounds.min, occluderTriangles[order[i] * 3 + k]);
+                bounds.max = glm::max(bounds.max, occluderTriangles[order[i] * 3 + k]);
+            }
+        bvh[index].bounds = bounds;
+
+        if (count <= 4)
+        {
+            bvh[index].first = first;
+            bvh[index].count = count;
+            return index;
+        }
+
+        // median split on the longest axis by triangle centroid
+        glm::vec3 size = bounds.max - bounds.min;
+        int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+        const std::vector<glm::vec3> &triangles = occluderTriangles;
+        std::nth_element(order.begin() + first, order.begin() + first + count / 2, order.begin() + first + count,
+            [&triangles, axis](unsigned int a, unsigned int b) {
+                return triangles[a * 3][axis] + triangles[a * 3 + 1][axis] + triangles[a * 3 + 2][axis] <
+                       triangles[b * 3][axis] + triangles[b * 3 + 1][axis] + triangles[b * 3 + 2][axis];
+            });
+        buildNode(order, first, count / 2);
+        unsigned int right = buildNode(order, first + count / 2, count - count / 2);
+        bvh[index].first = right;
+        bvh[index].count = 0;
+        return index;
+    }
+
+    static bool rayHitsBox(const glm::vec3 &origin, const glm::vec3 &invDirection, float maxT, const BoundingBox &box)
+    {
+        glm::vec3 t0 = (box.min - origin) * invDirection;
+        glm::vec3 t1 = (box.max - origin) * invDirection;
+        glm::vec3 tMin = glm::min(t0, t1);
+        glm::vec3 tMax = glm::max(t0, t1);
+        float enter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+        float exit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxT));
+        return enter <= exit;
+    }
+
+    // Moller-Trumbore, only hits strictly between the ends of the segment count
+    static bool rayHitsTriangle(const glm::vec3 &origin, const glm::vec3 &direction, float maxT, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+    {
+        glm::vec3 edge1 = b - a;
+        glm::vec3 edge2 = c - a;
+        glm::vec3 p = glm::cross(direction, edge2);
+        float det = glm::dot(edge1, p);
+        if (std::fabs(det) < 1e-9f)
+            return false;
+        float invDet = 1.0f / det;
+        glm::vec3 s = origin - a;
+        float u = glm::dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f)
+            return false;
+        glm::vec3 q = glm::cross(s, edge1);
+        float v = glm::dot(direction, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f)
+            return false;
+        float t = glm::dot(edge2, q) * invDet;
+        return t > 1e-4f && t < maxT;
+    }
+
+    // true if any occluder triangle lies between from and to (the surface the target point sits on does not count)
+    bool segmentBlocked(const glm::vec3 &from, const glm::vec3 &to) const
+    {
+        if (bvh.empty())
+            return false;
+        glm::vec3 direction = to - from;
+        float length = glm::length(direction);
+        if (length < 1e-5f)
+            return false;
+        direction /= length;
+        float maxT = length - 1e-3f;
+        glm::vec3 invDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+        unsigned int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            const BvhNode &node = bvh[stack[--top]];
+            if (!rayHitsBox(from, invDirection, maxT, node.bounds))
+                continue;
+            if (node.count > 0)
+            {
+                for (unsigned int i = node.first; i < node.first + node.count; i++)
+                    if (rayHitsTriangle(from, direction, maxT, occluderTriangles[i * 3], occluderTriangles[i * 3 + 1], occluderTriangles[i * 3 + 2]))
+                        return true;
+            }
+            else if (top + 2 <= 64)
+            {
+                stack[top++] = node.first;
+                stack[top++] = static_cast<unsigned int>(&node - &bvh[0]) + 1;
+            }
+        }
+        return false;
+    }
+
+    // ------------------------------------------------------------------------
+    // run length compression: non zero bytes are copied, a run of zero bytes becomes 0 followed by the run length
+
+    std::vector<unsigned char> compress(const std::vector<uint64_t> &bits) const
+    {
+        size_t byteCount = (objects.size() + 7) / 8;
+        std::vector<unsigned char> out;
+        size_t i = 0;
+        while (i < byteCount)
+        {
+            unsigned char value = static_cast<unsigned char>(bits[i / 8] >> ((i % 8) * 8));
+            if (value != 0)
+            {
+                out.push_back(value);
+                i++;
+                continue;
+            }
+            unsigned int run = 0;
+            while (i < byteCount && run < 255 && static_cast<unsigned char>(bits[i / 8] >> ((i % 8) * 8)) == 0)
+            {
+                run++;
+                i++;
+            }
+            out.push_back(0);
+            out.push_back(static_cast<unsigned char>(run));
+        }
+        return out;
+    }
+
+    bool decompress(const std::vector<unsigned char> &in, std::vector<uint64_t> &bits) const
+    {
+        size_t byteCount = (objects.size() + 7) / 8;
+        bits.assign(wordCount(), 0);
+        size_t out = 0;
+        for (size_t i = 0; i < in.size(); i++)
+        {
+            if (in[i] != 0)
+            {
+                if (out >= byteCount)
+                    return false;
+                bits[out / 8] |= uint64_t(in[i]) << ((out % 8) * 8);
+                out++;
+            }
+            else
+            {
+                if (i + 1 >= in.size())
+                    return false;
+                out += in[++i];
+            }
+        }
+        return out == byteCount;
+    }
+};
+#endif
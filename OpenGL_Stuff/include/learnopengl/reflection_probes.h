@@ -0,0 +1,273 @@
+#ifndef REFLECTION_PROBES_H
+#define REFLECTION_PROBES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Baked cubemap reflection probes for glossy surfaces.
+// Every probe is a point and an axis aligned box (the room it stands in). At load the caller renders the static scene
+// into the six faces of a shared capture cubemap (BeginFace/EndFace), then Prefilter convolves it with a GGX lobe into
+// the mip chain of the probe's own cubemap, one roughness per mip. The shaders pick a mip from the roughness of the
+// surface and correct the reflected direction with the probe box (parallax correction), so a reflection costs one
+// cubemap fetch per fragment instead of rendering the scene again.
+class ReflectionProbes
+{
+public:
+    // texture unit of the probe cubemap (after the planar reflection image)
+    static const unsigned int UNIT = 9;
+
+    struct Settings {
+        unsigned int resolution = 128;   // size of a face at mip 0
+        unsigned int mipLevels = 5;      // roughness 0 at mip 0 up to roughness 1 at the last mip
+        unsigned int sampleCount = 64;   // GGX samples per texel of the prefiltered mips
+        float nearPlane = 0.05f;
+        float farPlane = 200.0f;
+        float boxPadding = 0.5f;         // the boxes are grown by this much so walls just outside the zone are inside
+    };
+
+    struct Stats {
+        unsigned int probes = 0;
+        float bakeMs = 0.0f; // capture and prefilter of every probe, each one measured up to a glFinish
+    };
+
+    // camera used to render one face of the capture cubemap
+    struct View {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::vec3 eye;
+        Frustum frustum;
+    };
+
+    Stats stats;
+
+    void Init(const Settings &newSettings)
+    {
+        settings = newSettings;
+        settings.mipLevels = std::max(1u, std::min(settings.mipLevels, levelsFor(settings.resolution)));
+        if (!prefilterShader)
+            prefilterShader = new Shader("shaders/probe_prefilter.vs", "shaders/probe_prefilter.fs");
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+        // the capture has a full mip chain: the GGX samples read coarser mips to cover their solid angle
+        captureMap = createCubemap(settings.resolution, levelsFor(settings.resolution));
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, settings.resolution, settings.resolution);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glGenFramebuffers(1, &fbo);
+        glGenVertexArrays(1, &emptyVAO);
+    }
+
+    // probe at position whose reflections are projected onto the box [boxMin, boxMax]; returns its index
+    unsigned int AddProbe(const glm::vec3 &position, const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+    {
+        Probe probe;
+        probe.position = position;
+        probe.boxMin = boxMin - glm::vec3(settings.boxPadding);
+        probe.boxMax = boxMax + glm::vec3(settings.boxPadding);
+        probe.cubemap = createCubemap(settings.resolution, settings.mipLevels);
+        probes.push_back(probe);
+        stats.probes = static_cast<unsigned int>(probes.size());
+        return stats.probes - 1;
+    }
+
+    unsigned int ProbeCount() const { return static_cast<unsigned int>(probes.size()); }
+    const Settings &GetSettings() const { return settings; }
+    bool IsReady(unsigned int index) const { return index < probes.size() && probes[index].ready; }
+
+    // binds face (0..5, in GL_TEXTURE_CUBE_MAP_POSITIVE_X order) of the capture cubemap and returns the camera that
+    // renders it; draw the static scene, then call EndFace. After the six faces call Prefilter for the same probe.
+    View BeginFace(unsigned int index, unsigned int face)
+    {
+        if (face == 0)
+            bakeStart = nowMs();
+
+        View result;
+        result.eye = probes[index].position;
+        result.view = glm::translate(faceView(face), -result.eye);
+        result.projection = glm::perspective(glm::radians(90.0f), 1.0f, settings.nearPlane, settings.farPlane);
+        result.frustum.Update(result.projection * result.view);
+
+        glGetIntegerv(GL_VIEWPORT, previousViewport);
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, captureMap, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::REFLECTION_PROBES:: capture framebuffer is not complete" << std::endl;
+        glViewport(0, 0, settings.resolution, settings.resolution);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        return result;
+    }
+
+    void EndFace()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    }
+
+    // convolves the capture into the mip chain of the probe (mip m has roughness m / (mipLevels - 1))
+    void Prefilter(unsigned int index)
+    {
+        Probe &probe = probes[index];
+        glBindTexture(GL_TEXTURE_CUBE_MAP, captureMap);
+        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+
+        GLint viewport[4];
+        GLint framebuffer;
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        glDisable(GL_DEPTH_TEST);
+
+        prefilterShader->use();
+        prefilterShader->setInt("environmentMap", 0);
+        prefilterShader->setFloat("resolution", static_cast<float>(settings.resolution));
+        prefilterShader->setInt("sampleCount", static_cast<int>(settings.sampleCount));
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, captureMap);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, 0);
+        glBindVertexArray(emptyVAO);
+
+        glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+        for (unsigned int mip = 0; mip < settings.mipLevels; mip++)
+        {
+            unsigned int size = std::max(1u, settings.resolution >> mip);
+            glViewport(0, 0, size, size);
+            prefilterShader->setFloat("roughness", settings.mipLevels > 1 ? static_cast<float>(mip) / (settings.mipLevels - 1) : 0.0f);
+            for (unsigned int face = 0; face < 6; face++)
+            {
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, probe.cubemap, mip);
+                prefilterShader->setMat4("inverseViewProjection", glm::inverse(projection * faceView(face)));
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+            }
+        }
+
+        glBindVertexArray(0);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        if (depthTest)
+            glEnable(GL_DEPTH_TEST);
+        probe.ready = true;
+
+        glFinish();
+        stats.bakeMs += static_cast<float>(nowMs() - bakeStart);
+    }
+
+    // probe whose box contains position, otherwise the one whose box is closest
+    unsigned int ProbeAt(const glm::vec3 &position) const
+    {
+        unsigned int best = 0;
+        float bestDistance = 1e30f;
+        for (unsigned int i = 0; i < probes.size(); i++)
+        {
+            glm::vec3 closest = glm::clamp(position, probes[i].boxMin, probes[i].boxMax);
+            float distance = glm::length(closest - position);
+            // inside several padded boxes: the probe closest to the point wins
+            if (distance == 0.0f)
+                distance = -1.0f / (1.0f + glm::length(probes[i].position - position));
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    // binds the probe for shader.fs, shader_mdi.fs or mirror.fs; the shader must be in use. Out of range or not yet
+    // baked probes leave the shader without reflections.
+    void Bind(const Shader &shader, unsigned int index) const
+    {
+        bool ready = IsReady(index);
+        shader.setInt("probeMap", UNIT);
+        shader.setBool("hasProbe", ready);
+        if (!ready)
+            return;
+        const Probe &probe = probes[index];
+        glActiveTexture(GL_TEXTURE0 + UNIT);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, probe.cubemap);
+        glActiveTexture(GL_TEXTURE0);
+        shader.setVec3("probePosition", probe.position);
+        shader.setVec3("probeBoxMin", probe.boxMin);
+        shader.setVec3("probeBoxMax", probe.boxMax);
+        shader.setFloat("probeMaxLod", static_cast<float>(settings.mipLevels - 1));
+    }
+
+private:
+    struct Probe {
+        glm::vec3 position;
+        glm::vec3 boxMin, boxMax;
+        unsigned int cubemap = 0;
+        bool ready = false;
+    };
+
+    Settings settings;
+    std::vector<Probe> probes;
+    Shader *prefilterShader = nullptr;
+    unsigned int captureMap = 0;
+    unsigned int depthBuffer = 0;
+    unsigned int fbo = 0;
+    unsigned int emptyVAO = 0;
+    double bakeStart = 0.0;
+    GLint previousViewport[4] = { 0, 0, 0, 0 };
+    GLint previousFramebuffer = 0;
+
+    static unsigned int levelsFor(unsigned int size)
+    {
+        unsigned int levels = 1;
+        while ((size >> levels) > 0)
+            levels++;
+        return levels;
+    }
+
+    static double nowMs()
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // same orientation as the faces rendered by BeginFace
+    static glm::mat4 faceView(unsigned int face)
+    {
+        static const glm::vec3 targets[6] = { glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+                                              glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) };
+        static const glm::vec3 ups[6] = { glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1),
+                                          glm::vec3(0, 0, -1), glm::vec3(0, -1, 0), glm::vec3(0, -1, 0) };
+        return glm::lookAt(glm::vec3(0.0f), targets[face], ups[face]);
+    }
+
+    // half float RGBA cubemap with levels mips, trilinear and clamped
+    static unsigned int createCubemap(unsigned int size, unsigned int levels)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+        for (unsigned int mip = 0; mip < levels; mip++)
+        {
+            unsigned int mipSize = std::max(1u, size >> mip);
+            for (unsigned int face = 0; face < 6; face++)
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mip, GL_RGBA16F, mipSize, mipSize, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        return texture;
+    }
+};
+#endif
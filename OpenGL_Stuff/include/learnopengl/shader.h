@@ -3,23 +3,216 @@
 
 #include <glad/glad.h>
 
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <map>
+#include <vector>
 
 class Shader
 {
 public:
     unsigned int ID;
+
+    // counters of the program binary cache, for all the shaders of the process
+    struct BinaryCacheStats {
+        unsigned int compiled = 0; // programs built from source (cold start, or not cached yet)
+        unsigned int loaded = 0;   // programs restored with glProgramBinary (warm start)
+        unsigned int rejected = 0; // cached binaries the driver refused, rebuilt from source
+        float compileMs = 0.0f;
+        float loadMs = 0.0f;
+    };
+    static BinaryCacheStats &CacheStats() { static BinaryCacheStats stats; return stats; }
+    // directory where linked programs are stored with glGetProgramBinary (it must exist, ending in '/');
+    // empty disables the cache. Set it before building the shaders.
+    static std::string &CacheDirectory() { static std::string directory; return directory; }
+
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    {
+        load(vertexPath, fragmentPath, geometryPath);
+        ID = compile("");
+    }
+    // constructor of a shader with permutations: every define is a feature bit and each combination is compiled
+    // on its own, the first time it is selected, with "#define <name>" lines injected after #version.
+    // materialDefines[i] is defined when bit i of the Material flags is set (picked per draw by Mesh::Draw),
+    // sceneDefines are switched with SetFeature. Uniforms set on the shader reach every variant: the values are
+    // kept and uploaded to a variant when it is selected, so switching variants never leaves a uniform stale.
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string> &materialDefines,
+           const std::vector<std::string> &sceneDefines)
+    {
+        load(vertexPath, fragmentPath, nullptr);
+        defines = materialDefines;
+        defines.insert(defines.end(), sceneDefines.begin(), sceneDefines.end());
+        materialFeatureCount = static_cast<unsigned int>(materialDefines.size());
+        variants.resize(static_cast<size_t>(1) << defines.size());
+        variants[0].program = compile("");
+        ID = variants[0].program;
+    }
+    // activate the shader
+    // ------------------------------------------------------------------------
+    void use() 
+    { 
+        glUseProgram(ID); 
+    }
+    // turns a scene define on or off; shaders built without it ignore the call. The shader must be in use
+    // ------------------------------------------------------------------------
+    void SetFeature(const std::string &define, bool enabled)
+    {
+        for (unsigned int i = materialFeatureCount; i < defines.size(); i++)
+        {
+            if (defines[i] == define)
+            {
+                unsigned int bit = 1u << i;
+                selectVariant(enabled ? (variantMask | bit) : (variantMask & ~bit));
+                return;
+            }
+        }
+    }
+    // selects the material part of the variant from the Material flags; the shader must be in use
+    // ------------------------------------------------------------------------
+    void SetMaterialFeatures(unsigned int flags)
+    {
+        if (variants.empty())
+            return;
+        unsigned int materialBits = (1u << materialFeatureCount) - 1u;
+        selectVariant((variantMask & ~materialBits) | (flags & materialBits));
+    }
+    // number of programs built so far (1 for a shader without permutations)
+    unsigned int CompiledVariants() const
+    {
+        if (variants.empty())
+            return 1;
+        unsigned int count = 0;
+        for (unsigned int i = 0; i < variants.size(); i++)
+            if (variants[i].program != 0)
+                count++;
+        return count;
+    }
+    // uniform name for the setters: a string literal or a std::string, used without a copy (a literal longer than the
+    // small string buffer would otherwise be copied to the heap on every call)
+    class UniformName
+    {
+    public:
+        UniformName(const char *name) : name(name) {}
+        UniformName(const std::string &name) : name(name.c_str()) {}
+        const char *c_str() const { return name; }
+
+    private:
+        const char *name;
+    };
+
+    // utility uniform functions
+    // ------------------------------------------------------------------------
+    void setBool(UniformName name, bool value) const
+    {         
+        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        remember(name, Uniform::Int, nullptr, (int)value);
+    }
+    // ------------------------------------------------------------------------
+    void setInt(UniformName name, int value) const
+    { 
+        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        remember(name, Uniform::Int, nullptr, value);
+    }
+    // ------------------------------------------------------------------------
+    void setFloat(UniformName name, float value) const
+    { 
+        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        remember(name, Uniform::Float, &value);
+    }
+    // ------------------------------------------------------------------------
+    void setVec2(UniformName name, const glm::vec2 &value) const
+    { 
+        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        remember(name, Uniform::Vec2, &value[0]);
+    }
+    void setVec2(UniformName name, float x, float y) const
+    { 
+        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        float value[] = { x, y };
+        remember(name, Uniform::Vec2, value);
+    }
+    // ------------------------------------------------------------------------
+    void setVec3(UniformName name, const glm::vec3 &value) const
+    { 
+        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        remember(name, Uniform::Vec3, &value[0]);
+    }
+    void setVec3(UniformName name, float x, float y, float z) const
+    { 
+        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        float value[] = { x, y, z };
+        remember(name, Uniform::Vec3, value);
+    }
+    // ------------------------------------------------------------------------
+    void setVec4(UniformName name, const glm::vec4 &value) const
+    { 
+        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        remember(name, Uniform::Vec4, &value[0]);
+    }
+    void setVec4(UniformName name, float x, float y, float z, float w) 
+    { 
+        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        float value[] = { x, y, z, w };
+        remember(name, Uniform::Vec4, value);
+    }
+    // ------------------------------------------------------------------------
+    void setMat2(UniformName name, const glm::mat2 &mat) const
+    {
+        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        remember(name, Uniform::Mat2, &mat[0][0]);
+    }
+    // ------------------------------------------------------------------------
+    void setMat3(UniformName name, const glm::mat3 &mat) const
+    {
+        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        remember(name, Uniform::Mat3, &mat[0][0]);
+    }
+    // ------------------------------------------------------------------------
+    void setMat4(UniformName name, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        remember(name, Uniform::Mat4, &mat[0][0]);
+    }
+
+private:
+    std::string vertexCode;
+    std::string fragmentCode;
+    std::string geometryCode;
+
+    // permutations (empty for a plain shader): one program per bitmask of defines, 0 until it is selected
+    struct Variant {
+        unsigned int program = 0;
+        unsigned int generation = 0; // last uniform generation uploaded to the program
+    };
+    std::vector<std::string> defines;
+    unsigned int materialFeatureCount = 0;
+    std::vector<Variant> variants;
+    unsigned int variantMask = 0;
+
+    // last value of every uniform set on a shader with permutations, with the generation it was set at
+    struct Uniform {
+        enum Type { Int, Float, Vec2, Vec3, Vec4, Mat2, Mat3, Mat4 };
+        Type type;
+        int intValue;
+        float values[16];
+        unsigned int generation;
+    };
+    mutable std::map<std::string, Uniform, std::less<>> uniforms; // looked up by const char *, without a std::string
+    mutable unsigned int generation = 0;
+
+    // reads the source files
+    // ------------------------------------------------------------------------
+    void load(const char* vertexPath, const char* fragmentPath, const char* geometryPath)
     {
         // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
         std::ifstream gShaderFile;
@@ -56,8 +249,40 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
+    }
+
+    // compiles and links the loaded sources with the given "#define" lines
+    // ------------------------------------------------------------------------
+    unsigned int compile(const std::string &defineLines)
+    {
+        std::string vertexSource = injectDefines(vertexCode, defineLines);
+        std::string fragmentSource = injectDefines(fragmentCode, defineLines);
+        bool hasGeometry = !geometryCode.empty();
+        std::string geometrySource = hasGeometry ? injectDefines(geometryCode, defineLines) : std::string();
+        auto start = std::chrono::steady_clock::now();
+        BinaryCacheStats &stats = CacheStats();
+
+        // a program linked before with the same sources on the same driver is loaded as is
+        std::string cachePath;
+        uint64_t key = 0;
+        bool cached = binaryCacheSupported();
+        if (cached)
+        {
+            key = cacheKey(vertexSource, fragmentSource, geometrySource);
+            std::stringstream name;
+            name << CacheDirectory() << std::hex << key << ".bin";
+            cachePath = name.str();
+            unsigned int program = loadBinary(cachePath, key);
+            if (program != 0)
+            {
+                stats.loaded++;
+                stats.loadMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+                return program;
+            }
+        }
+
+        const char* vShaderCode = vertexSource.c_str();
+        const char * fShaderCode = fragmentSource.c_str();
         // 2. compile shaders
         unsigned int vertex, fragment;
         // vertex shader
@@ -72,95 +297,205 @@ public:
         checkCompileErrors(fragment, "FRAGMENT");
         // if geometry shader is given, compile geometry shader
         unsigned int geometry;
-        if(geometryPath != nullptr)
+        if(hasGeometry)
         {
-            const char * gShaderCode = geometryCode.c_str();
+            const char * gShaderCode = geometrySource.c_str();
             geometry = glCreateShader(GL_GEOMETRY_SHADER);
             glShaderSource(geometry, 1, &gShaderCode, NULL);
             glCompileShader(geometry);
             checkCompileErrors(geometry, "GEOMETRY");
         }
         // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        unsigned int program = glCreateProgram();
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+        if(hasGeometry)
+            glAttachShader(program, geometry);
+        if (cached)
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(program);
+        checkCompileErrors(program, "PROGRAM");
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
-        if(geometryPath != nullptr)
+        if(hasGeometry)
             glDeleteShader(geometry);
-
-    }
-    // activate the shader
-    // ------------------------------------------------------------------------
-    void use() 
-    { 
-        glUseProgram(ID); 
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (cached && linked)
+            saveBinary(program, cachePath, key);
+        stats.compiled++;
+        stats.compileMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return program;
     }
-    // utility uniform functions
-    // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
-    {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
-    }
-    // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
-    { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
-    }
-    // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
-    { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
-    }
-    // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
-    { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
-    }
-    void setVec2(const std::string &name, float x, float y) const
-    { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+
+    // program binaries need GL 4.1 (or the extension in core) and at least one binary format
+    static bool binaryCacheSupported()
+    {
+        if (CacheDirectory().empty() || !GLAD_GL_VERSION_4_1)
+            return false;
+        static GLint formats = -1;
+        if (formats < 0)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
     }
-    // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
-    { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+
+    // identifies a program: its sources with the defines, the driver and the binary formats it accepts
+    static uint64_t cacheKey(const std::string &vertexSource, const std::string &fragmentSource, const std::string &geometrySource)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        auto add = [&hash](const void *data, size_t size) {
+            const unsigned char *bytes = static_cast<const unsigned char *>(data);
+            for (size_t i = 0; i < size; i++)
+                hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        };
+        auto addString = [&add](const char *text) {
+            std::string value = text ? text : "";
+            add(value.c_str(), value.size() + 1);
+        };
+        addString(vertexSource.c_str());
+        addString(fragmentSource.c_str());
+        addString(geometrySource.c_str());
+        addString(reinterpret_cast<const char *>(glGetString(GL_VENDOR)));
+        addString(reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+        addString(reinterpret_cast<const char *>(glGetString(GL_VERSION)));
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        std::vector<GLint> formats(formatCount);
+        if (formatCount > 0)
+            glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+        add(formats.data(), formats.size() * sizeof(GLint));
+        return hash;
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
-    { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+
+    // file layout: "GLPB", key, binary format, size, then the bytes from glGetProgramBinary
+    static void saveBinary(unsigned int program, const std::string &path, uint64_t key)
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, nullptr, &format, binary.data());
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+            return;
+        uint32_t storedFormat = format, size = static_cast<uint32_t>(length);
+        file.write("GLPB", 4);
+        file.write(reinterpret_cast<const char *>(&key), sizeof(key));
+        file.write(reinterpret_cast<const char *>(&storedFormat), sizeof(storedFormat));
+        file.write(reinterpret_cast<const char *>(&size), sizeof(size));
+        file.write(binary.data(), length);
     }
-    // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
-    { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+
+    // 0 if the file is missing, stale or corrupt, or the driver does not accept the binary any more
+    static unsigned int loadBinary(const std::string &path, uint64_t key)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return 0;
+        char magic[4];
+        uint64_t storedKey;
+        uint32_t format, size;
+        file.read(magic, 4);
+        file.read(reinterpret_cast<char *>(&storedKey), sizeof(storedKey));
+        file.read(reinterpret_cast<char *>(&format), sizeof(format));
+        file.read(reinterpret_cast<char *>(&size), sizeof(size));
+        if (!file || std::memcmp(magic, "GLPB", 4) != 0 || storedKey != key || size == 0)
+            return 0;
+        std::vector<char> binary(size);
+        file.read(binary.data(), size);
+        if (!file)
+            return 0;
+
+        unsigned int program = glCreateProgram();
+        glProgramBinary(program, format, binary.data(), static_cast<GLsizei>(size));
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            // driver update or a different GPU with the same strings: rebuild and overwrite the file
+            glDeleteProgram(program);
+            CacheStats().rejected++;
+            return 0;
+        }
+        return program;
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
-    { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+
+    // inserts the defines after the #version line; #line keeps the compiler messages on the lines of the file
+    static std::string injectDefines(const std::string &code, const std::string &defineLines)
+    {
+        if (defineLines.empty())
+            return code;
+        size_t versionEnd = code.find('\n');
+        if (versionEnd == std::string::npos)
+            return code;
+        return code.substr(0, versionEnd + 1) + defineLines + "#line 2\n" + code.substr(versionEnd + 1);
     }
-    // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+
+    // switches to the variant of mask (compiling it the first time) and uploads the uniforms it missed
+    void selectVariant(unsigned int mask)
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        if (mask == variantMask)
+            return;
+        // every uniform set while the previous variant was in use already reached it
+        variants[variantMask].generation = generation;
+        Variant &variant = variants[mask];
+        if (variant.program == 0)
+        {
+            std::string defineLines;
+            for (unsigned int i = 0; i < defines.size(); i++)
+                if (mask & (1u << i))
+                    defineLines += "#define " + defines[i] + "\n";
+            variant.program = compile(defineLines);
+            variant.generation = 0;
+        }
+        glUseProgram(variant.program);
+        for (const auto &entry : uniforms)
+        {
+            if (entry.second.generation > variant.generation)
+                upload(glGetUniformLocation(variant.program, entry.first.c_str()), entry.second);
+        }
+        variant.generation = generation;
+        variantMask = mask;
+        ID = variant.program;
     }
-    // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+
+    // keeps the value for the other variants; nothing to do for a shader without permutations
+    void remember(UniformName name, Uniform::Type type, const float *values, int intValue = 0) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        if (variants.empty())
+            return;
+        static const unsigned int counts[] = { 0, 1, 2, 3, 4, 4, 9, 16 };
+        auto found = uniforms.find(name.c_str());
+        if (found == uniforms.end())
+            found = uniforms.emplace(name.c_str(), Uniform()).first;
+        Uniform &uniform = found->second;
+        uniform.type = type;
+        uniform.intValue = intValue;
+        for (unsigned int i = 0; i < counts[type]; i++)
+            uniform.values[i] = values[i];
+        uniform.generation = ++generation;
     }
-    // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+
+    static void upload(GLint location, const Uniform &uniform)
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        if (location < 0)
+            return;
+        switch (uniform.type)
+        {
+        case Uniform::Int: glUniform1i(location, uniform.intValue); break;
+        case Uniform::Float: glUniform1f(location, uniform.values[0]); break;
+        case Uniform::Vec2: glUniform2fv(location, 1, uniform.values); break;
+        case Uniform::Vec3: glUniform3fv(location, 1, uniform.values); break;
+        case Uniform::Vec4: glUniform4fv(location, 1, uniform.values); break;
+        case Uniform::Mat2: glUniformMatrix2fv(location, 1, GL_FALSE, uniform.values); break;
+        case Uniform::Mat3: glUniformMatrix3fv(location, 1, GL_FALSE, uniform.values); break;
+        case Uniform::Mat4: glUniformMatrix4fv(location, 1, GL_FALSE, uniform.values); break;
+        }
     }
 
-private:
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
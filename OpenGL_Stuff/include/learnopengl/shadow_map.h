@@ -0,0 +1,268 @@
+#ifndef SHADOW_MAP_H
+#define SHADOW_MAP_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/draw_stats.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Shadow map of a spot light that moves with the camera (the flashlight).
+// The static casters are rendered into a cached depth map with a frustum wider than the cone, so the cache stays valid
+// while the light only turns a little; it is re-rendered when the light moves further than moveThreshold or the cone
+// leaves the cached frustum. Every frame the cached depth is copied into the sampled map and the dynamic casters are
+// drawn on top with the same light matrix. The GPU time of each update is measured with timer queries, read back one
+// frame late so the CPU never waits for them.
+class SpotShadowMap
+{
+public:
+    // texture unit of the shadow map (0-3 are the material slots, 4-6 the clustered light buffers)
+    static const unsigned int UNIT = 7;
+
+    struct Settings {
+        int resolution = 1024;
+        int pcfRadius = 1;            // the PCF kernel is (2 * pcfRadius + 1)^2 taps, each one a bilinear depth compare
+        float moveThreshold = 0.1f;   // the cache is re-rendered when the light moves further than this
+        float coneMargin = 15.0f;     // degrees added around the cone, how much the light can turn before re-rendering
+        float nearPlane = 0.2f;
+        float farPlane = 60.0f;
+        float normalOffset = 1.5f;    // receivers are pushed along their normal by this many shadow texels
+    };
+
+    struct Stats {
+        unsigned int updates = 0;
+        unsigned int staticUpdates = 0;  // updates that re-rendered the cached static depth
+        unsigned int staticCasters = 0;  // static meshes drawn by the last static update
+        unsigned int dynamicCasters = 0; // models drawn on top of the cache by the last update
+        float staticGpuMs = 0.0f;        // GPU time of the last measured update that re-rendered the cache
+        float cachedGpuMs = 0.0f;        // GPU time of the last measured update that reused it
+    };
+
+    Stats stats;
+
+    // creates the depth maps; can be called again to change the resolution
+    void Init(const Settings &newSettings)
+    {
+        settings = newSettings;
+        release();
+        createDepthTarget(staticFBO, staticTexture, false);
+        createDepthTarget(frameFBO, frameTexture, true);
+        if (!depthShader)
+        {
+            depthShader = new Shader("shaders/depth.vs", "shaders/depth.fs");
+            glGenQueries(2, timerQueries);
+        }
+        cacheValid = false;
+    }
+
+    const Settings &GetSettings() const { return settings; }
+
+    // static casters never change, their world bounds are kept to cull them against the light frustum
+    void AddStaticCasters(const std::vector<Mesh> &meshes, const glm::mat4 &modelMatrix)
+    {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            StaticCaster caster;
+            caster.VAO = meshes[i].VAO;
+            caster.indexCount = static_cast<unsigned int>(meshes[i].indices.size());
+            caster.model = modelMatrix;
+            caster.worldBounds = meshes[i].bounds.Transformed(modelMatrix);
+            staticCasters.push_back(caster);
+        }
+        cacheValid = false;
+    }
+
+    // dynamic casters are given again every frame before Update
+    void ClearDynamicCasters() { dynamicCasters.clear(); }
+
+    void AddDynamicCaster(const Model &model, const glm::mat4 &modelMatrix)
+    {
+        DynamicCaster caster;
+        caster.model = &model;
+        caster.matrix = modelMatrix;
+        dynamicCasters.push_back(caster);
+    }
+
+    // renders the shadow map for a spot light at position looking along direction with the given outer cone angle
+    void Update(const glm::vec3 &position, const glm::vec3 &direction, float coneDegrees)
+    {
+        if (!depthShader)
+            return;
+
+        // result of the previous update (a frame old, so it is usually ready)
+        if (stats.updates > 0)
+        {
+            unsigned int previous = (stats.updates + 1) % 2;
+            GLint available = 0;
+            glGetQueryObjectiv(timerQueries[previous], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+            {
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(timerQueries[previous], GL_QUERY_RESULT, &elapsed);
+                (queryHadStatic[previous] ? stats.staticGpuMs : stats.cachedGpuMs) = elapsed / 1000000.0f;
+            }
+        }
+        unsigned int current = stats.updates % 2;
+        glBeginQuery(GL_TIME_ELAPSED, timerQueries[current]);
+
+        GLint previousViewport[4];
+        GLint previousFramebuffer;
+        glGetIntegerv(GL_VIEWPORT, previousViewport);
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glViewport(0, 0, settings.resolution, settings.resolution);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(1.1f, 4.0f);
+        depthShader->use();
+
+        glm::vec3 front = glm::normalize(direction);
+        bool refresh = !cacheValid || glm::length(position - cachedPosition) > settings.moveThreshold ||
+                       glm::degrees(std::acos(glm::clamp(glm::dot(front, cachedDirection), -1.0f, 1.0f))) + coneDegrees > cachedHalfFov;
+        queryHadStatic[current] = refresh;
+        if (refresh)
+        {
+            cachedPosition = position;
+            cachedDirection = front;
+            cachedHalfFov = glm::min(coneDegrees + settings.coneMargin, 80.0f);
+            glm::vec3 up = std::fabs(front.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            glm::mat4 projection = glm::perspective(glm::radians(cachedHalfFov * 2.0f), 1.0f, settings.nearPlane, settings.farPlane);
+            lightSpace = projection * glm::lookAt(position, position + front, up);
+
+            Frustum frustum(lightSpace);
+            glBindFramebuffer(GL_FRAMEBUFFER, staticFBO);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            depthShader->setMat4("viewProjection", lightSpace);
+            stats.staticCasters = 0;
+            for (unsigned int i = 0; i < staticCasters.size(); i++)
+            {
+                if (!frustum.IsBoxVisible(staticCasters[i].worldBounds))
+                    continue;
+                depthShader->setMat4("model", staticCasters[i].model);
+                glBindVertexArray(staticCasters[i].VAO);
+                glDrawElements(GL_TRIANGLES, staticCasters[i].indexCount, GL_UNSIGNED_INT, 0);
+                DrawStats::Count(staticCasters[i].indexCount / 3);
+                stats.staticCasters++;
+            }
+            cacheValid = true;
+            stats.staticUpdates++;
+        }
+
+        // cached static depth, then the dynamic casters on top
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, staticFBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frameFBO);
+        glBlitFramebuffer(0, 0, settings.resolution, settings.resolution, 0, 0, settings.resolution, settings.resolution,
+                          GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, frameFBO);
+        depthShader->setMat4("viewProjection", lightSpace);
+        for (unsigned int i = 0; i < dynamicCasters.size(); i++)
+        {
+            depthShader->setMat4("model", dynamicCasters[i].matrix);
+            const std::vector<Mesh> &meshes = dynamicCasters[i].model->meshes;
+            for (unsigned int m = 0; m < meshes.size(); m++)
+            {
+                glBindVertexArray(meshes[m].VAO);
+                glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(meshes[m].indices.size()), GL_UNSIGNED_INT, 0);
+                DrawStats::Count(meshes[m].indices.size() / 3);
+            }
+        }
+        stats.dynamicCasters = static_cast<unsigned int>(dynamicCasters.size());
+        glBindVertexArray(0);
+
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+        glEndQuery(GL_TIME_ELAPSED);
+        stats.updates++;
+    }
+
+    // binds the map and sets the shadow uniforms; with enabled false the shader skips the lookup. The shader must be in use
+    void Bind(const Shader &shader, bool enabled) const
+    {
+        glActiveTexture(GL_TEXTURE0 + UNIT);
+        glBindTexture(GL_TEXTURE_2D, frameTexture);
+        glActiveTexture(GL_TEXTURE0);
+
+        // world space size of a shadow texel at distance 1 from the light
+        float texelSize = 2.0f * std::tan(glm::radians(cachedHalfFov)) / settings.resolution;
+        shader.setInt("flashlightShadowMap", UNIT);
+        shader.setBool("flashlightShadows", enabled && cacheValid);
+        shader.setMat4("flashlightSpaceMatrix", lightSpace);
+        shader.setInt("flashlightShadowPcf", settings.pcfRadius);
+        shader.setFloat("flashlightShadowOffset", settings.normalOffset * texelSize);
+    }
+
+private:
+    struct StaticCaster {
+        unsigned int VAO;
+        unsigned int indexCount;
+        glm::mat4 model;
+        BoundingBox worldBounds;
+    };
+
+    struct DynamicCaster {
+        const Model *model;
+        glm::mat4 matrix;
+    };
+
+    Settings settings;
+    std::vector<StaticCaster> staticCasters;
+    std::vector<DynamicCaster> dynamicCasters;
+
+    unsigned int staticFBO = 0, staticTexture = 0;
+    unsigned int frameFBO = 0, frameTexture = 0;
+    Shader *depthShader = nullptr;
+    unsigned int timerQueries[2] = { 0, 0 };
+    bool queryHadStatic[2] = { false, false };
+
+    bool cacheValid = false;
+    glm::vec3 cachedPosition = glm::vec3(0.0f);
+    glm::vec3 cachedDirection = glm::vec3(0.0f, 0.0f, -1.0f);
+    float cachedHalfFov = 0.0f;
+    glm::mat4 lightSpace = glm::mat4(1.0f);
+
+    // the sampled map compares depths in hardware (sampler2DShadow), with linear filtering for 2x2 PCF per tap
+    void createDepthTarget(unsigned int &fbo, unsigned int &texture, bool compare)
+    {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, settings.resolution, settings.resolution, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        if (compare)
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::SHADOW_MAP:: depth framebuffer is not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void release()
+    {
+        if (staticFBO)
+        {
+            glDeleteFramebuffers(1, &staticFBO);
+            glDeleteFramebuffers(1, &frameFBO);
+            glDeleteTextures(1, &staticTexture);
+            glDeleteTextures(1, &frameTexture);
+            staticFBO = frameFBO = staticTexture = frameTexture = 0;
+        }
+    }
+};
+#endif